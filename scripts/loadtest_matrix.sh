@@ -0,0 +1,105 @@
+#!/usr/bin/env bash
+# 用 ChatLoadGen 对 ChatServer 做矩阵压测：每个服务器构建、事件循环数和连接数的组合各启动一次服务器，
+# 压测结束后从 JSON 报告中汇总投递吞吐量和延迟。
+#
+# 用法: scripts/loadtest_matrix.sh [选项]
+#   -s <路径>   ChatServer 可执行文件，空格分隔的多个构建依次压测（默认 build/ChatServer）
+#   -g <路径>   ChatLoadGen 可执行文件（默认 build/ChatLoadGen）
+#   -t <列表>   服务器事件循环数，空格分隔（默认 "1 2 4 $(nproc)"）
+#   -c <列表>   连接数，空格分隔（默认 "1000"）
+#   -r <速率>   每客户端每秒消息数（默认 1）
+#   -p <字节>   消息内容长度或范围（默认 64）
+#   -m <参数>   传给 ChatLoadGen 的额外参数，如 "--rooms 100" 或 "--private"
+#   -d <秒>     测量时长（默认 20）
+#   -R <秒>     建连爬坡时长（默认每 500 个连接 1 秒再加 2 秒）
+#   -l <线程>   ChatLoadGen 的事件循环数（默认 1）
+#   -P <端口>   服务器端口（默认 18080）
+#   -o <目录>   JSON 报告输出目录（默认 loadtest_results）
+#
+# 连接数较多时需要调高文件描述符上限（脚本会把软上限提到硬上限），
+# 单个目标端口的连接数受本机临时端口范围限制（net.ipv4.ip_local_port_range，默认约 28000 个）。
+#
+# 对比 epoll 和 io_uring 后端（io_uring 构建需要 liburing）：
+#   cmake -S . -B build-uring -DCHAT_USE_IO_URING=ON && cmake --build build-uring --target ChatServer
+#   sudo sysctl net.ipv4.ip_local_port_range="1024 65535"
+#   scripts/loadtest_matrix.sh -s "build/ChatServer build-uring/ChatServer" -t 1 -c "1000 10000 50000" -l 2
+set -euo pipefail
+
+server=build/ChatServer
+loadgen=build/ChatLoadGen
+threads="1 2 4 $(nproc)"
+clients="1000"
+rate=1
+payload=64
+mode=""
+duration=20
+rampTime=""
+loadThreads=1
+port=18080
+outdir=loadtest_results
+
+while getopts "s:g:t:c:r:p:m:d:R:l:P:o:" opt; do
+    case "$opt" in
+        s) server=$OPTARG ;;
+        g) loadgen=$OPTARG ;;
+        t) threads=$OPTARG ;;
+        c) clients=$OPTARG ;;
+        r) rate=$OPTARG ;;
+        p) payload=$OPTARG ;;
+        m) mode=$OPTARG ;;
+        d) duration=$OPTARG ;;
+        R) rampTime=$OPTARG ;;
+        l) loadThreads=$OPTARG ;;
+        P) port=$OPTARG ;;
+        o) outdir=$OPTARG ;;
+        *) sed -n '2,27p' "$0"; exit 1 ;;
+    esac
+done
+
+mkdir -p "$outdir"
+ulimit -n "$(ulimit -Hn)" 2>/dev/null || true
+
+# 从报告中取出某一节下的字段
+field() {
+    sed -n "/\"$2\": {/,/}/p" "$1" | grep "\"$3\":" | head -1 | sed 's/.*: *\([0-9.]*\).*/\1/'
+}
+
+printf "%-10s %-8s %-8s %-10s %-14s %-10s %-10s %-10s\n" backend loops clients connected delivered/s p50_us p99_us p99.9_us
+build=0
+for srv in $server; do
+    build=$(( build + 1 ))
+    for t in $threads; do
+        for c in $clients; do
+            run="${build}_${t}_${c}"
+            # 每个新会话都要收到一份完整的在线用户快照，建连越快服务器越跟不上，
+            # 连接多时相应延长爬坡时间
+            ramp=${rampTime:-$(( c / 500 + 2 ))}
+            "$srv" "$port" --threads "$t" --no-persist --no-files >"$outdir/server_${run}.log" 2>&1 &
+            pid=$!
+            sleep 1
+
+            report="$outdir/report_${run}.json"
+            # shellcheck disable=SC2086
+            "$loadgen" 127.0.0.1 "$port" --clients "$c" --threads "$loadThreads" --rate "$rate" \
+                --payload "$payload" --ramp "$ramp" --duration "$duration" --drain 2 $mode \
+                --report "$report" >"$outdir/loadgen_${run}.log" 2>&1 || true
+
+            kill -INT "$pid" 2>/dev/null || true
+            wait "$pid" 2>/dev/null || true
+
+            if [[ -f "$report" ]]; then
+                backend=$(sed -n 's/^I\/O 后端: //p' "$outdir/server_${run}.log")
+                printf "%-10s %-8s %-8s %-10s %-14s %-10s %-10s %-10s\n" "${backend:-?}" "$t" "$c" \
+                    "$(field "$report" connections connected)" \
+                    "$(field "$report" throughput delivered_per_second)" \
+                    "$(field "$report" latency_us p50)" \
+                    "$(field "$report" latency_us p99)" \
+                    "$(field "$report" latency_us p99_9)"
+            else
+                printf "%-10s %-8s %-8s 压测失败，见 %s\n" "$srv" "$t" "$c" "$outdir/loadgen_${run}.log"
+            fi
+            # 等待 TIME_WAIT 的连接释放端口
+            sleep 2
+        done
+    done
+done
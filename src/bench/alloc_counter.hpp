@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+
+// 基准程序替换了全局 operator new，统计堆分配次数和字节数，
+// 用于报告每次操作的分配次数
+namespace AllocCounter {
+
+uint64_t allocations();
+uint64_t bytes();
+
+// 记录区间起点，结束时与 allocations() 之差即区间内的分配次数
+class Scope {
+public:
+    Scope() : start_(AllocCounter::allocations()), startBytes_(AllocCounter::bytes()) {}
+    uint64_t allocations() const { return AllocCounter::allocations() - start_; }
+    uint64_t bytes() const { return AllocCounter::bytes() - startBytes_; }
+
+private:
+    uint64_t start_;
+    uint64_t startBytes_;
+};
+
+} // namespace AllocCounter
@@ -0,0 +1,430 @@
+#include <benchmark/benchmark.h>
+#include <asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "alloc_counter.hpp"
+#include "../network/buffer_pool.hpp"
+#include "../network/chat_server.hpp"
+#include "../network/frame_decoder.hpp"
+#include "../network/io_context_pool.hpp"
+#include "../network/message_view.hpp"
+#include "../network/outbound_message.hpp"
+#include "../network/send_queue.hpp"
+
+namespace {
+
+const FrameFormat FORMATS[] = {{1, false}, {2, false}, {2, true}};
+
+Message makeBroadcast(std::size_t contentSize)
+{
+    Message msg(Message::Type::TEXT);
+    msg.setSender("benchmark-user");
+    msg.setContent(std::string(contentSize, 'x'));
+    return msg;
+}
+
+// 不经过网络的模拟会话：只有协商的帧格式和发送队列，写操作视为立即全部完成。
+// 衡量的是每条广播的编码、共享和入队开销，以及每个接收方的分配次数
+void BM_FanOutFrames(benchmark::State& state)
+{
+    struct FakeSession {
+        FrameFormat format;
+        SendQueue queue;
+    };
+
+    std::vector<FakeSession> sessions(static_cast<std::size_t>(state.range(0)));
+    for (std::size_t i = 0; i < sessions.size(); ++i) {
+        sessions[i].format = FORMATS[i % std::size(FORMATS)];
+    }
+    Message msg = makeBroadcast(static_cast<std::size_t>(state.range(1)));
+
+    AllocCounter::Scope allocs;
+    for (auto _ : state) {
+        auto outbound = makeOutbound(msg);
+        for (auto& session : sessions) {
+            session.queue.push(outbound->frame(session.format), msg.getType());
+            auto batch = session.queue.prepareBatch();
+            session.queue.consume(asio::buffer_size(batch));
+        }
+    }
+
+    state.counters["allocs_per_op"] = benchmark::Counter(
+        static_cast<double>(allocs.allocations()), benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FanOutFrames)
+    ->ArgsProduct({{1, 10, 100, 1000, 10000}, {64, 1024}})
+    ->ArgNames({"sessions", "bytes"});
+
+constexpr const char* BENCH_ROOM = "bench-room";
+
+// 进程内的真实服务器：N 个回环连接登录，其中前 roomMembers 个加入 BENCH_ROOM，
+// 测量消息从服务器发出到所有接收方都收到的时间
+class LoopbackClients {
+public:
+    explicit LoopbackClients(std::size_t count, std::size_t roomMembers = 0, std::size_t serverLoops = 1)
+        : serverPool_(serverLoops)
+        , server_(serverPool_, 0)
+    {
+        server_.start();
+        serverThread_ = std::thread([this]() { serverPool_.run(); });
+
+        asio::ip::tcp::endpoint endpoint(asio::ip::make_address("127.0.0.1"), server_.getPort());
+        for (std::size_t i = 0; i < count; ++i) {
+            auto client = std::make_unique<Client>(io_context_);
+            client->socket.connect(endpoint);
+
+            Message login(Message::Type::JOIN);
+            login.setSender("bench-" + std::to_string(i));
+            asio::write(client->socket, asio::buffer(login.encode()));
+            if (i < roomMembers) {
+                Message join(Message::Type::JOIN_ROOM);
+                join.setSender(login.getSender());
+                join.setTarget(BENCH_ROOM);
+                asio::write(client->socket, asio::buffer(join.encode()));
+            }
+
+            read(*client);
+            clients_.push_back(std::move(client));
+        }
+        clientThread_ = std::thread([this]() { io_context_.run(); });
+
+        // 每个新会话都会收到一次在线用户快照，以此确认全部登录完成；
+        // 第 i 个房间成员收到自己和之后每个成员的加入通知
+        while (snapshots_.load() < count || roomJoins_.load() < roomMembers * (roomMembers + 1) / 2) {
+            std::this_thread::yield();
+        }
+    }
+
+    ~LoopbackClients()
+    {
+        work_.reset();
+        asio::post(io_context_, [this]() {
+            for (auto& client : clients_) {
+                asio::error_code ignored;
+                client->socket.close(ignored);
+            }
+        });
+        clientThread_.join();
+        serverPool_.stop();
+        serverThread_.join();
+    }
+
+    ChatServer& server() { return server_; }
+    // 在服务器的事件循环线程上执行，与会话转发消息时所在的线程一致
+    template <typename Handler>
+    void runOnServer(Handler&& handler) { asio::post(serverPool_.getIoContext(0), std::forward<Handler>(handler)); }
+    uint64_t received() const { return texts_.load(); }
+    uint64_t roomReceived() const { return roomTexts_.load(); }
+
+private:
+    struct Client {
+        explicit Client(asio::io_context& ctx) : socket(ctx) {}
+        asio::ip::tcp::socket socket;
+        FrameDecoder decoder;
+    };
+
+    void read(Client& client)
+    {
+        client.socket.async_read_some(client.decoder.prepare(),
+            [this, &client](const asio::error_code& ec, std::size_t length) {
+                if (ec) {
+                    return;
+                }
+                client.decoder.commit(length, [this](const uint8_t* data, std::size_t size) {
+                    MessageView view;
+                    if (view.parse({data, size})) {
+                        if (view.getType() == Message::Type::TEXT) {
+                            texts_.fetch_add(1);
+                        } else if (view.getType() == Message::Type::ROOM_TEXT) {
+                            roomTexts_.fetch_add(1);
+                        } else if (view.getType() == Message::Type::USER_LIST) {
+                            snapshots_.fetch_add(1);
+                        } else if (view.getType() == Message::Type::JOIN_ROOM) {
+                            roomJoins_.fetch_add(1);
+                        }
+                    }
+                    return true;
+                });
+                read(client);
+            });
+    }
+
+    IoContextPool serverPool_;
+    ChatServer server_;
+    std::thread serverThread_;
+
+    asio::io_context io_context_;
+    asio::executor_work_guard<asio::io_context::executor_type> work_{asio::make_work_guard(io_context_)};
+    std::vector<std::unique_ptr<Client>> clients_;
+    std::thread clientThread_;
+    std::atomic<uint64_t> texts_{0};
+    std::atomic<uint64_t> roomTexts_{0};
+    std::atomic<uint64_t> snapshots_{0};
+    std::atomic<uint64_t> roomJoins_{0};
+};
+
+// pool=0 时停用缓冲区池，帧和读缓冲区都直接向分配器申请，对比池对分配次数和耗时的影响
+void BM_BroadcastMessage(benchmark::State& state)
+{
+    std::size_t count = static_cast<std::size_t>(state.range(0));
+    BufferPool::setEnabled(state.range(2) != 0);
+    {
+        LoopbackClients clients(count);
+        Message msg = makeBroadcast(static_cast<std::size_t>(state.range(1)));
+
+        // 计数包含进程内回环客户端的分配，它们在各次比较中保持不变
+        AllocCounter::Scope allocs;
+        auto pool = BufferPool::getGlobalStats();
+        for (auto _ : state) {
+            uint64_t target = clients.received() + count;
+            // 从事件循环线程发布：帧由历史缓存淘汰时归还到编码它的线程的池
+            clients.runOnServer([&clients, &msg]() { clients.server().broadcastMessage(msg); });
+            while (clients.received() < target) {
+                std::this_thread::yield();
+            }
+        }
+        auto poolEnd = BufferPool::getGlobalStats();
+        uint64_t hits = poolEnd.hits - pool.hits;
+        uint64_t misses = poolEnd.acquires - pool.acquires - hits;
+
+        state.counters["allocs_per_op"] = benchmark::Counter(
+            static_cast<double>(allocs.allocations()), benchmark::Counter::kAvgIterations);
+        state.counters["pool_hits"] = benchmark::Counter(static_cast<double>(hits), benchmark::Counter::kAvgIterations);
+        state.counters["pool_misses"] = benchmark::Counter(static_cast<double>(misses), benchmark::Counter::kAvgIterations);
+        state.counters["pool_hit_rate"] = hits + misses ? static_cast<double>(hits) / (hits + misses) : 0.0;
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BufferPool::setEnabled(true);
+}
+BENCHMARK(BM_BroadcastMessage)
+    ->ArgsProduct({{1, 10, 100, 1000}, {64, 1024}, {1, 0}})
+    ->ArgNames({"sessions", "bytes", "pool"})
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+// 房间人数固定为 ROOM_SIZE，服务器总连接数变化：房间消息只查本分片的房间索引，
+// 每条消息的耗时应当与总连接数无关
+void BM_FanOutToRoom(benchmark::State& state)
+{
+    constexpr std::size_t ROOM_SIZE = 10;
+    LoopbackClients clients(static_cast<std::size_t>(state.range(0)), ROOM_SIZE);
+    Message msg(Message::Type::ROOM_TEXT);
+    msg.setSender("benchmark-user");
+    msg.setTarget(BENCH_ROOM);
+    msg.setContent(std::string(64, 'x'));
+
+    AllocCounter::Scope allocs;
+    for (auto _ : state) {
+        uint64_t target = clients.roomReceived() + ROOM_SIZE;
+        clients.server().broadcastToRoom(BENCH_ROOM, msg);
+        while (clients.roomReceived() < target) {
+            std::this_thread::yield();
+        }
+    }
+    state.counters["allocs_per_op"] = benchmark::Counter(
+        static_cast<double>(allocs.allocations()), benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations() * ROOM_SIZE);
+}
+BENCHMARK(BM_FanOutToRoom)
+    ->Arg(100)->Arg(1000)->Arg(5000)
+    ->ArgName("sessions")
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+// 服务器转发一个收到的 TEXT 帧并为三种帧格式各生成一次帧：decode=1 先解码成 Message 再发布，
+// decode=0 只复制收到的原始字节。只计量服务器一侧的转发路径，不含网络
+void BM_RelayFrames(benchmark::State& state)
+{
+    bool decode = state.range(0) != 0;
+    Message msg = makeBroadcast(static_cast<std::size_t>(state.range(2)));
+    auto frame = msg.encode(static_cast<uint8_t>(state.range(1)));
+    MessageView received;
+    received.parse(frame);
+
+    AllocCounter::Scope allocs;
+    for (auto _ : state) {
+        SharedOutbound outbound;
+        if (decode) {
+            Message message;
+            received.toMessage(message);
+            outbound = makeOutbound(std::move(message), received);
+        } else {
+            outbound = makeOutbound(received, 1, 1700000000000);
+        }
+        for (const auto& format : FORMATS) {
+            benchmark::DoNotOptimize(outbound->frame(format).get());
+        }
+    }
+    state.counters["allocs_per_op"] = benchmark::Counter(
+        static_cast<double>(allocs.allocations()), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_RelayFrames)
+    ->ArgsProduct({{1, 0}, {1, 2}, {64, 1024}})
+    ->ArgNames({"decode", "version", "bytes"});
+
+// 端到端转发：一个真实客户端发送 TEXT 帧，服务器转发给其他 range(0) 个会话
+void BM_RelayMessage(benchmark::State& state)
+{
+    std::size_t count = static_cast<std::size_t>(state.range(0));
+    LoopbackClients clients(count);
+    asio::io_context io_context;
+    asio::ip::tcp::socket socket(io_context);
+    socket.connect(asio::ip::tcp::endpoint(asio::ip::make_address("127.0.0.1"), clients.server().getPort()));
+
+    // 发送方只写不读，服务器发给它的在线通知留在接收缓冲区里
+    Message login(Message::Type::JOIN);
+    login.setSender("relay-sender");
+    asio::write(socket, asio::buffer(login.encode()));
+    Message text = makeBroadcast(static_cast<std::size_t>(state.range(1)));
+    text.setSender(login.getSender());
+    auto frame = text.encode();
+
+    // 计数包含进程内回环客户端的分配，它们在各次比较中保持不变
+    AllocCounter::Scope allocs;
+    for (auto _ : state) {
+        uint64_t target = clients.received() + count;
+        asio::write(socket, asio::buffer(frame));
+        while (clients.received() < target) {
+            std::this_thread::yield();
+        }
+    }
+    state.counters["allocs_per_op"] = benchmark::Counter(
+        static_cast<double>(allocs.allocations()), benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_RelayMessage)
+    ->ArgsProduct({{1, 10, 100, 1000}, {64, 1024}})
+    ->ArgNames({"sessions", "bytes"})
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+// 转发路径的分配检查：发送方的帧格式为 range(1)，接收方都是 v1（v2 帧需要重新编码），
+// 会话分布在 range(0) 个事件循环上，跨线程释放的内存要回到分配方线程。
+// 先转发足够多的消息让历史缓存、缓冲区池和块缓存进入稳定状态，之后的转发期间堆分配超出允许次数即报错
+void BM_RelayAllocations(benchmark::State& state)
+{
+    constexpr std::size_t RECEIVERS = 16;
+    constexpr int WARMUP_RELAYS = 3000;  // 远多于服务器历史缓存的容量
+    constexpr int WARMUP_BURSTS = 4;
+    constexpr int BURST_SIZE = 32;
+
+    LoopbackClients clients(RECEIVERS, 0, static_cast<std::size_t>(state.range(0)));
+    asio::io_context io_context;
+    asio::ip::tcp::socket socket(io_context);
+    socket.connect(asio::ip::tcp::endpoint(asio::ip::make_address("127.0.0.1"), clients.server().getPort()));
+
+    Message login(Message::Type::JOIN);
+    login.setSender("relay-sender");
+    asio::write(socket, asio::buffer(login.encode()));
+    Message text = makeBroadcast(64);
+    text.setSender(login.getSender());
+    auto frame = text.encode(static_cast<uint8_t>(state.range(1)));
+
+    auto relay = [&]() {
+        uint64_t target = clients.received() + RECEIVERS;
+        asio::write(socket, asio::buffer(frame));
+        while (clients.received() < target) {
+            std::this_thread::yield();
+        }
+    };
+    for (int i = 0; i < WARMUP_RELAYS; ++i) {
+        relay();
+    }
+    // 再连发一批：帧在其他分片上的释放可能晚于客户端收到，逐条转发时各线程同时在用的
+    // 缓冲区和块也会有几个，一次把库存垫到远高于此的深度
+    for (int round = 0; round < WARMUP_BURSTS; ++round) {
+        uint64_t target = clients.received() + RECEIVERS * BURST_SIZE;
+        for (int i = 0; i < BURST_SIZE; ++i) {
+            asio::write(socket, asio::buffer(frame));
+        }
+        while (clients.received() < target) {
+            std::this_thread::yield();
+        }
+    }
+
+    AllocCounter::Scope allocs;
+    for (auto _ : state) {
+        relay();
+    }
+    // 先取计数：写入 counters 本身会分配
+    uint64_t allocations = allocs.allocations();
+    state.counters["allocs_per_op"] = benchmark::Counter(
+        static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+    // 单个循环上稳定运行时没有任何分配。多个循环时一条消息的其他格式由最先处理它的分片编码，
+    // 缓冲区被历史缓存持有、最后挂回编码方；各分片的库存随先后次序波动，偶尔创下新高时
+    // 要向分配器申请，这部分允许每 200 次转发一次
+    uint64_t allowed = state.range(0) == 1 ? 0 : static_cast<uint64_t>(state.iterations()) / 200;
+    if (allocations > allowed) {
+        std::string error = std::to_string(state.iterations()) + " 次转发中发生了 " +
+                            std::to_string(allocations) + " 次堆分配";
+        state.SkipWithError(error.c_str());
+    }
+}
+BENCHMARK(BM_RelayAllocations)
+    ->ArgsProduct({{1, 2}, {1, 2}})
+    ->ArgNames({"loops", "version"})
+    ->Iterations(2000)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+// 已有 range(0) 个用户在线时，新连接从发起连接到收到第一份在线用户快照的时间。
+// 快照在在线状态合并窗口（100 毫秒）到期时发出，时间主要由窗口决定
+void BM_JoinLatency(benchmark::State& state)
+{
+    LoopbackClients clients(static_cast<std::size_t>(state.range(0)));
+    asio::io_context io_context;
+    asio::ip::tcp::endpoint endpoint(asio::ip::make_address("127.0.0.1"), clients.server().getPort());
+
+    Message login(Message::Type::JOIN);
+    login.setSender("joiner");
+    std::vector<double> samples;
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        asio::ip::tcp::socket socket(io_context);
+        socket.connect(endpoint);
+        asio::write(socket, asio::buffer(login.encode()));
+
+        // 之前可能先收到历史重放和其他用户的在线增量
+        FrameDecoder decoder;
+        bool snapshot = false;
+        while (!snapshot) {
+            asio::error_code ec;
+            std::size_t length = socket.read_some(decoder.prepare(), ec);
+            if (ec) {
+                break;
+            }
+            decoder.commit(length, [&snapshot](const uint8_t* data, std::size_t size) {
+                MessageView view;
+                snapshot = snapshot || (view.parse({data, size}) && view.getType() == Message::Type::USER_LIST);
+                return true;
+            });
+        }
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!snapshot) {
+            state.SkipWithError("没有收到在线用户快照");
+            break;
+        }
+        state.SetIterationTime(elapsed);
+        samples.push_back(elapsed * 1000);
+    }
+
+    std::sort(samples.begin(), samples.end());
+    if (!samples.empty()) {
+        state.counters["p50_ms"] = samples[samples.size() / 2];
+        state.counters["max_ms"] = samples.back();
+    }
+}
+BENCHMARK(BM_JoinLatency)
+    ->Arg(100)->Arg(1000)->Arg(5000)->Arg(9000)
+    ->ArgName("online")
+    ->Iterations(20)
+    ->Unit(benchmark::kMillisecond)
+    ->UseManualTime();
+
+} // namespace
@@ -0,0 +1,193 @@
+#include <benchmark/benchmark.h>
+#include <asio.hpp>
+#include <atomic>
+#include <charconv>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../network/chat_client.hpp"
+#include "../network/frame_decoder.hpp"
+#include "../network/message_view.hpp"
+#include "../network/mpsc_queue.hpp"
+
+namespace {
+
+// 生产者 p 的第 seq 个元素编码为 p * STRIDE + seq，消费者据此检查每个生产者的顺序
+constexpr uint64_t STRIDE = uint64_t(1) << 40;
+
+// 多个线程同时 push、一个线程 pop：检查没有丢失、重复或同一生产者内的乱序
+void BM_MpscQueue(benchmark::State& state)
+{
+    std::size_t producers = static_cast<std::size_t>(state.range(0));
+    constexpr uint64_t PER_PRODUCER = 100000;
+
+    MpscQueue<uint64_t> queue;
+    for (auto _ : state) {
+        std::atomic<bool> go{false};
+        std::vector<std::thread> threads;
+        for (std::size_t p = 0; p < producers; ++p) {
+            threads.emplace_back([&queue, &go, p]() {
+                while (!go.load(std::memory_order_acquire)) {
+                }
+                for (uint64_t seq = 0; seq < PER_PRODUCER; ++seq) {
+                    queue.push(p * STRIDE + seq);
+                }
+            });
+        }
+
+        std::vector<uint64_t> next(producers, 0);
+        uint64_t remaining = producers * PER_PRODUCER;
+        bool ordered = true;
+        go.store(true, std::memory_order_release);
+        while (remaining > 0) {
+            uint64_t value = 0;
+            if (!queue.pop(value)) {
+                continue;
+            }
+            std::size_t p = static_cast<std::size_t>(value / STRIDE);
+            ordered = ordered && p < producers && value % STRIDE == next[p];
+            if (p < producers) {
+                next[p] = value % STRIDE + 1;
+            }
+            --remaining;
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        if (!ordered || !queue.empty()) {
+            state.SkipWithError("MpscQueue 丢失、重复或打乱了元素");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(producers * PER_PRODUCER));
+}
+BENCHMARK(BM_MpscQueue)
+    ->Arg(1)->Arg(2)->Arg(4)->Arg(8)
+    ->ArgName("producers")
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// 模拟界面线程向 ChatClient 连发消息：多个线程同时调用 sendMessage，
+// 事件循环线程批量取出后写入回环连接，对端逐帧检查每个线程的消息都按顺序全部到达
+class HandoffPeer {
+public:
+    HandoffPeer()
+        : acceptor_(serverContext_, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0))
+        , client_(clientContext_)
+    {
+        client_.setAutoReconnect(false);
+        clientThread_ = std::thread([this]() { clientContext_.run(); });
+
+        std::atomic<bool> connected{false};
+        client_.connect("127.0.0.1", acceptor_.local_endpoint().port(),
+                        [&connected](bool success) { connected.store(success); });
+        asio::ip::tcp::socket socket = acceptor_.accept();
+        while (!connected.load()) {
+            std::this_thread::yield();
+        }
+        readerThread_ = std::thread([this, socket = std::move(socket)]() mutable { read(socket); });
+    }
+
+    ~HandoffPeer()
+    {
+        asio::post(clientContext_, [this]() { client_.disconnect(); });
+        readerThread_.join();
+        work_.reset();
+        clientContext_.stop();
+        clientThread_.join();
+    }
+
+    ChatClient& client() { return client_; }
+    uint64_t received() const { return received_.load(); }
+    bool ordered() const { return ordered_.load(); }
+
+private:
+    void read(asio::ip::tcp::socket& socket)
+    {
+        FrameDecoder decoder;
+        std::vector<uint64_t> next;
+        for (;;) {
+            asio::error_code ec;
+            std::size_t length = socket.read_some(decoder.prepare(), ec);
+            if (ec) {
+                return;
+            }
+            decoder.commit(length, [this, &next](const uint8_t* data, std::size_t size) {
+                MessageView view;
+                if (!view.parse({data, size}) || view.getType() != Message::Type::TEXT) {
+                    return true;
+                }
+                uint64_t value = 0;
+                std::string_view content = view.getContent();
+                std::from_chars(content.data(), content.data() + content.size(), value);
+                std::size_t p = static_cast<std::size_t>(value / STRIDE);
+                if (p >= next.size()) {
+                    next.resize(p + 1, 0);
+                }
+                if (value % STRIDE != next[p]) {
+                    ordered_.store(false);
+                }
+                next[p] = value % STRIDE + 1;
+                received_.fetch_add(1);
+                return true;
+            });
+        }
+    }
+
+    asio::io_context serverContext_;
+    asio::ip::tcp::acceptor acceptor_;
+    asio::io_context clientContext_;
+    asio::executor_work_guard<asio::io_context::executor_type> work_{asio::make_work_guard(clientContext_)};
+    ChatClient client_;
+    std::thread clientThread_;
+    std::thread readerThread_;
+    std::atomic<uint64_t> received_{0};
+    std::atomic<bool> ordered_{true};
+};
+
+void BM_ClientSendBurst(benchmark::State& state)
+{
+    std::size_t producers = static_cast<std::size_t>(state.range(0));
+    constexpr uint64_t BURST = 1000;
+
+    HandoffPeer peer;
+    std::vector<uint64_t> sequences(producers, 0);
+    for (auto _ : state) {
+        uint64_t target = peer.received() + producers * BURST;
+        std::vector<std::thread> threads;
+        for (std::size_t p = 0; p < producers; ++p) {
+            threads.emplace_back([&peer, &sequences, p]() {
+                Message msg(Message::Type::TEXT);
+                msg.setSender("burst");
+                for (uint64_t i = 0; i < BURST; ++i) {
+                    msg.setContent(std::to_string(p * STRIDE + sequences[p]++));
+                    peer.client().sendMessage(msg);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        while (peer.received() < target) {
+            std::this_thread::yield();
+        }
+        if (!peer.ordered()) {
+            state.SkipWithError("消息乱序");
+            break;
+        }
+    }
+
+    ChatClient::HandoffStats stats = peer.client().getHandoffStats();
+    state.counters["msgs_per_wakeup"] = stats.wakeups > 0
+        ? static_cast<double>(stats.messages) / static_cast<double>(stats.wakeups) : 0.0;
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(producers * BURST));
+}
+BENCHMARK(BM_ClientSendBurst)
+    ->Arg(1)->Arg(2)->Arg(4)->Arg(8)
+    ->ArgName("producers")
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+} // namespace
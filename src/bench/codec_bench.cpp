@@ -0,0 +1,151 @@
+#include <benchmark/benchmark.h>
+#include <random>
+#include "alloc_counter.hpp"
+#include "../network/message.hpp"
+#include "../network/message_view.hpp"
+
+namespace {
+
+// 随机可打印字符，压缩率接近普通聊天文本而不是全相同字节
+std::string makeContent(std::size_t size)
+{
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> printable(' ', '~');
+    std::string content(size, ' ');
+    for (char& c : content) {
+        c = static_cast<char>(printable(random));
+    }
+    return content;
+}
+
+Message makeMessage(std::size_t contentSize)
+{
+    Message msg(Message::Type::ROOM_TEXT);
+    msg.setSender("benchmark-user");
+    msg.setTarget("benchmark-room");
+    msg.setContent(makeContent(contentSize));
+    msg.setSequence(123456789);
+    msg.setTimestamp(1700000000000);
+    return msg;
+}
+
+void reportAllocations(benchmark::State& state, const AllocCounter::Scope& scope)
+{
+    state.counters["allocs_per_op"] = benchmark::Counter(
+        static_cast<double>(scope.allocations()), benchmark::Counter::kAvgIterations);
+}
+
+// 参数：内容字节数，帧版本
+void codecArgs(benchmark::internal::Benchmark* b)
+{
+    for (int version : {1, 2}) {
+        for (int size : {16, 256, 4 * 1024, 64 * 1024}) {
+            b->Args({size, version});
+        }
+    }
+    b->ArgNames({"bytes", "version"});
+}
+
+// 压缩帧只在内容达到压缩阈值时产生
+void compressedArgs(benchmark::internal::Benchmark* b)
+{
+    for (int version : {1, 2}) {
+        for (int size : {1024, 4 * 1024, 64 * 1024}) {
+            b->Args({size, version});
+        }
+    }
+    b->ArgNames({"bytes", "version"});
+}
+
+void BM_Encode(benchmark::State& state)
+{
+    Message msg = makeMessage(static_cast<std::size_t>(state.range(0)));
+    uint8_t version = static_cast<uint8_t>(state.range(1));
+
+    AllocCounter::Scope allocs;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(msg.encode(version));
+    }
+    reportAllocations(state, allocs);
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Encode)->Apply(codecArgs);
+
+void BM_EncodeShared(benchmark::State& state)
+{
+    Message msg = makeMessage(static_cast<std::size_t>(state.range(0)));
+    uint8_t version = static_cast<uint8_t>(state.range(1));
+
+    AllocCounter::Scope allocs;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(msg.encodeShared(version));
+    }
+    reportAllocations(state, allocs);
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_EncodeShared)->Apply(codecArgs);
+
+void BM_EncodeCompressed(benchmark::State& state)
+{
+    Message msg = makeMessage(static_cast<std::size_t>(state.range(0)));
+    uint8_t version = static_cast<uint8_t>(state.range(1));
+
+    AllocCounter::Scope allocs;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(msg.encodeCompressed(version));
+    }
+    reportAllocations(state, allocs);
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_EncodeCompressed)->Apply(codecArgs);
+
+void BM_Decode(benchmark::State& state)
+{
+    std::vector<uint8_t> frame = makeMessage(static_cast<std::size_t>(state.range(0)))
+                                     .encode(static_cast<uint8_t>(state.range(1)));
+
+    AllocCounter::Scope allocs;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Message::decode(frame.data(), frame.size()));
+    }
+    reportAllocations(state, allocs);
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Decode)->Apply(codecArgs);
+
+void BM_DecodeCompressed(benchmark::State& state)
+{
+    SharedFrame frame = makeMessage(static_cast<std::size_t>(state.range(0)))
+                            .encodeCompressed(static_cast<uint8_t>(state.range(1)));
+    if (!frame) {
+        state.SkipWithError("content was not compressed");
+        return;
+    }
+
+    AllocCounter::Scope allocs;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Message::decode(frame->data(), frame->size()));
+    }
+    reportAllocations(state, allocs);
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DecodeCompressed)->Apply(compressedArgs);
+
+// 服务器转发路径只解析视图，不构造 Message
+void BM_ParseView(benchmark::State& state)
+{
+    std::vector<uint8_t> frame = makeMessage(static_cast<std::size_t>(state.range(0)))
+                                     .encode(static_cast<uint8_t>(state.range(1)));
+
+    AllocCounter::Scope allocs;
+    for (auto _ : state) {
+        MessageView view;
+        benchmark::DoNotOptimize(view.parse(frame));
+        benchmark::DoNotOptimize(view.getContent());
+    }
+    reportAllocations(state, allocs);
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ParseView)->Apply(codecArgs);
+
+} // namespace
@@ -0,0 +1,260 @@
+#include <benchmark/benchmark.h>
+#include <asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../network/chat_client.hpp"
+#include "../network/chat_server.hpp"
+#include "../network/file_store.hpp"
+#include "../network/io_context_pool.hpp"
+
+namespace {
+
+constexpr uint64_t MIB = 1024 * 1024;
+
+uint64_t nowMicros()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// 两个文件内容逐块比较，只在第一轮计时之外做一次
+bool sameContent(const std::filesystem::path& a, const std::filesystem::path& b)
+{
+    std::error_code ec;
+    if (std::filesystem::file_size(a, ec) != std::filesystem::file_size(b, ec) || ec) {
+        return false;
+    }
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> fa(std::fopen(a.string().c_str(), "rb"), &std::fclose);
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> fb(std::fopen(b.string().c_str(), "rb"), &std::fclose);
+    if (!fa || !fb) {
+        return false;
+    }
+    std::vector<char> bufA(MIB), bufB(MIB);
+    for (;;) {
+        std::size_t na = std::fread(bufA.data(), 1, bufA.size(), fa.get());
+        std::size_t nb = std::fread(bufB.data(), 1, bufB.size(), fb.get());
+        if (na != nb || !std::equal(bufA.begin(), bufA.begin() + na, bufB.begin())) {
+            return false;
+        }
+        if (na == 0) {
+            return true;
+        }
+    }
+}
+
+// 进程内的服务器（带文件暂存区）和两个真实的 ChatClient：alice 上传，bob 下载。
+// 传输期间 alice 每 2 毫秒给 bob 发一条私聊，记录私聊的端到端延迟，
+// 检查大文件传输时同一连接上的聊天消息仍然及时送达
+class FileTransferPeers {
+public:
+    explicit FileTransferPeers(const std::filesystem::path& directory)
+        : store_((directory / "store").string(), FileStore::Limits{})
+        , server_(serverPool_, 0)
+        , alice_(clientContext_)
+        , bob_(clientContext_)
+    {
+        server_.setFileStore(&store_);
+        server_.start();
+        serverThread_ = std::thread([this]() { serverPool_.run(); });
+        clientThread_ = std::thread([this]() { clientContext_.run(); });
+
+        for (ChatClient* client : {&alice_, &bob_}) {
+            client->setAutoReconnect(false);
+            client->setFileProgressHandler([this](const ChatClient::FileProgress& progress) {
+                if (progress.finished) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    finished_.set_value(progress);
+                }
+            });
+        }
+        bob_.setMessageHandler([this](const Message& msg) {
+            if (msg.getType() == Message::Type::PRIVATE) {
+                uint64_t sent = std::strtoull(msg.getContent().c_str(), nullptr, 10);
+                std::lock_guard<std::mutex> lock(mutex_);
+                latencies_.push_back(nowMicros() - sent);
+            }
+        });
+
+        login(alice_, "alice");
+        login(bob_, "bob");
+    }
+
+    ~FileTransferPeers()
+    {
+        asio::post(clientContext_, [this]() {
+            alice_.disconnect();
+            bob_.disconnect();
+        });
+        work_.reset();
+        clientThread_.join();
+        serverPool_.stop();
+        serverThread_.join();
+    }
+
+    // 上传 path，返回服务器分配的文件编号；失败时返回空
+    std::string upload(const std::filesystem::path& path)
+    {
+        auto result = transfer([&]() { alice_.sendFile(path.string(), "bob"); });
+        return result.error.empty() ? result.fileId : std::string();
+    }
+
+    bool download(const std::string& fileId, const std::filesystem::path& path)
+    {
+        auto result = transfer([&]() { bob_.downloadFile(fileId, path.string()); });
+        return result.error.empty();
+    }
+
+    // 取出并清空本轮记录的私聊延迟（微秒）
+    std::vector<uint64_t> takeLatencies()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return std::move(latencies_);
+    }
+
+private:
+    void login(ChatClient& client, const std::string& name)
+    {
+        std::promise<bool> connected;
+        auto future = connected.get_future();
+        asio::post(clientContext_, [&]() {
+            client.connect("127.0.0.1", server_.getPort(), [&connected](bool ok) { connected.set_value(ok); });
+        });
+        future.get();
+        Message join(Message::Type::JOIN);
+        join.setSender(name);
+        client.sendMessage(join);
+        // 等服务器处理完登录，之后发出的私聊和文件请求才能找到会话
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    template <typename Start>
+    ChatClient::FileProgress transfer(Start start)
+    {
+        std::future<ChatClient::FileProgress> done;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            finished_ = {};
+            done = finished_.get_future();
+        }
+        start();
+
+        Message probe(Message::Type::PRIVATE);
+        probe.setSender("alice");
+        probe.setTarget("bob");
+        while (done.wait_for(std::chrono::milliseconds(2)) != std::future_status::ready) {
+            probe.setContent(std::to_string(nowMicros()));
+            alice_.sendMessage(probe);
+        }
+        return done.get();
+    }
+
+    FileStore store_;
+    IoContextPool serverPool_{1};
+    ChatServer server_;
+    std::thread serverThread_;
+
+    asio::io_context clientContext_;
+    asio::executor_work_guard<asio::io_context::executor_type> work_{asio::make_work_guard(clientContext_)};
+    ChatClient alice_;
+    ChatClient bob_;
+    std::thread clientThread_;
+
+    std::mutex mutex_;
+    std::promise<ChatClient::FileProgress> finished_;
+    std::vector<uint64_t> latencies_;
+};
+
+double percentileMillis(std::vector<uint64_t> values, double quantile)
+{
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    std::size_t index = std::min(values.size() - 1, static_cast<std::size_t>(quantile * values.size()));
+    return static_cast<double>(values[index]) / 1000.0;
+}
+
+// 上传和下载 range(0) MiB 的文件，分别报告吞吐量和传输期间聊天消息的延迟
+void BM_FileTransfer(benchmark::State& state)
+{
+    uint64_t size = static_cast<uint64_t>(state.range(0)) * MIB;
+    auto directory = std::filesystem::temp_directory_path() /
+        ("chatbench_files_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    std::filesystem::create_directories(directory);
+    auto source = directory / "source.bin";
+    {
+        std::vector<char> block(MIB);
+        std::unique_ptr<std::FILE, int (*)(std::FILE*)> out(std::fopen(source.string().c_str(), "wb"), &std::fclose);
+        for (uint64_t written = 0; written < size; written += MIB) {
+            for (std::size_t i = 0; i < block.size(); i += 64) {
+                block[i] = static_cast<char>((written / 64 + i) * 2654435761u >> 24);
+            }
+            std::fwrite(block.data(), 1, block.size(), out.get());
+        }
+    }
+
+    double uploadSeconds = 0;
+    double downloadSeconds = 0;
+    std::vector<uint64_t> uploadLatencies;
+    std::vector<uint64_t> downloadLatencies;
+    {
+        FileTransferPeers peers(directory);
+        bool verified = false;
+        for (auto _ : state) {
+            auto target = directory / "download.bin";
+            auto start = std::chrono::steady_clock::now();
+            std::string fileId = peers.upload(source);
+            auto uploaded = std::chrono::steady_clock::now();
+            auto uploadChat = peers.takeLatencies();
+            if (fileId.empty() || !peers.download(fileId, target)) {
+                state.SkipWithError("文件传输失败");
+                break;
+            }
+            auto downloaded = std::chrono::steady_clock::now();
+            auto downloadChat = peers.takeLatencies();
+
+            uploadSeconds += std::chrono::duration<double>(uploaded - start).count();
+            downloadSeconds += std::chrono::duration<double>(downloaded - uploaded).count();
+            uploadLatencies.insert(uploadLatencies.end(), uploadChat.begin(), uploadChat.end());
+            downloadLatencies.insert(downloadLatencies.end(), downloadChat.begin(), downloadChat.end());
+            state.SetIterationTime(std::chrono::duration<double>(downloaded - start).count());
+
+            if (!verified) {
+                verified = true;
+                if (!sameContent(source, target)) {
+                    state.SkipWithError("下载的文件与源文件不一致");
+                    break;
+                }
+            }
+        }
+    }
+
+    double mib = static_cast<double>(size) / MIB * static_cast<double>(state.iterations());
+    state.counters["upload_MiBps"] = uploadSeconds > 0 ? mib / uploadSeconds : 0.0;
+    state.counters["download_MiBps"] = downloadSeconds > 0 ? mib / downloadSeconds : 0.0;
+    state.counters["chat_up_p50_ms"] = percentileMillis(uploadLatencies, 0.5);
+    state.counters["chat_up_p99_ms"] = percentileMillis(uploadLatencies, 0.99);
+    state.counters["chat_down_p50_ms"] = percentileMillis(downloadLatencies, 0.5);
+    state.counters["chat_down_p99_ms"] = percentileMillis(downloadLatencies, 0.99);
+    state.SetBytesProcessed(static_cast<int64_t>(2 * size) * state.iterations());
+
+    std::error_code ec;
+    std::filesystem::remove_all(directory, ec);
+}
+BENCHMARK(BM_FileTransfer)
+    ->Arg(16)->Arg(256)->Arg(512)
+    ->ArgName("MiB")
+    ->Iterations(2)
+    ->Unit(benchmark::kMillisecond)
+    ->UseManualTime();
+
+} // namespace
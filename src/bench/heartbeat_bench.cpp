@@ -0,0 +1,141 @@
+#include <benchmark/benchmark.h>
+#include <asio.hpp>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "../network/heartbeat_wheel.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// 与服务器相同的参数：15 秒超时，1 秒一格的 32 槽时间轮
+constexpr auto HEARTBEAT_TIMEOUT = std::chrono::seconds(15);
+constexpr auto WHEEL_TICK = std::chrono::seconds(1);
+constexpr std::size_t WHEEL_SLOTS = 32;
+
+// 只有心跳状态的会话，接口与 ChatSession 中时间轮用到的部分一致
+struct FakeSession {
+    Clock::time_point lastHeartbeat{Clock::now()};
+    bool closed{false};
+
+    Clock::time_point getHeartbeatDeadline() const { return lastHeartbeat + HEARTBEAT_TIMEOUT; }
+    bool isClosed() const { return closed; }
+    void onHeartbeatTimeout() { closed = true; }
+};
+
+std::vector<std::shared_ptr<FakeSession>> makeSessions(std::size_t count)
+{
+    std::vector<std::shared_ptr<FakeSession>> sessions;
+    sessions.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        sessions.push_back(std::make_shared<FakeSession>());
+    }
+    return sessions;
+}
+
+// 每个会话收到一条消息时的开销。时间轮只记下当前时间
+void BM_HeartbeatRefresh_Wheel(benchmark::State& state)
+{
+    asio::io_context io_context;
+    BasicHeartbeatWheel<FakeSession> wheel(io_context, WHEEL_TICK, WHEEL_SLOTS);
+    auto sessions = makeSessions(static_cast<std::size_t>(state.range(0)));
+    for (const auto& session : sessions) {
+        wheel.add(session);
+    }
+
+    for (auto _ : state) {
+        for (const auto& session : sessions) {
+            session->lastHeartbeat = Clock::now();
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_HeartbeatRefresh_Wheel)->Arg(10000)->Arg(100000)->ArgName("sessions");
+
+// 每个会话一个定时器时，每条消息都要重新设定到期时间：取消挂起的等待（其处理器以
+// operation_aborted 完成）再重新等待。计时包含执行被取消的处理器
+void BM_HeartbeatRefresh_Timer(benchmark::State& state)
+{
+    asio::io_context io_context;
+    std::vector<std::unique_ptr<asio::steady_timer>> timers;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        timers.push_back(std::make_unique<asio::steady_timer>(io_context));
+        timers.back()->expires_after(HEARTBEAT_TIMEOUT);
+        timers.back()->async_wait([](const asio::error_code&) {});
+    }
+
+    for (auto _ : state) {
+        for (auto& timer : timers) {
+            timer->expires_after(HEARTBEAT_TIMEOUT);
+            timer->async_wait([](const asio::error_code&) {});
+        }
+        io_context.poll();
+        io_context.restart();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_HeartbeatRefresh_Timer)->Arg(10000)->Arg(100000)->ArgName("sessions");
+
+// 全部会话同时超时：时间轮在一个槽里逐个检查并关闭
+void BM_HeartbeatExpire_Wheel(benchmark::State& state)
+{
+    asio::io_context io_context;
+    BasicHeartbeatWheel<FakeSession> wheel(io_context, WHEEL_TICK, WHEEL_SLOTS);
+    auto sessions = makeSessions(static_cast<std::size_t>(state.range(0)));
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (const auto& session : sessions) {
+            session->lastHeartbeat = Clock::now() - 2 * HEARTBEAT_TIMEOUT;
+            session->closed = false;
+            wheel.add(session);
+        }
+        state.ResumeTiming();
+
+        // 截止时间已过的会话都挂在下一个槽上
+        wheel.onTick();
+    }
+    if (wheel.size() != 0 || !sessions.back()->closed) {
+        state.SkipWithError("时间轮没有关闭全部会话");
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_HeartbeatExpire_Wheel)->Arg(10000)->Arg(100000)->ArgName("sessions");
+
+// 全部会话同时超时：每个定时器各自到期，各自执行一次处理器
+void BM_HeartbeatExpire_Timer(benchmark::State& state)
+{
+    asio::io_context io_context;
+    std::vector<std::unique_ptr<asio::steady_timer>> timers;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        timers.push_back(std::make_unique<asio::steady_timer>(io_context));
+    }
+    auto sessions = makeSessions(timers.size());
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto expired = Clock::now() - HEARTBEAT_TIMEOUT;
+        for (std::size_t i = 0; i < timers.size(); ++i) {
+            sessions[i]->closed = false;
+            timers[i]->expires_at(expired);
+            timers[i]->async_wait([session = sessions[i].get()](const asio::error_code& ec) {
+                if (!ec) {
+                    session->onHeartbeatTimeout();
+                }
+            });
+        }
+        state.ResumeTiming();
+
+        io_context.run();
+        io_context.restart();
+    }
+    if (!sessions.back()->closed) {
+        state.SkipWithError("定时器没有关闭全部会话");
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_HeartbeatExpire_Timer)->Arg(10000)->Arg(100000)->ArgName("sessions");
+
+} // namespace
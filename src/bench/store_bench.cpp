@@ -0,0 +1,214 @@
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sqlite3.h>
+#include "../database/message_store.hpp"
+#include "../database/message_writer.hpp"
+
+namespace {
+
+constexpr std::size_t INSERT_BATCH = 10000;
+constexpr uint64_t BASE_TIME_MS = 1700000000000;  // 第 i 行的服务器时间为 BASE_TIME_MS + i 秒
+
+// 10M 行的库生成要几分钟，按行数缓存在临时目录里，多次运行之间复用。
+// 缓存库的 seq 恰好是 1..rows，基准中插入的行 seq 为 0，结束后删除
+std::string datasetPath(int64_t rows)
+{
+    auto path = std::filesystem::temp_directory_path() /
+                ("chat_bench_store_" + std::to_string(rows) + ".db");
+    return path.string();
+}
+
+bool execute(const std::string& path, const char* sql)
+{
+    sqlite3* db = nullptr;
+    bool ok = sqlite3_open(path.c_str(), &db) == SQLITE_OK &&
+              sqlite3_exec(db, sql, nullptr, nullptr, nullptr) == SQLITE_OK;
+    sqlite3_close(db);
+    return ok;
+}
+
+std::unique_ptr<MessageStore> openDataset(int64_t rows)
+{
+    std::string path = datasetPath(rows);
+    auto store = std::make_unique<MessageStore>(path);
+    if (!store->initialize()) {
+        return nullptr;
+    }
+    if (store->getMaxSequence() == static_cast<uint64_t>(rows)) {
+        return store;
+    }
+
+    std::cerr << "生成 " << rows << " 行测试数据: " << path << std::endl;
+    store.reset();
+    std::filesystem::remove(path);
+    store = std::make_unique<MessageStore>(path);
+    if (!store->initialize() || !store->enableWriteAheadLog()) {
+        return nullptr;
+    }
+
+    std::vector<Message> batch;
+    batch.reserve(INSERT_BATCH);
+    for (int64_t i = 0; i < rows; ++i) {
+        Message msg(i % 10 == 0 ? Message::Type::ROOM_TEXT : Message::Type::TEXT);
+        msg.setSender("user-" + std::to_string(i % 1000));
+        msg.setContent("benchmark message " + std::to_string(i) + " with a typical chat length");
+        if (msg.getType() == Message::Type::ROOM_TEXT) {
+            msg.setTarget("room-" + std::to_string(i % 50));
+        }
+        msg.setSequence(static_cast<uint64_t>(i + 1));
+        msg.setTimestamp(BASE_TIME_MS + static_cast<uint64_t>(i) * 1000);
+        batch.push_back(std::move(msg));
+
+        if (batch.size() == INSERT_BATCH || i + 1 == rows) {
+            if (!store->storeMessages(batch)) {
+                return nullptr;
+            }
+            batch.clear();
+        }
+    }
+    return store;
+}
+
+// 客户端的 MessageStore 与测试库使用同一时间格式，用本地时区换算
+std::string timestampAt(int64_t row)
+{
+    std::time_t seconds = static_cast<std::time_t>((BASE_TIME_MS / 1000) + row);
+    std::tm tm{};
+#ifdef _WIN32
+    localtime_s(&tm, &seconds);
+#else
+    localtime_r(&seconds, &tm);
+#endif
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm);
+    return buffer;
+}
+
+void storeArgs(benchmark::internal::Benchmark* b)
+{
+    b->RangeMultiplier(10)->Range(10000, 10000000)->ArgName("rows")->Unit(benchmark::kMicrosecond);
+}
+
+void BM_StoreMessage(benchmark::State& state)
+{
+    auto store = openDataset(state.range(0));
+    if (!store) {
+        state.SkipWithError("cannot create benchmark database");
+        return;
+    }
+
+    Message msg(Message::Type::TEXT);
+    msg.setSender("benchmark-user");
+    msg.setContent("a freshly sent chat message");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(store->storeMessage(msg));
+    }
+
+    store.reset();
+    execute(datasetPath(state.range(0)), "DELETE FROM messages WHERE seq = 0");
+}
+BENCHMARK(BM_StoreMessage)->Apply(storeArgs);
+
+void BM_GetMessages(benchmark::State& state)
+{
+    auto store = openDataset(state.range(0));
+    if (!store) {
+        state.SkipWithError("cannot create benchmark database");
+        return;
+    }
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(store->getMessages(50));
+    }
+    state.SetItemsProcessed(state.iterations() * 50);
+}
+BENCHMARK(BM_GetMessages)->Apply(storeArgs);
+
+void BM_GetRoomMessages(benchmark::State& state)
+{
+    auto store = openDataset(state.range(0));
+    if (!store) {
+        state.SkipWithError("cannot create benchmark database");
+        return;
+    }
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(store->getRoomMessages("room-0", 50));
+    }
+}
+BENCHMARK(BM_GetRoomMessages)->Apply(storeArgs);
+
+// 取最后 100 行
+void BM_GetMessagesSince(benchmark::State& state)
+{
+    auto store = openDataset(state.range(0));
+    if (!store) {
+        state.SkipWithError("cannot create benchmark database");
+        return;
+    }
+
+    std::string since = timestampAt(state.range(0) - 101);
+    std::size_t rows = 0;
+    for (auto _ : state) {
+        auto messages = store->getMessagesSince(since);
+        rows = messages.size();
+        benchmark::DoNotOptimize(messages);
+    }
+    state.counters["rows"] = static_cast<double>(rows);
+}
+BENCHMARK(BM_GetMessagesSince)->Apply(storeArgs);
+
+// 服务器的持久化路径：事件循环把消息交给 AsyncMessageWriter，写线程按 range(0) 条一个事务提交。
+// 每轮入队 WRITER_MESSAGES 条并等到全部落盘，报告每秒落盘的行数和平均每个事务的行数
+void BM_AsyncWriter(benchmark::State& state)
+{
+    constexpr std::size_t WRITER_MESSAGES = 20000;
+    auto path = std::filesystem::temp_directory_path() /
+                ("chat_bench_writer_" + std::to_string(state.range(0)) + ".db");
+    std::filesystem::remove(path);
+
+    AsyncMessageWriter::Stats stats;
+    {
+        // 等待攒批的时间缩短到 1 毫秒，每轮结束时不满一批的尾巴不会拖长计时
+        AsyncMessageWriter writer(path.string(), static_cast<std::size_t>(state.range(0)),
+                                  std::chrono::milliseconds(1), WRITER_MESSAGES);
+        Message msg(Message::Type::TEXT);
+        msg.setSender("benchmark-user");
+        msg.setContent("a freshly sent chat message");
+
+        uint64_t sequence = 0;
+        for (auto _ : state) {
+            for (std::size_t i = 0; i < WRITER_MESSAGES; ++i) {
+                msg.setSequence(++sequence);
+                msg.setTimestamp(BASE_TIME_MS + sequence);
+                writer.enqueue(msg);
+            }
+            while (writer.getStats().written + writer.getStats().dropped < sequence) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+        stats = writer.getStats();
+    }
+
+    state.counters["rows_per_txn"] = stats.batches ? static_cast<double>(stats.written) / stats.batches : 0.0;
+    state.counters["dropped"] = static_cast<double>(stats.dropped);
+    state.SetItemsProcessed(static_cast<int64_t>(stats.written));
+
+    std::error_code ec;
+    for (const char* suffix : {"", "-wal", "-shm"}) {
+        std::filesystem::remove(path.string() + suffix, ec);
+    }
+}
+BENCHMARK(BM_AsyncWriter)
+    ->RangeMultiplier(4)->Range(1, 4096)
+    ->ArgName("batch")
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+} // namespace
@@ -1,4 +1,5 @@
 #include "message_store.hpp"
+#include <algorithm>
 #include <chrono>
 #include <iomanip>
 #include <sstream>
@@ -29,33 +30,103 @@ bool MessageStore::initialize()
         "sender TEXT NOT NULL,"
         "content TEXT NOT NULL,"
         "timestamp TEXT NOT NULL,"
-        "type INTEGER NOT NULL"
+        "type INTEGER NOT NULL,"
+        "room TEXT NOT NULL DEFAULT '',"
+        "seq INTEGER NOT NULL DEFAULT 0,"
+        "server_time INTEGER NOT NULL DEFAULT 0"
         ")";
 
-    return executeQuery(createTableSQL);
+    if (!executeQuery(createTableSQL)) {
+        return false;
+    }
+
+    // 旧版本创建的表缺少后来增加的列，补上；列已存在时语句失败，可以忽略
+    executeQuery("ALTER TABLE messages ADD COLUMN room TEXT NOT NULL DEFAULT ''");
+    executeQuery("ALTER TABLE messages ADD COLUMN seq INTEGER NOT NULL DEFAULT 0");
+    executeQuery("ALTER TABLE messages ADD COLUMN server_time INTEGER NOT NULL DEFAULT 0");
+    return executeQuery("CREATE INDEX IF NOT EXISTS idx_messages_room ON messages(room, id)");
 }
 
 bool MessageStore::storeMessage(const Message& msg)
 {
     const char* sql = 
-        "INSERT INTO messages (sender, content, timestamp, type) "
-        "VALUES (?, ?, ?, ?)";
+        "INSERT INTO messages (sender, content, timestamp, type, room, seq, server_time) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?)";
 
     sqlite3_stmt* stmt;
     if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
         return false;
     }
 
+    std::string timestamp = timestampOf(msg);
     sqlite3_bind_text(stmt, 1, msg.getSender().c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 2, msg.getContent().c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 3, getCurrentTimestamp().c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, timestamp.c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_int(stmt, 4, static_cast<int>(msg.getType()));
+    sqlite3_bind_text(stmt, 5, roomOf(msg).c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 6, static_cast<sqlite3_int64>(msg.getSequence()));
+    sqlite3_bind_int64(stmt, 7, static_cast<sqlite3_int64>(msg.getTimestamp()));
 
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
     sqlite3_finalize(stmt);
     return success;
 }
 
+bool MessageStore::storeMessages(const std::vector<Message>& messages)
+{
+    if (messages.empty()) {
+        return true;
+    }
+
+    const char* sql = 
+        "INSERT INTO messages (sender, content, timestamp, type, room, seq, server_time) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?)";
+
+    if (!executeQuery("BEGIN TRANSACTION")) {
+        return false;
+    }
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        executeQuery("ROLLBACK");
+        return false;
+    }
+
+    // 文本时间戳精度是秒，同一秒内的消息复用同一个格式化结果
+    std::string timestamp;
+    uint64_t timestampSecond = UINT64_MAX;
+    bool success = true;
+    for (const auto& msg : messages) {
+        uint64_t second = msg.getTimestamp() / 1000;
+        if (msg.getTimestamp() == 0 || second != timestampSecond) {
+            timestamp = timestampOf(msg);
+            timestampSecond = msg.getTimestamp() ? second : UINT64_MAX;
+        }
+        sqlite3_bind_text(stmt, 1, msg.getSender().c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, msg.getContent().c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, timestamp.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 4, static_cast<int>(msg.getType()));
+        sqlite3_bind_text(stmt, 5, roomOf(msg).c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 6, static_cast<sqlite3_int64>(msg.getSequence()));
+        sqlite3_bind_int64(stmt, 7, static_cast<sqlite3_int64>(msg.getTimestamp()));
+
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            success = false;
+            break;
+        }
+        sqlite3_reset(stmt);
+    }
+
+    sqlite3_finalize(stmt);
+    return executeQuery(success ? "COMMIT" : "ROLLBACK") && success;
+}
+
+bool MessageStore::enableWriteAheadLog()
+{
+    return executeQuery("PRAGMA journal_mode=WAL") &&
+           executeQuery("PRAGMA synchronous=NORMAL");
+}
+
 std::vector<MessageStore::StoredMessage> MessageStore::getMessages(size_t limit)
 {
     std::vector<StoredMessage> messages;
@@ -84,6 +155,58 @@ std::vector<MessageStore::StoredMessage> MessageStore::getMessages(size_t limit)
     return messages;
 }
 
+std::vector<MessageStore::StoredMessage> MessageStore::getRoomMessages(
+    const std::string& room, size_t limit)
+{
+    std::vector<StoredMessage> messages;
+    const char* sql = 
+        "SELECT id, sender, content, timestamp, type, room, seq, server_time "
+        "FROM messages WHERE room = ? ORDER BY id DESC LIMIT ?";
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return messages;
+    }
+
+    sqlite3_bind_text(stmt, 1, room.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(limit));
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        StoredMessage msg;
+        msg.id = sqlite3_column_int64(stmt, 0);
+        msg.sender = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        msg.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+        msg.timestamp = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+        msg.type = static_cast<Message::Type>(sqlite3_column_int(stmt, 4));
+        msg.room = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+        msg.sequence = static_cast<uint64_t>(sqlite3_column_int64(stmt, 6));
+        msg.serverTime = static_cast<uint64_t>(sqlite3_column_int64(stmt, 7));
+        messages.push_back(msg);
+    }
+
+    sqlite3_finalize(stmt);
+    std::reverse(messages.begin(), messages.end());
+    return messages;
+}
+
+uint64_t MessageStore::getMaxSequence()
+{
+    const char* sql = "SELECT MAX(seq) FROM messages";
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return 0;
+    }
+
+    uint64_t sequence = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        sequence = static_cast<uint64_t>(sqlite3_column_int64(stmt, 0));
+    }
+
+    sqlite3_finalize(stmt);
+    return sequence;
+}
+
 std::vector<MessageStore::StoredMessage> MessageStore::getMessagesSince(
     const std::string& timestamp)
 {
@@ -133,11 +256,27 @@ bool MessageStore::executeQuery(const std::string& query)
     return true;
 }
 
+const std::string& MessageStore::roomOf(const Message& msg)
+{
+    static const std::string globalRoom;
+    return msg.getType() == Message::Type::ROOM_TEXT ? msg.getTarget() : globalRoom;
+}
+
 std::string MessageStore::getCurrentTimestamp()
 {
-    auto now = std::chrono::system_clock::now();
-    auto time = std::chrono::system_clock::to_time_t(now);
-    
+    return formatTimestamp(std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()));
+}
+
+std::string MessageStore::timestampOf(const Message& msg)
+{
+    if (msg.getTimestamp() == 0) {
+        return getCurrentTimestamp();
+    }
+    return formatTimestamp(static_cast<std::time_t>(msg.getTimestamp() / 1000));
+}
+
+std::string MessageStore::formatTimestamp(std::time_t time)
+{
     std::tm tm_buf;
 #ifdef _WIN32
     localtime_s(&tm_buf, &time);
@@ -148,4 +287,4 @@ std::string MessageStore::getCurrentTimestamp()
     std::stringstream ss;
     ss << std::put_time(&tm_buf, "%Y-%m-%d %H:%M:%S");
     return ss.str();
-} 
\ No newline at end of file
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <ctime>
 #include <string>
 #include <vector>
 #include <memory>
@@ -13,6 +14,9 @@ public:
         std::string content;
         std::string timestamp;
         Message::Type type;
+        std::string room;   // 房间名，全局聊天为空
+        uint64_t sequence{0};    // 服务器分配的序号，v1 时代的消息为 0
+        uint64_t serverTime{0};  // 服务器时间戳（Unix 毫秒），没有时为 0
     };
 
     explicit MessageStore(const std::string& dbPath);
@@ -24,9 +28,21 @@ public:
     // 存储消息
     bool storeMessage(const Message& msg);
     
+    // 在一个事务中批量存储消息，复用同一条预编译语句
+    bool storeMessages(const std::vector<Message>& messages);
+    
+    // 切换到 WAL 日志模式，适合持续写入的服务器端数据库
+    bool enableWriteAheadLog();
+    
     // 获取历史消息
     std::vector<StoredMessage> getMessages(size_t limit = 50);
     
+    // 获取某个房间最近的消息（按写入顺序从旧到新），全局聊天的房间名为空
+    std::vector<StoredMessage> getRoomMessages(const std::string& room, size_t limit);
+    
+    // 已存储消息的最大服务器序号，服务器重启后从这里继续分配
+    uint64_t getMaxSequence();
+    
     // 获取特定时间之后的消息
     std::vector<StoredMessage> getMessagesSince(const std::string& timestamp);
     
@@ -36,6 +52,10 @@ public:
 private:
     bool executeQuery(const std::string& query);
     static std::string getCurrentTimestamp();
+    // 有服务器时间戳时使用服务器时间，否则使用本机当前时间
+    static std::string timestampOf(const Message& msg);
+    static std::string formatTimestamp(std::time_t time);
+    static const std::string& roomOf(const Message& msg);
 
     sqlite3* db_{nullptr};
     std::string dbPath_;
@@ -0,0 +1,126 @@
+#include "message_writer.hpp"
+#include <algorithm>
+
+AsyncMessageWriter::AsyncMessageWriter(const std::string& dbPath,
+                                       std::size_t maxBatch,
+                                       std::chrono::milliseconds maxDelay,
+                                       std::size_t maxPending)
+    : store_(std::make_unique<MessageStore>(dbPath))
+    , maxBatch_(std::max<std::size_t>(maxBatch, 1))
+    , maxDelay_(maxDelay)
+    , maxPending_(maxPending)
+{
+    store_->enableWriteAheadLog();
+    lastSequence_ = store_->getMaxSequence();
+    thread_ = std::thread([this]() { run(); });
+}
+
+AsyncMessageWriter::~AsyncMessageWriter()
+{
+    stop();
+}
+
+bool AsyncMessageWriter::enqueue(Message msg)
+{
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || pending_.size() >= maxPending_) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        pending_.push_back(std::move(msg));
+        // 只在写线程可能空闲或刚攒满一批时唤醒，避免每条消息一次系统调用
+        wake = pending_.size() == 1 || pending_.size() == maxBatch_;
+    }
+    enqueued_.fetch_add(1, std::memory_order_relaxed);
+    if (wake) {
+        cv_.notify_one();
+    }
+    return true;
+}
+
+void AsyncMessageWriter::submitQuery(QueryTask task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            return;
+        }
+        queries_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+}
+
+void AsyncMessageWriter::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+AsyncMessageWriter::Stats AsyncMessageWriter::getStats() const
+{
+    Stats stats;
+    stats.enqueued = enqueued_.load(std::memory_order_relaxed);
+    stats.written = written_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.batches = batches_.load(std::memory_order_relaxed);
+    stats.failedBatches = failedBatches_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void AsyncMessageWriter::run()
+{
+    std::vector<Message> batch;
+    std::vector<Message> chunk;
+    std::vector<QueryTask> queries;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return stopping_ || !pending_.empty() || !queries_.empty(); });
+            if (pending_.empty() && queries_.empty()) {
+                break;  // 正在停止且已写完
+            }
+
+            // 不满一批时再等一小段时间，让更多消息进入同一个事务；有查询等待时立即处理
+            if (!stopping_ && queries_.empty() && pending_.size() < maxBatch_) {
+                cv_.wait_for(lock, maxDelay_, [this]() {
+                    return stopping_ || !queries_.empty() || pending_.size() >= maxBatch_;
+                });
+            }
+            batch.swap(pending_);
+            queries.swap(queries_);
+        }
+
+        // 持锁期间只交换队列，磁盘写入在锁外进行；积压过多时按批大小拆分事务
+        for (std::size_t begin = 0; begin < batch.size(); begin += maxBatch_) {
+            std::size_t end = std::min(batch.size(), begin + maxBatch_);
+            const std::vector<Message>* messages = &batch;
+            if (begin > 0 || end < batch.size()) {
+                chunk.assign(std::make_move_iterator(batch.begin() + begin),
+                             std::make_move_iterator(batch.begin() + end));
+                messages = &chunk;
+            }
+
+            if (store_->storeMessages(*messages)) {
+                written_.fetch_add(messages->size(), std::memory_order_relaxed);
+            } else {
+                failedBatches_.fetch_add(1, std::memory_order_relaxed);
+            }
+            batches_.fetch_add(1, std::memory_order_relaxed);
+        }
+        batch.clear();
+
+        for (auto& query : queries) {
+            query(*store_);
+        }
+        queries.clear();
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "message_store.hpp"
+
+// 后写式持久化：事件循环只把消息放进内存队列，
+// 由独立的写线程攒批后在一个 SQLite 事务中提交，磁盘速度不影响事件循环延迟。
+// 历史查询也交给写线程执行，与写入共用同一个连接
+class AsyncMessageWriter {
+public:
+    using QueryTask = std::function<void(MessageStore&)>;
+
+    struct Stats {
+        uint64_t enqueued{0};
+        uint64_t written{0};
+        uint64_t dropped{0};       // 队列满时丢弃的消息
+        uint64_t batches{0};
+        uint64_t failedBatches{0};
+    };
+
+    explicit AsyncMessageWriter(const std::string& dbPath,
+                                std::size_t maxBatch = 512,
+                                std::chrono::milliseconds maxDelay = std::chrono::milliseconds(50),
+                                std::size_t maxPending = 100000);
+    ~AsyncMessageWriter();
+
+    AsyncMessageWriter(const AsyncMessageWriter&) = delete;
+    AsyncMessageWriter& operator=(const AsyncMessageWriter&) = delete;
+
+    // 可在任意线程调用，不会阻塞在磁盘 I/O 上；队列已满时返回 false
+    bool enqueue(Message msg);
+
+    // 在写线程上执行查询，执行前会先写完已入队的消息；task 负责把结果投递回调用方线程
+    void submitQuery(QueryTask task);
+
+    // 写完队列中剩余的消息后停止写线程
+    void stop();
+
+    Stats getStats() const;
+
+    // 启动时数据库中已有的最大服务器序号
+    uint64_t getLastSequence() const { return lastSequence_; }
+
+private:
+    void run();
+
+    std::unique_ptr<MessageStore> store_;
+    std::size_t maxBatch_;
+    std::chrono::milliseconds maxDelay_;
+    std::size_t maxPending_;
+    uint64_t lastSequence_{0};
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<Message> pending_;
+    std::vector<QueryTask> queries_;
+    bool stopping_{false};
+
+    std::atomic<uint64_t> enqueued_{0};
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> batches_{0};
+    std::atomic<uint64_t> failedBatches_{0};
+
+    std::thread thread_;
+};
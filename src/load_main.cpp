@@ -0,0 +1,181 @@
+#include <iostream>
+#include <fstream>
+#include <asio.hpp>
+#include "loadtest/load_generator.hpp"
+#include "network/io_context_pool.hpp"
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+static void printUsage()
+{
+    std::cout << "用法: ChatLoadGen <主机> <端口号> [--clients <连接数>] [--threads <线程数>]\n";
+    std::cout << "                  [--rate <每客户端每秒消息数>] [--payload <字节数>|<最小>-<最大>]\n";
+    std::cout << "                  [--rooms <房间数>|--private] [--ramp <秒>] [--duration <秒>] [--drain <秒>]\n";
+    std::cout << "                  [--ports <端口号>,<端口号>...] [--report <JSON 报告路径>]\n";
+    std::cout << "示例: ChatLoadGen 127.0.0.1 8080 --clients 2000 --threads 4 --rate 0.5 --payload 32-512\n";
+}
+
+static bool isNumber(const std::string& str)
+{
+    return !str.empty() && std::all_of(str.begin(), str.end(), ::isdigit);
+}
+
+static bool parseSeconds(const std::string& str, std::chrono::milliseconds& out)
+{
+    try {
+        std::size_t used = 0;
+        double seconds = std::stod(str, &used);
+        if (used != str.size() || seconds < 0) {
+            return false;
+        }
+        out = std::chrono::milliseconds(static_cast<long long>(seconds * 1000));
+        return true;
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+}
+
+// 逗号分隔的端口列表，客户端轮流连接
+static bool parsePorts(const std::string& str, std::vector<uint16_t>& ports)
+{
+    std::vector<uint16_t> parsed;
+    std::size_t begin = 0;
+    while (begin <= str.size()) {
+        auto comma = str.find(',', begin);
+        std::string item = str.substr(begin, comma == std::string::npos ? std::string::npos : comma - begin);
+        if (!isNumber(item) || item.size() > 5 || std::stoi(item) <= 0 || std::stoi(item) > 65535) {
+            return false;
+        }
+        parsed.push_back(static_cast<uint16_t>(std::stoi(item)));
+        if (comma == std::string::npos) {
+            break;
+        }
+        begin = comma + 1;
+    }
+    ports = std::move(parsed);
+    return true;
+}
+
+static bool parsePayload(const std::string& str, std::size_t& min, std::size_t& max)
+{
+    auto dash = str.find('-');
+    std::string low = str.substr(0, dash);
+    std::string high = dash == std::string::npos ? low : str.substr(dash + 1);
+    if (!isNumber(low) || !isNumber(high)) {
+        return false;
+    }
+    min = std::stoull(low);
+    max = std::stoull(high);
+    return min <= max;
+}
+
+int main(int argc, char* argv[])
+{
+#ifdef _WIN32
+    // 设置控制台输出编码为 UTF-8
+    SetConsoleOutputCP(CP_UTF8);
+#endif
+
+    try {
+        if (argc < 3) {
+            printUsage();
+            return 1;
+        }
+
+        LoadGenerator::Config config;
+        config.host = argv[1];
+
+        std::string port_str = argv[2];
+        if (!isNumber(port_str) || std::stoi(port_str) <= 0 || std::stoi(port_str) > 65535) {
+            std::cout << "错误: 端口必须在 1-65535 之间\n";
+            return 1;
+        }
+        config.port = static_cast<uint16_t>(std::stoi(port_str));
+
+        std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        std::string reportPath;
+
+        for (int i = 3; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--clients" && hasValue && isNumber(argv[i + 1])) {
+                config.clients = std::stoull(argv[++i]);
+            } else if (arg == "--threads" && hasValue && isNumber(argv[i + 1])) {
+                threads = std::stoull(argv[++i]);
+                if (threads == 0) {
+                    std::cout << "错误: 线程数必须大于 0\n";
+                    return 1;
+                }
+            } else if (arg == "--rate" && hasValue) {
+                try {
+                    config.rate = std::stod(argv[++i]);
+                }
+                catch (const std::exception&) {
+                    printUsage();
+                    return 1;
+                }
+            } else if (arg == "--payload" && hasValue &&
+                       parsePayload(argv[i + 1], config.payloadMin, config.payloadMax)) {
+                ++i;
+            } else if (arg == "--rooms" && hasValue && isNumber(argv[i + 1])) {
+                config.rooms = std::stoull(argv[++i]);
+            } else if (arg == "--private") {
+                config.direct = true;
+            } else if (arg == "--ramp" && hasValue && parseSeconds(argv[i + 1], config.ramp)) {
+                ++i;
+            } else if (arg == "--duration" && hasValue && parseSeconds(argv[i + 1], config.duration)) {
+                ++i;
+            } else if (arg == "--drain" && hasValue && parseSeconds(argv[i + 1], config.drain)) {
+                ++i;
+            } else if (arg == "--ports" && hasValue && parsePorts(argv[i + 1], config.ports)) {
+                ++i;
+            } else if (arg == "--report" && hasValue) {
+                reportPath = argv[++i];
+            } else {
+                printUsage();
+                return 1;
+            }
+        }
+
+        IoContextPool pool(threads);
+        LoadGenerator generator(pool, config);
+        generator.start();
+
+        std::cout << "压测 " << config.host << ":" << config.port << "，" << config.clients
+                  << " 个连接，" << threads << " 个事件循环 (" << IoContextPool::getBackendName()
+                  << ")\n";
+
+        asio::signal_set signals(pool.getIoContext(0), SIGINT, SIGTERM);
+        signals.async_wait([&pool](const asio::error_code& ec, int) {
+            if (!ec) {
+                pool.stop();
+            }
+        });
+
+        pool.run();
+
+        LoadGenerator::Report report = generator.collect();
+        report.print(std::cout);
+        if (!reportPath.empty()) {
+            std::ofstream out(reportPath);
+            if (!out) {
+                std::cerr << "无法写入报告: " << reportPath << "\n";
+                return 1;
+            }
+            report.writeJson(out);
+            std::cout << "报告已写入 " << reportPath << "\n";
+        }
+    }
+    catch (std::exception& e) {
+        std::cerr << "异常: " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include "latency_histogram.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+// [0, 2 * SUB_BUCKET_COUNT) 内每个值一个桶；之后每个 2 的幂区间 SUB_BUCKET_COUNT 个桶
+std::size_t LatencyHistogram::indexOf(uint64_t value)
+{
+    if (value < 2 * SUB_BUCKET_COUNT) {
+        return static_cast<std::size_t>(value);
+    }
+    unsigned shift = static_cast<unsigned>(std::bit_width(value)) - (SUB_BUCKET_BITS + 1);
+    uint64_t sub = value >> shift;  // 落在 [SUB_BUCKET_COUNT, 2 * SUB_BUCKET_COUNT)
+    return static_cast<std::size_t>(2 * SUB_BUCKET_COUNT + (shift - 1) * SUB_BUCKET_COUNT +
+                                    (sub - SUB_BUCKET_COUNT));
+}
+
+uint64_t LatencyHistogram::highestEquivalentValue(std::size_t index)
+{
+    if (index < 2 * SUB_BUCKET_COUNT) {
+        return index;
+    }
+    std::size_t offset = index - 2 * SUB_BUCKET_COUNT;
+    unsigned shift = static_cast<unsigned>(offset / SUB_BUCKET_COUNT) + 1;
+    uint64_t sub = SUB_BUCKET_COUNT + offset % SUB_BUCKET_COUNT;
+    return ((sub + 1) << shift) - 1;
+}
+
+LatencyHistogram::LatencyHistogram()
+    : counts_(indexOf(MAX_VALUE) + 1, 0)
+{
+}
+
+void LatencyHistogram::record(uint64_t value)
+{
+    value = std::min(value, MAX_VALUE);
+    ++counts_[indexOf(value)];
+    min_ = count_ ? std::min(min_, value) : value;
+    max_ = std::max(max_, value);
+    sum_ += value;
+    ++count_;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+    if (other.count_ == 0) {
+        return;
+    }
+    for (std::size_t i = 0; i < counts_.size(); ++i) {
+        counts_[i] += other.counts_[i];
+    }
+    min_ = count_ ? std::min(min_, other.min_) : other.min_;
+    max_ = std::max(max_, other.max_);
+    sum_ += other.sum_;
+    count_ += other.count_;
+}
+
+void LatencyHistogram::reset()
+{
+    std::fill(counts_.begin(), counts_.end(), 0);
+    count_ = 0;
+    min_ = 0;
+    max_ = 0;
+    sum_ = 0;
+}
+
+double LatencyHistogram::mean() const
+{
+    return count_ ? static_cast<double>(sum_ / count_) : 0.0;
+}
+
+uint64_t LatencyHistogram::percentile(double percentile) const
+{
+    if (count_ == 0) {
+        return 0;
+    }
+
+    percentile = std::clamp(percentile, 0.0, 100.0);
+    uint64_t target = static_cast<uint64_t>(std::ceil(percentile / 100.0 * count_));
+    target = std::clamp<uint64_t>(target, 1, count_);
+
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts_.size(); ++i) {
+        seen += counts_[i];
+        if (seen >= target) {
+            return std::min(highestEquivalentValue(i), max_);
+        }
+    }
+    return max_;
+}
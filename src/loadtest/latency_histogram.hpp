@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// HDR 风格的对数线性直方图：每个 2 的幂区间再等分为 128 个子桶，
+// 记录和查询都是 O(1) 的数组操作，任意量级的相对误差都小于 1%。
+// 非线程安全，每个线程各用一个，结束后用 merge 合并
+class LatencyHistogram {
+public:
+    // 超过该值的记录按该值计入
+    static constexpr uint64_t MAX_VALUE = (uint64_t{1} << 40) - 1;
+
+    LatencyHistogram();
+
+    void record(uint64_t value);
+    void merge(const LatencyHistogram& other);
+    void reset();
+
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return count_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const;
+
+    // percentile 取 0 到 100；返回所在桶内的最大等价值，不超过实际最大值
+    uint64_t percentile(double percentile) const;
+
+private:
+    static constexpr unsigned SUB_BUCKET_BITS = 7;
+    static constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{1} << SUB_BUCKET_BITS;
+
+    static std::size_t indexOf(uint64_t value);
+    static uint64_t highestEquivalentValue(std::size_t index);
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_{0};
+    uint64_t min_{0};
+    uint64_t max_{0};
+    long double sum_{0};
+};
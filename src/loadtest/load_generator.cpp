@@ -0,0 +1,377 @@
+#include "load_generator.hpp"
+#include <algorithm>
+#include <charconv>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+
+namespace {
+
+// 压测消息内容的前缀，后面是发送时刻（steady_clock 纳秒）和填充内容
+constexpr std::string_view PAYLOAD_TAG = "lg ";
+
+uint64_t nowNanos()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+std::chrono::steady_clock::time_point fromNanos(uint64_t nanos)
+{
+    return std::chrono::steady_clock::time_point(
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(nanos)));
+}
+
+double toSeconds(std::chrono::milliseconds ms)
+{
+    return std::chrono::duration<double>(ms).count();
+}
+
+} // namespace
+
+LoadGenerator::LoadGenerator(IoContextPool& pool, const Config& config)
+    : pool_(pool)
+    , config_(config)
+    , progressTimer_(pool.getIoContext(0))
+{
+    config_.payloadMax = std::max(config_.payloadMin, config_.payloadMax);
+
+    for (std::size_t i = 0; i < pool_.size(); ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+
+    // 随机填充，避免压缩让大消息的传输量失真
+    std::mt19937 random(std::random_device{}());
+    std::uniform_int_distribution<int> printable('!', '~');
+    filler_.resize(config_.payloadMax);
+    for (char& c : filler_) {
+        c = static_cast<char>(printable(random));
+    }
+}
+
+void LoadGenerator::start()
+{
+    startTime_ = Clock::now();
+    measureBegin_ = startTime_ + config_.ramp;
+    measureEnd_ = measureBegin_ + config_.duration;
+    stopTime_ = measureEnd_ + config_.drain;
+
+    clients_.reserve(config_.clients);
+    for (std::size_t i = 0; i < config_.clients; ++i) {
+        std::size_t loop = pool_.acquire();
+        auto client = std::make_unique<Client>(pool_.getIoContext(loop), *workers_[loop]);
+        client->index = i;
+        client->name = "load-" + std::to_string(i);
+        client->port = config_.ports.empty() ? config_.port : config_.ports[i % config_.ports.size()];
+        if (config_.rooms > 0 && !config_.direct) {
+            client->room = "load-room-" + std::to_string(i % config_.rooms);
+        }
+
+        // 压测中断开的连接不重连，如实计入断开数
+        client->chat.setAutoReconnect(false);
+        // 每个模拟客户端都保存全部在线用户时，内存随连接数平方增长
+        client->chat.setPresenceTracking(false);
+        Client* raw = client.get();
+        client->chat.setMessageHandler([this, raw](const Message& msg) { onMessage(*raw, msg); });
+        client->chat.setUserListHandler([this, raw](const std::vector<std::string>&) { onUserList(*raw); });
+        client->chat.setDisconnectHandler([raw]() {
+            raw->worker.disconnects.fetch_add(1, std::memory_order_relaxed);
+        });
+
+        // 建连在爬坡期内均匀分布
+        std::chrono::milliseconds offset{0};
+        if (config_.clients > 1) {
+            offset = config_.ramp * static_cast<long long>(i) / static_cast<long long>(config_.clients - 1);
+        }
+        client->timer.expires_at(startTime_ + offset);
+        client->timer.async_wait([this, raw](const asio::error_code& ec) {
+            if (!ec) {
+                connectClient(*raw);
+            }
+        });
+        clients_.push_back(std::move(client));
+    }
+
+    scheduleProgress();
+}
+
+void LoadGenerator::connectClient(Client& client)
+{
+    client.connectStart = Clock::now();
+    try {
+        client.chat.connect(config_.host, client.port, [this, &client](bool success) {
+            if (success) {
+                client.worker.connected.fetch_add(1, std::memory_order_relaxed);
+                onConnected(client);
+            } else {
+                client.worker.connectFailures.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+    catch (const std::exception&) {
+        // 地址解析失败
+        client.worker.connectFailures.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void LoadGenerator::onConnected(Client& client)
+{
+    // 第一条消息作为登录，之后加入房间
+    Message login(Message::Type::JOIN);
+    login.setSender(client.name);
+    client.chat.sendMessage(login);
+
+    if (!client.room.empty()) {
+        Message join(Message::Type::JOIN_ROOM);
+        join.setSender(client.name);
+        join.setTarget(client.room);
+        client.chat.sendMessage(join);
+    }
+
+    scheduleSend(client);
+}
+
+void LoadGenerator::scheduleSend(Client& client)
+{
+    if (config_.rate <= 0) {
+        return;
+    }
+
+    // 指数分布的发送间隔，多个客户端叠加后接近泊松到达
+    std::exponential_distribution<double> interval(config_.rate);
+    auto delay = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(interval(client.worker.random)));
+    auto next = Clock::now() + delay;
+    if (next >= measureEnd_) {
+        return;
+    }
+
+    client.timer.expires_at(next);
+    client.timer.async_wait([this, &client](const asio::error_code& ec) {
+        if (!ec && client.chat.isConnected()) {
+            sendOne(client);
+            scheduleSend(client);
+        }
+    });
+}
+
+void LoadGenerator::sendOne(Client& client)
+{
+    std::uniform_int_distribution<std::size_t> sizeDist(config_.payloadMin, config_.payloadMax);
+    std::size_t size = sizeDist(client.worker.random);
+
+    uint64_t sentAt = nowNanos();
+    std::string content;
+    content.reserve(std::max<std::size_t>(size, 32));
+    content.append(PAYLOAD_TAG);
+    content.append(std::to_string(sentAt));
+    content.push_back(' ');
+    if (content.size() < size) {
+        content.append(filler_, 0, size - content.size());
+    }
+
+    Message msg(client.room.empty() ? Message::Type::TEXT : Message::Type::ROOM_TEXT);
+    msg.setSender(client.name);
+    msg.setTarget(client.room);
+    if (config_.direct && config_.clients > 1) {
+        std::uniform_int_distribution<std::size_t> peerDist(0, config_.clients - 2);
+        std::size_t peer = peerDist(client.worker.random);
+        msg = Message(Message::Type::PRIVATE);
+        msg.setSender(client.name);
+        msg.setTarget("load-" + std::to_string(peer >= client.index ? peer + 1 : peer));
+    }
+    msg.setContent(content);
+    client.chat.sendMessage(msg);
+
+    if (inWindow(fromNanos(sentAt))) {
+        client.worker.sent.fetch_add(1, std::memory_order_relaxed);
+        client.worker.sentBytes.fetch_add(content.size(), std::memory_order_relaxed);
+    }
+}
+
+void LoadGenerator::onMessage(Client& client, const Message& msg)
+{
+    if ((msg.getType() != Message::Type::TEXT && msg.getType() != Message::Type::ROOM_TEXT &&
+         msg.getType() != Message::Type::PRIVATE) ||
+        client.chat.isReplayingHistory()) {
+        return;
+    }
+
+    std::string_view content = msg.getContent();
+    if (content.substr(0, PAYLOAD_TAG.size()) != PAYLOAD_TAG) {
+        return;
+    }
+    content.remove_prefix(PAYLOAD_TAG.size());
+
+    uint64_t sentAt = 0;
+    auto result = std::from_chars(content.data(), content.data() + content.size(), sentAt);
+    if (result.ec != std::errc() || !inWindow(fromNanos(sentAt))) {
+        return;
+    }
+
+    uint64_t now = nowNanos();
+    client.worker.latency.record(now > sentAt ? (now - sentAt) / 1000 : 0);
+    client.worker.delivered.fetch_add(1, std::memory_order_relaxed);
+    client.worker.deliveredBytes.fetch_add(msg.getContent().size(), std::memory_order_relaxed);
+}
+
+void LoadGenerator::onUserList(Client& client)
+{
+    if (client.joined) {
+        return;
+    }
+    client.joined = true;
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - client.connectStart);
+    client.worker.joinLatency.record(static_cast<uint64_t>(elapsed.count()));
+
+    // 之后的在线列表变化不再关心；每次回调都要复制整个列表，连接多时开销很大。
+    // 不能在回调执行期间替换它，推迟到下一轮
+    asio::post(client.timer.get_executor(), [&client]() { client.chat.setUserListHandler(nullptr); });
+}
+
+bool LoadGenerator::inWindow(Clock::time_point sentAt) const
+{
+    return sentAt >= measureBegin_ && sentAt < measureEnd_;
+}
+
+void LoadGenerator::scheduleProgress()
+{
+    progressTimer_.expires_after(std::chrono::seconds(1));
+    progressTimer_.async_wait([this](const asio::error_code& ec) {
+        if (ec) {
+            return;
+        }
+
+        auto now = Clock::now();
+        if (now >= stopTime_) {
+            pool_.stop();
+            return;
+        }
+
+        std::size_t connected = 0;
+        uint64_t sent = 0;
+        uint64_t delivered = 0;
+        for (const auto& worker : workers_) {
+            connected += worker->connected.load(std::memory_order_relaxed) -
+                         worker->disconnects.load(std::memory_order_relaxed);
+            sent += worker->sent.load(std::memory_order_relaxed);
+            delivered += worker->delivered.load(std::memory_order_relaxed);
+        }
+
+        const char* phase = now < measureBegin_ ? "建连" : now < measureEnd_ ? "测量" : "收尾";
+        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - startTime_).count();
+        std::cout << "[" << std::setw(4) << elapsed << "s " << phase << "] 在线 " << connected
+                  << "/" << config_.clients << "  已发送 " << sent << "  已投递 " << delivered
+                  << std::endl;
+
+        scheduleProgress();
+    });
+}
+
+LoadGenerator::Report LoadGenerator::collect() const
+{
+    Report report;
+    report.config = config_;
+    report.seconds = toSeconds(config_.duration);
+    for (const auto& worker : workers_) {
+        report.connected += worker->connected.load(std::memory_order_relaxed);
+        report.connectFailures += worker->connectFailures.load(std::memory_order_relaxed);
+        report.disconnects += worker->disconnects.load(std::memory_order_relaxed);
+        report.sent += worker->sent.load(std::memory_order_relaxed);
+        report.sentBytes += worker->sentBytes.load(std::memory_order_relaxed);
+        report.delivered += worker->delivered.load(std::memory_order_relaxed);
+        report.deliveredBytes += worker->deliveredBytes.load(std::memory_order_relaxed);
+        report.latency.merge(worker->latency);
+        report.joinLatency.merge(worker->joinLatency);
+    }
+    return report;
+}
+
+void LoadGenerator::Report::writeJson(std::ostream& out) const
+{
+    auto rate = [this](uint64_t value) { return seconds > 0 ? value / seconds : 0.0; };
+    auto escape = [](const std::string& value) {
+        std::string escaped;
+        for (char c : value) {
+            if (c == '"' || c == '\\') {
+                escaped.push_back('\\');
+            }
+            escaped.push_back(c);
+        }
+        return escaped;
+    };
+
+    out << std::fixed << std::setprecision(3);
+    out << "{\n";
+    out << "  \"config\": {\n";
+    out << "    \"host\": \"" << escape(config.host) << "\",\n";
+    out << "    \"port\": " << config.port << ",\n";
+    if (!config.ports.empty()) {
+        out << "    \"ports\": [";
+        for (std::size_t i = 0; i < config.ports.size(); ++i) {
+            out << (i > 0 ? ", " : "") << config.ports[i];
+        }
+        out << "],\n";
+    }
+    out << "    \"clients\": " << config.clients << ",\n";
+    out << "    \"rate_per_client\": " << config.rate << ",\n";
+    out << "    \"payload_min\": " << config.payloadMin << ",\n";
+    out << "    \"payload_max\": " << config.payloadMax << ",\n";
+    out << "    \"rooms\": " << config.rooms << ",\n";
+    out << "    \"private\": " << (config.direct ? "true" : "false") << ",\n";
+    out << "    \"ramp_seconds\": " << toSeconds(config.ramp) << ",\n";
+    out << "    \"duration_seconds\": " << toSeconds(config.duration) << ",\n";
+    out << "    \"drain_seconds\": " << toSeconds(config.drain) << "\n";
+    out << "  },\n";
+    out << "  \"connections\": {\n";
+    out << "    \"connected\": " << connected << ",\n";
+    out << "    \"failed\": " << connectFailures << ",\n";
+    out << "    \"disconnected\": " << disconnects << "\n";
+    out << "  },\n";
+    out << "  \"throughput\": {\n";
+    out << "    \"sent\": " << sent << ",\n";
+    out << "    \"sent_bytes\": " << sentBytes << ",\n";
+    out << "    \"delivered\": " << delivered << ",\n";
+    out << "    \"delivered_bytes\": " << deliveredBytes << ",\n";
+    out << "    \"sent_per_second\": " << rate(sent) << ",\n";
+    out << "    \"delivered_per_second\": " << rate(delivered) << ",\n";
+    out << "    \"delivered_bytes_per_second\": " << rate(deliveredBytes) << "\n";
+    out << "  },\n";
+    out << "  \"latency_us\": {\n";
+    out << "    \"count\": " << latency.count() << ",\n";
+    out << "    \"min\": " << latency.min() << ",\n";
+    out << "    \"mean\": " << latency.mean() << ",\n";
+    out << "    \"p50\": " << latency.percentile(50) << ",\n";
+    out << "    \"p90\": " << latency.percentile(90) << ",\n";
+    out << "    \"p99\": " << latency.percentile(99) << ",\n";
+    out << "    \"p99_9\": " << latency.percentile(99.9) << ",\n";
+    out << "    \"p99_99\": " << latency.percentile(99.99) << ",\n";
+    out << "    \"max\": " << latency.max() << "\n";
+    out << "  },\n";
+    out << "  \"join_latency_us\": {\n";
+    out << "    \"count\": " << joinLatency.count() << ",\n";
+    out << "    \"p50\": " << joinLatency.percentile(50) << ",\n";
+    out << "    \"p90\": " << joinLatency.percentile(90) << ",\n";
+    out << "    \"p99\": " << joinLatency.percentile(99) << ",\n";
+    out << "    \"max\": " << joinLatency.max() << "\n";
+    out << "  }\n";
+    out << "}\n";
+}
+
+void LoadGenerator::Report::print(std::ostream& out) const
+{
+    auto rate = [this](uint64_t value) { return seconds > 0 ? value / seconds : 0.0; };
+
+    out << std::fixed << std::setprecision(1);
+    out << "连接: 成功 " << connected << "，失败 " << connectFailures << "，中途断开 " << disconnects << "\n";
+    out << "发送: " << sent << " 条 (" << rate(sent) << " 条/秒)\n";
+    out << "投递: " << delivered << " 条 (" << rate(delivered) << " 条/秒，"
+        << rate(deliveredBytes) / (1024 * 1024) << " MiB/秒)\n";
+    out << "延迟(微秒): 最小 " << latency.min() << "  平均 " << latency.mean()
+        << "  p50 " << latency.percentile(50) << "  p90 " << latency.percentile(90)
+        << "  p99 " << latency.percentile(99) << "  p99.9 " << latency.percentile(99.9)
+        << "  最大 " << latency.max() << "\n";
+    out << "登录到收到在线列表(微秒): p50 " << joinLatency.percentile(50)
+        << "  p90 " << joinLatency.percentile(90) << "  p99 " << joinLatency.percentile(99)
+        << "  最大 " << joinLatency.max() << " (" << joinLatency.count() << " 个连接)\n";
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "latency_histogram.hpp"
+#include "../network/chat_client.hpp"
+#include "../network/io_context_pool.hpp"
+
+// 无界面的压测客户端：在少量事件循环上模拟大量 ChatClient 连接，按设定速率发消息，
+// 在接收端根据消息里携带的发送时刻统计端到端投递延迟
+class LoadGenerator {
+public:
+    struct Config {
+        std::string host{"127.0.0.1"};
+        uint16_t port{8080};
+        std::vector<uint16_t> ports;       // 非空时客户端轮流连接这些端口（同一主机上的多个联邦节点）
+        std::size_t clients{100};
+        double rate{1.0};                  // 每个客户端每秒发送的消息数（泊松到达）
+        std::size_t payloadMin{64};        // 消息内容长度在 [payloadMin, payloadMax] 内均匀分布
+        std::size_t payloadMax{64};
+        std::size_t rooms{0};              // 0 表示全局广播，否则客户端轮流加入 rooms 个房间
+        bool direct{false};                // 私聊：每条消息发给随机的另一个客户端，忽略 rooms
+        std::chrono::milliseconds ramp{std::chrono::seconds(5)};      // 所有连接在此期间均匀建立
+        std::chrono::milliseconds duration{std::chrono::seconds(30)}; // 建连完成后的测量时长
+        std::chrono::milliseconds drain{std::chrono::seconds(2)};     // 停止发送后等待在途消息的时长
+    };
+
+    struct Report {
+        Config config;
+        std::size_t connected{0};
+        std::size_t connectFailures{0};
+        std::size_t disconnects{0};
+        // 以下只统计测量窗口内发出的消息
+        uint64_t sent{0};
+        uint64_t sentBytes{0};
+        uint64_t delivered{0};
+        uint64_t deliveredBytes{0};
+        double seconds{0};
+        LatencyHistogram latency;  // 微秒
+        LatencyHistogram joinLatency;  // 发起连接到收到第一份在线用户快照，微秒；统计所有连接
+
+        void writeJson(std::ostream& out) const;
+        void print(std::ostream& out) const;
+    };
+
+    LoadGenerator(IoContextPool& pool, const Config& config);
+
+    LoadGenerator(const LoadGenerator&) = delete;
+    LoadGenerator& operator=(const LoadGenerator&) = delete;
+
+    // 安排建连和发送；时间线结束后停止事件循环池
+    void start();
+
+    // 事件循环全部退出后调用
+    Report collect() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // 每个事件循环一份，只在该循环的线程上写入；计数用原子量以便进度输出读取
+    struct Worker {
+        LatencyHistogram latency;
+        LatencyHistogram joinLatency;
+        std::mt19937_64 random{std::random_device{}()};
+        std::atomic<std::size_t> connected{0};
+        std::atomic<std::size_t> connectFailures{0};
+        std::atomic<std::size_t> disconnects{0};
+        std::atomic<uint64_t> sent{0};
+        std::atomic<uint64_t> sentBytes{0};
+        std::atomic<uint64_t> delivered{0};
+        std::atomic<uint64_t> deliveredBytes{0};
+    };
+
+    struct Client {
+        Client(asio::io_context& io_context, Worker& worker)
+            : chat(io_context), timer(io_context), worker(worker) {}
+
+        ChatClient chat;
+        asio::steady_timer timer;
+        Worker& worker;
+        std::size_t index{0};
+        std::string name;
+        std::string room;
+        uint16_t port{0};
+        Clock::time_point connectStart;
+        bool joined{false};
+    };
+
+    void connectClient(Client& client);
+    void onConnected(Client& client);
+    void scheduleSend(Client& client);
+    void sendOne(Client& client);
+    void onMessage(Client& client, const Message& msg);
+    void onUserList(Client& client);
+    void scheduleProgress();
+    bool inWindow(Clock::time_point sentAt) const;
+
+    IoContextPool& pool_;
+    Config config_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::unique_ptr<Client>> clients_;
+    std::string filler_;  // 预先生成的随机内容，发送时按长度截取
+
+    Clock::time_point startTime_;
+    Clock::time_point measureBegin_;
+    Clock::time_point measureEnd_;
+    Clock::time_point stopTime_;
+    asio::steady_timer progressTimer_;
+};
@@ -0,0 +1,252 @@
+#include "buffer_pool.hpp"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+// 线程退出时池先于其他 thread_local 对象停用，之后释放的帧直接归还给分配器
+thread_local bool poolDestroyed = false;
+
+std::atomic<bool> poolEnabled{true};
+
+// 已注册的各线程池，以及已退出线程的池留下的统计
+struct Registry {
+    std::mutex mutex;
+    std::vector<const BufferPool*> pools;
+    BufferPool::Stats retired;
+};
+
+Registry& registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+void accumulate(BufferPool::Stats& total, const BufferPool::Stats& stats)
+{
+    total.acquires += stats.acquires;
+    total.hits += stats.hits;
+    total.releases += stats.releases;
+    total.recycled += stats.recycled;
+    total.heldBytes += stats.heldBytes;
+    total.highWaterBytes += stats.highWaterBytes;
+}
+
+} // namespace
+
+// 帧的最后一个引用释放时把缓冲区交还给取出它的线程的池
+struct BufferPool::PooledBuffer {
+    std::vector<uint8_t> data;
+    BufferPool* owner;
+    PooledBuffer* next{nullptr};
+};
+
+struct BufferPool::LocalPool {
+    BufferPool* pool = new BufferPool;
+
+    ~LocalPool()
+    {
+        poolDestroyed = true;
+        pool->retire();
+    }
+};
+
+BufferPool::BufferPool()
+{
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.pools.push_back(this);
+}
+
+void BufferPool::retire()
+{
+    // 之后其他线程释放的帧不再挂回本池；恰好在检查之后挂回的缓冲区不再回收，只在线程退出时发生
+    retired_.store(true, std::memory_order_release);
+    collectReturned();
+
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.pools.erase(std::remove(reg.pools.begin(), reg.pools.end(), this), reg.pools.end());
+
+    // 已退出线程的池不再持有内存，只保留累计次数
+    Stats stats = getStats();
+    stats.heldBytes = 0;
+    stats.highWaterBytes = 0;
+    accumulate(reg.retired, stats);
+    for (auto& freeList : classes_) {
+        std::vector<std::vector<uint8_t>>().swap(freeList);
+    }
+    heldBytes_.store(0, std::memory_order_relaxed);
+}
+
+BufferPool* BufferPool::local()
+{
+    if (poolDestroyed || !poolEnabled.load(std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    thread_local LocalPool local;
+    return local.pool;
+}
+
+void BufferPool::setEnabled(bool enabled)
+{
+    poolEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool BufferPool::isEnabled()
+{
+    return poolEnabled.load(std::memory_order_relaxed);
+}
+
+std::size_t BufferPool::classFor(std::size_t size)
+{
+    std::size_t index = 0;
+    std::size_t classSize = MIN_CLASS_SIZE;
+    while (classSize < size) {
+        classSize <<= 1;
+        ++index;
+    }
+    return index;
+}
+
+std::vector<uint8_t> BufferPool::acquire(std::size_t size)
+{
+    acquires_.fetch_add(1, std::memory_order_relaxed);
+
+    std::vector<uint8_t> buffer;
+    if (size > MAX_CLASS_SIZE) {
+        buffer.reserve(size);
+        return buffer;
+    }
+
+    std::size_t index = classFor(size);
+    auto& freeList = classes_[index];
+    if (freeList.empty()) {
+        collectReturned();
+    }
+    if (!freeList.empty()) {
+        buffer = std::move(freeList.back());
+        freeList.pop_back();
+        heldBytes_.fetch_sub(buffer.capacity(), std::memory_order_relaxed);
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return buffer;
+    }
+
+    // 按级别大小分配，归还后可以服务同一级别的所有请求
+    buffer.reserve(MIN_CLASS_SIZE << index);
+    return buffer;
+}
+
+void BufferPool::release(std::vector<uint8_t>&& buffer)
+{
+    releases_.fetch_add(1, std::memory_order_relaxed);
+
+    std::size_t capacity = buffer.capacity();
+    if (capacity < MIN_CLASS_SIZE || capacity > MAX_CLASS_SIZE) {
+        return;
+    }
+
+    // 归入容量能完整覆盖的最大级别
+    std::size_t index = classFor(capacity);
+    if ((MIN_CLASS_SIZE << index) > capacity) {
+        --index;
+    }
+
+    auto& freeList = classes_[index];
+    std::size_t held = heldBytes_.load(std::memory_order_relaxed);
+    if (freeList.size() >= MAX_BUFFERS_PER_CLASS || held + capacity > MAX_HELD_BYTES) {
+        return;
+    }
+
+    // 空闲链表一次性预留到上限，之后归还不会因为链表扩容再分配
+    if (freeList.capacity() < MAX_BUFFERS_PER_CLASS) {
+        freeList.reserve(MAX_BUFFERS_PER_CLASS);
+    }
+    buffer.clear();
+    freeList.push_back(std::move(buffer));
+    recycled_.fetch_add(1, std::memory_order_relaxed);
+    held += capacity;
+    heldBytes_.store(held, std::memory_order_relaxed);
+    if (held > highWaterBytes_.load(std::memory_order_relaxed)) {
+        highWaterBytes_.store(held, std::memory_order_relaxed);
+    }
+}
+
+std::vector<uint8_t> BufferPool::acquireLocal(std::size_t size)
+{
+    if (auto* pool = local()) {
+        return pool->acquire(size);
+    }
+    std::vector<uint8_t> buffer;
+    buffer.reserve(size);
+    return buffer;
+}
+
+SharedFrame BufferPool::share(std::vector<uint8_t>&& buffer)
+{
+    // 包装对象和引用计数都来自块缓存，数据区来自池
+    PooledBuffer* pooled = PoolAllocator<PooledBuffer>().allocate(1);
+    new (pooled) PooledBuffer{std::move(buffer), local()};
+    return SharedFrame(&pooled->data, [pooled](const std::vector<uint8_t>*) { recycle(pooled); },
+                       PoolAllocator<PooledBuffer>());
+}
+
+void BufferPool::recycle(PooledBuffer* buffer)
+{
+    BufferPool* pool = local();
+    BufferPool* owner = buffer->owner;
+    if (pool && owner && owner != pool && !owner->retired_.load(std::memory_order_acquire)) {
+        PooledBuffer* head = owner->returned_.load(std::memory_order_relaxed);
+        do {
+            buffer->next = head;
+        } while (!owner->returned_.compare_exchange_weak(head, buffer, std::memory_order_release,
+                                                         std::memory_order_relaxed));
+        return;
+    }
+    if (pool) {
+        pool->release(std::move(buffer->data));
+    }
+    destroy(buffer);
+}
+
+void BufferPool::destroy(PooledBuffer* buffer)
+{
+    buffer->~PooledBuffer();
+    PoolAllocator<PooledBuffer>().deallocate(buffer, 1);
+}
+
+void BufferPool::collectReturned()
+{
+    PooledBuffer* buffer = returned_.exchange(nullptr, std::memory_order_acquire);
+    while (buffer) {
+        PooledBuffer* next = buffer->next;
+        release(std::move(buffer->data));
+        destroy(buffer);
+        buffer = next;
+    }
+}
+
+BufferPool::Stats BufferPool::getStats() const
+{
+    Stats stats;
+    stats.acquires = acquires_.load(std::memory_order_relaxed);
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.releases = releases_.load(std::memory_order_relaxed);
+    stats.recycled = recycled_.load(std::memory_order_relaxed);
+    stats.heldBytes = heldBytes_.load(std::memory_order_relaxed);
+    stats.highWaterBytes = highWaterBytes_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+BufferPool::Stats BufferPool::getGlobalStats()
+{
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    Stats total = reg.retired;
+    for (const auto* pool : reg.pools) {
+        accumulate(total, pool->getStats());
+    }
+    return total;
+}
@@ -0,0 +1,250 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include "message.hpp"
+
+// 按大小分级的缓冲区池，每个线程一个，取用和归还都不加锁。
+// 编码时从池中取出容量合适的缓冲区，帧的最后一个引用释放（通常是写完成后）时归还。
+// 在其他线程释放的帧先挂到取出它的线程的归还链表上（无锁），由该线程下次缺货时收回，
+// 这样转发这种一个线程取、另一个线程释放的场景下各线程的池也能保持平衡
+class BufferPool {
+public:
+    // 64 字节到 64 KiB，按 2 的幂分级；更大的缓冲区不入池
+    static constexpr std::size_t MIN_CLASS_SIZE = 64;
+    static constexpr std::size_t MAX_CLASS_SIZE = 64 * 1024;
+    static constexpr std::size_t CLASS_COUNT = 11;
+    static constexpr std::size_t MAX_BUFFERS_PER_CLASS = 256;
+    static constexpr std::size_t MAX_HELD_BYTES = 4 * 1024 * 1024;
+
+    struct Stats {
+        uint64_t acquires{0};
+        uint64_t hits{0};          // 直接从池中取到的次数
+        uint64_t releases{0};
+        uint64_t recycled{0};      // 归还后留在池中的次数
+        std::size_t heldBytes{0};  // 池中空闲缓冲区的总容量
+        std::size_t highWaterBytes{0};
+
+        double hitRate() const {
+            return acquires ? static_cast<double>(hits) / acquires : 0.0;
+        }
+    };
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // 当前线程的池；线程退出过程中池已停用或池被全局停用时返回 nullptr
+    static BufferPool* local();
+
+    // 停用后所有缓冲区直接向分配器申请和释放，用于对比池的效果；默认启用
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+
+    // 取出容量至少为 size 的空缓冲区
+    std::vector<uint8_t> acquire(std::size_t size);
+    void release(std::vector<uint8_t>&& buffer);
+
+    // 从当前线程的池取缓冲区（池不可用时直接分配）
+    static std::vector<uint8_t> acquireLocal(std::size_t size);
+    // 把写好的缓冲区包装成共享帧，帧释放时缓冲区自动归还给当前线程的池
+    static SharedFrame share(std::vector<uint8_t>&& buffer);
+
+    Stats getStats() const;
+    // 所有线程（包括已退出线程）的池的汇总，峰值为各线程峰值之和；可在任意线程调用
+    static Stats getGlobalStats();
+
+private:
+    struct PooledBuffer;
+    struct LocalPool;
+
+    // 线程的池在线程退出时停用但不销毁：其他线程可能还持有从它取出的帧
+    BufferPool();
+    ~BufferPool() = default;
+    void retire();
+
+    static std::size_t classFor(std::size_t size);
+    static void recycle(PooledBuffer* buffer);
+    static void destroy(PooledBuffer* buffer);
+    void collectReturned();
+
+    std::array<std::vector<std::vector<uint8_t>>, CLASS_COUNT> classes_;
+
+    // 其他线程释放、等待本线程收回的缓冲区
+    std::atomic<PooledBuffer*> returned_{nullptr};
+    std::atomic<bool> retired_{false};
+
+    // 只由所属线程写入，统计线程可随时读取
+    std::atomic<uint64_t> acquires_{0};
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> releases_{0};
+    std::atomic<uint64_t> recycled_{0};
+    std::atomic<std::size_t> heldBytes_{0};
+    std::atomic<std::size_t> highWaterBytes_{0};
+};
+
+// 固定大小内存块的线程本地空闲链表，用于共享帧、待发送消息、发送队列这类小块分配。
+// 规则与缓冲区池相同：所属线程取用和归还不加锁，其他线程释放的块挂回所属线程的归还链表；
+// 缓冲区池停用时直接使用分配器
+template <std::size_t Size>
+class BlockCache {
+public:
+    static constexpr std::size_t MAX_BLOCKS = 1024;
+
+    static void* allocate()
+    {
+        BlockCache* cache = local();
+        Node* node = cache ? cache->pop() : nullptr;
+        if (!node) {
+            node = static_cast<Node*>(::operator new(sizeof(Node)));
+        }
+        node->owner = cache;
+        return node->payload;
+    }
+
+    static void deallocate(void* block)
+    {
+        Node* node = reinterpret_cast<Node*>(static_cast<unsigned char*>(block) - offsetof(Node, payload));
+        BlockCache* owner = node->owner;
+        BlockCache* cache = local();
+        if (owner && owner == cache && cache->count_ < MAX_BLOCKS) {
+            node->next = cache->head_;
+            cache->head_ = node;
+            ++cache->count_;
+        } else if (owner && owner != cache && cache && !owner->retired_.load(std::memory_order_acquire)) {
+            Node* head = owner->returned_.load(std::memory_order_relaxed);
+            do {
+                node->next = head;
+            } while (!owner->returned_.compare_exchange_weak(head, node, std::memory_order_release,
+                                                             std::memory_order_relaxed));
+        } else {
+            ::operator delete(node);
+        }
+    }
+
+private:
+    // 使用中记录所属线程，空闲时链接下一块
+    struct Node {
+        union {
+            Node* next;
+            BlockCache* owner;
+        };
+        alignas(std::max_align_t) unsigned char payload[Size];
+    };
+
+    struct LocalCache {
+        BlockCache* cache = new BlockCache;
+
+        ~LocalCache()
+        {
+            destroyed_ = true;
+            cache->retire();
+        }
+    };
+
+    static BlockCache* local()
+    {
+        if (destroyed_ || !BufferPool::isEnabled()) {
+            return nullptr;
+        }
+        thread_local LocalCache local;
+        return local.cache;
+    }
+
+    Node* pop()
+    {
+        if (!head_) {
+            head_ = returned_.exchange(nullptr, std::memory_order_acquire);
+            for (Node* node = head_; node; node = node->next) {
+                ++count_;
+            }
+        }
+        Node* node = head_;
+        if (node) {
+            head_ = node->next;
+            --count_;
+        }
+        return node;
+    }
+
+    void retire()
+    {
+        // 之后其他线程释放的块直接还给分配器；恰好在检查之后、退出之前挂回的块不再回收，
+        // 只在线程退出时发生
+        retired_.store(true, std::memory_order_release);
+        Node* lists[] = {head_, returned_.exchange(nullptr, std::memory_order_acquire)};
+        for (Node* node : lists) {
+            while (node) {
+                Node* next = node->next;
+                ::operator delete(node);
+                node = next;
+            }
+        }
+        head_ = nullptr;
+        count_ = 0;
+    }
+
+    static inline thread_local bool destroyed_ = false;
+
+    Node* head_{nullptr};
+    std::size_t count_{0};
+    std::atomic<Node*> returned_{nullptr};
+    std::atomic<bool> retired_{false};
+};
+
+// 从 BlockCache 分配的标准分配器：不超过 1 KiB 的分配按 2 的幂向上取整到对应大小的块，
+// 更大的直接使用分配器。用于 std::allocate_shared、容器和 asio 处理器
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    static constexpr std::size_t MIN_BLOCK_SIZE = 64;
+    static constexpr std::size_t MAX_BLOCK_SIZE = 1024;
+
+    PoolAllocator() = default;
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n)
+    {
+        static_assert(alignof(T) <= alignof(std::max_align_t));
+        return static_cast<T*>(allocateBytes<MIN_BLOCK_SIZE>(n * sizeof(T)));
+    }
+
+    void deallocate(T* pointer, std::size_t n)
+    {
+        deallocateBytes<MIN_BLOCK_SIZE>(pointer, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>&) const noexcept { return false; }
+
+private:
+    template <std::size_t BlockSize>
+    static void* allocateBytes(std::size_t size)
+    {
+        if constexpr (BlockSize > MAX_BLOCK_SIZE) {
+            return ::operator new(size);
+        } else {
+            return size <= BlockSize ? BlockCache<BlockSize>::allocate() : allocateBytes<BlockSize * 2>(size);
+        }
+    }
+
+    template <std::size_t BlockSize>
+    static void deallocateBytes(void* pointer, std::size_t size)
+    {
+        if constexpr (BlockSize > MAX_BLOCK_SIZE) {
+            ::operator delete(pointer);
+        } else if (size <= BlockSize) {
+            BlockCache<BlockSize>::deallocate(pointer);
+        } else {
+            deallocateBytes<BlockSize * 2>(pointer, size);
+        }
+    }
+};
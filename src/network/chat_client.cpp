@@ -1,4 +1,9 @@
 #include "chat_client.hpp"
+#include "compression.hpp"
+#include "presence.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
 
 ChatClient::ChatClient(asio::io_context& io_context)
@@ -6,10 +11,8 @@ ChatClient::ChatClient(asio::io_context& io_context)
     , socket_(io_context)
     , connected_(false)
     , heartbeatTimer_(io_context)
-    , checkTimer_(io_context)
     , reconnectTimer_(io_context)
 {
-    readBuffer_.resize(1024);
 }
 
 void ChatClient::connect(const std::string& host, uint16_t port, ConnectHandler onConnect)
@@ -27,10 +30,18 @@ void ChatClient::connect(const std::string& host, uint16_t port, ConnectHandler
         {
             connected_ = !ec;
             if (connected_) {
+                setNoDelay();
+                decoder_.reset();
+                resetPresence();
                 reconnectAttempts_ = 0;
                 currentBackoff_ = initialBackoff_;  // 连接成功后重置退避时间
+                lastHeartbeat_ = std::chrono::steady_clock::now();
+                rtt_.reset();
                 doRead();
                 startHeartbeat();
+                sendCapabilities();
+                // 连接后立即探测一次，不必等第一个心跳周期就能显示延迟
+                sendHeartbeat();
             } else if (autoReconnect_) {
                 startReconnectTimer();
             }
@@ -40,28 +51,27 @@ void ChatClient::connect(const std::string& host, uint16_t port, ConnectHandler
         });
 }
 
+void ChatClient::setNoDelay()
+{
+    // 待发消息已在发送队列里合并成一次写，不再需要 Nagle 算法攒包；
+    // 否则一批消息写出后，下一批要等对端的延迟确认才能发出
+    asio::error_code ec;
+    socket_.set_option(asio::ip::tcp::no_delay(true), ec);
+}
+
 void ChatClient::startHeartbeat()
 {
-    // 发送心跳
+    // 每个周期先检查超时，未超时则发送心跳
     heartbeatTimer_.expires_after(HEARTBEAT_INTERVAL);
     heartbeatTimer_.async_wait([this](const asio::error_code& ec) {
-        if (!ec && connected_) {
-            Message heartbeat(Message::Type::HEARTBEAT);
-            sendMessage(heartbeat);
+        if (!ec && connected_ && checkHeartbeat()) {
+            sendHeartbeat();
             startHeartbeat();
         }
     });
-
-    // 检查心跳超时
-    checkTimer_.expires_after(HEARTBEAT_TIMEOUT);
-    checkTimer_.async_wait([this](const asio::error_code& ec) {
-        if (!ec && connected_) {
-            checkHeartbeat();
-        }
-    });
 }
 
-void ChatClient::checkHeartbeat()
+bool ChatClient::checkHeartbeat()
 {
     auto now = std::chrono::steady_clock::now();
     if (now - lastHeartbeat_ > HEARTBEAT_TIMEOUT) {
@@ -70,19 +80,145 @@ void ChatClient::checkHeartbeat()
         if (disconnectHandler_) {
             disconnectHandler_();
         }
-    } else {
-        checkTimer_.expires_after(HEARTBEAT_TIMEOUT);
-        checkTimer_.async_wait([this](const asio::error_code& ec) {
-            if (!ec && connected_) {
-                checkHeartbeat();
-            }
-        });
+        return false;
     }
+    return true;
+}
+
+void ChatClient::sendHeartbeat()
+{
+    // 心跳携带客户端探测，服务器原样回显后即可算出往返时间；旧服务器回复空心跳，只起保活作用
+    Message heartbeat(Message::Type::HEARTBEAT);
+    heartbeat.setContent(HeartbeatProbe::encode(HeartbeatProbe::Origin::Client, HeartbeatProbe::nowMicros()));
+    sendMessage(heartbeat);
 }
 
-void ChatClient::handleHeartbeat()
+void ChatClient::handleHeartbeat(const Message& msg)
 {
     lastHeartbeat_ = std::chrono::steady_clock::now();
+
+    HeartbeatProbe::Origin origin;
+    uint64_t sentMicros = 0;
+    if (!HeartbeatProbe::parse(msg.getContent(), origin, sentMicros)) {
+        return;
+    }
+
+    if (origin == HeartbeatProbe::Origin::Server) {
+        // 服务器的探测原样回显，由服务器计算它那一侧的往返时间
+        sendMessage(msg);
+        return;
+    }
+
+    uint64_t nowMicros = HeartbeatProbe::nowMicros();
+    if (sentMicros > nowMicros) {
+        return;
+    }
+    rtt_.addSample(std::chrono::microseconds(nowMicros - sentMicros));
+    if (linkQualityHandler_) {
+        linkQualityHandler_(rtt_.getQuality());
+    }
+}
+
+void ChatClient::sendCapabilities()
+{
+    // 在登录消息之前发出；服务器回复之前按 v1 格式发送，不压缩
+    format_ = FrameFormat{};
+    Message capabilities(Message::Type::CAPABILITIES);
+    capabilities.setContent(std::string(Compression::CAPABILITY) + "," + std::string(Message::V2_CAPABILITY));
+    sendMessage(capabilities);
+}
+
+void ChatClient::handleCapabilities(const Message& msg)
+{
+    const std::string& accepted = msg.getContent();
+    format_.compression = Message::hasCapability(accepted, Compression::CAPABILITY);
+    format_.version = Message::hasCapability(accepted, Message::V2_CAPABILITY) ? 2 : 1;
+}
+
+void ChatClient::handleUserList(const Message& msg)
+{
+    if (!trackPresence_) {
+        snapshotRequested_ = false;
+        if (userListHandler_) {
+            userListHandler_({});
+        }
+        return;
+    }
+
+    uint64_t version = 0;
+    std::vector<std::string> users;
+    if (!Presence::parseSnapshot(msg.getContent(), version, users)) {
+        return;
+    }
+
+    onlineUsers_.clear();
+    onlineUsers_.insert(users.begin(), users.end());
+    presenceVersion_ = version;
+    hasPresenceSnapshot_ = true;
+    snapshotRequested_ = false;
+
+    if (userListHandler_) {
+        userListHandler_({onlineUsers_.begin(), onlineUsers_.end()});
+    }
+}
+
+void ChatClient::handleUserListDelta(const Message& msg)
+{
+    Presence::Delta delta;
+    if (!hasPresenceSnapshot_ || !Presence::parseDelta(msg.getContent(), delta)) {
+        return;
+    }
+
+    // 快照已包含的旧增量直接忽略；中间缺了版本则重新请求快照
+    if (delta.version <= presenceVersion_) {
+        return;
+    }
+    if (delta.baseVersion != presenceVersion_) {
+        requestUserList();
+        return;
+    }
+
+    for (const auto& [username, online] : delta.changes) {
+        if (online) {
+            onlineUsers_.insert(username);
+        } else {
+            onlineUsers_.erase(username);
+        }
+    }
+    presenceVersion_ = delta.version;
+
+    if (userListHandler_) {
+        userListHandler_({onlineUsers_.begin(), onlineUsers_.end()});
+    }
+}
+
+void ChatClient::requestUserList()
+{
+    if (snapshotRequested_) {
+        return;
+    }
+    snapshotRequested_ = true;
+    hasPresenceSnapshot_ = false;
+    sendMessage(Message(Message::Type::USER_LIST));
+}
+
+void ChatClient::resetPresence()
+{
+    replayingHistory_ = false;
+    onlineUsers_.clear();
+    presenceVersion_ = 0;
+    hasPresenceSnapshot_ = false;
+    snapshotRequested_ = false;
+}
+
+void ChatClient::setUserListHandler(UserListHandler handler)
+{
+    userListHandler_ = std::move(handler);
+}
+
+void ChatClient::setLinkQualityHandler(LinkQualityHandler handler)
+{
+    linkQualityHandler_ = std::move(handler);
 }
 
 void ChatClient::disconnect()
@@ -91,9 +227,10 @@ void ChatClient::disconnect()
         asio::error_code ec;
         socket_.close(ec);
         connected_ = false;
+        writeMessages_.clear();
         heartbeatTimer_.cancel();
-        checkTimer_.cancel();
         reconnectTimer_.cancel();
+        failTransfers("disconnected");
     }
 }
 
@@ -104,9 +241,56 @@ void ChatClient::setDisconnectHandler(DisconnectHandler handler)
 
 void ChatClient::sendMessage(const Message& msg)
 {
-    auto encoded = msg.encode();
+    if (io_context_.get_executor().running_in_this_thread()) {
+        writeMessage(msg);
+        return;
+    }
+
+    outbox_.push(msg);
+    handoffMessages_.fetch_add(1, std::memory_order_relaxed);
+    // 只有把标志从 false 改为 true 的生产者投递任务，连续发送的一批消息只唤醒一次
+    if (!drainScheduled_.exchange(true, std::memory_order_seq_cst)) {
+        asio::post(io_context_, [this]() { drainOutbox(); });
+    }
+}
+
+void ChatClient::drainOutbox()
+{
+    handoffWakeups_.fetch_add(1, std::memory_order_relaxed);
+    // 先清标志再取：清之后入队的生产者会重新投递任务，之前入队的消息在下面一定能取到
+    drainScheduled_.store(false, std::memory_order_seq_cst);
+
+    // pop 失败而队列非空时，是某个生产者已交换了队尾但还没链入节点；它随后看到的标志
+    // 已被清掉，会重新投递任务，那个节点留给下一轮取，这里不必等待
     bool writeInProgress = !writeMessages_.empty();
-    writeMessages_.push_back(encoded);
+    Message msg;
+    while (outbox_.pop(msg)) {
+        SharedFrame frame = format_.compression ? msg.encodeCompressed(format_.version) : nullptr;
+        if (!frame) {
+            frame = msg.encodeShared(format_.version);
+        }
+        writeMessages_.push(std::move(frame), msg.getType());
+    }
+
+    if (!writeInProgress && !writeMessages_.empty()) {
+        doWrite();
+    }
+}
+
+ChatClient::HandoffStats ChatClient::getHandoffStats() const
+{
+    return {handoffMessages_.load(std::memory_order_relaxed), handoffWakeups_.load(std::memory_order_relaxed)};
+}
+
+void ChatClient::writeMessage(const Message& msg)
+{
+    SharedFrame frame = format_.compression ? msg.encodeCompressed(format_.version) : nullptr;
+    if (!frame) {
+        frame = msg.encodeShared(format_.version);
+    }
+
+    bool writeInProgress = !writeMessages_.empty();
+    writeMessages_.push(std::move(frame), msg.getType());
     
     if (!writeInProgress) {
         doWrite();
@@ -120,48 +304,332 @@ void ChatClient::setMessageHandler(MessageHandler handler)
 
 void ChatClient::doRead()
 {
-    socket_.async_read_some(asio::buffer(readBuffer_),
+    socket_.async_read_some(decoder_.prepare(),
         [this](const asio::error_code& ec, std::size_t length)
         {
             if (!ec) {
-                if (auto msg = Message::decode({readBuffer_.begin(), 
-                                              readBuffer_.begin() + length})) {
-                    if (msg->getType() == Message::Type::HEARTBEAT) {
-                        handleHeartbeat();
-                    } else if (messageHandler_) {
-                        messageHandler_(*msg);
+                // 一次读取可能包含多个帧，也可能只有半个帧
+                bool ok = decoder_.commit(length, [this](const uint8_t* data, std::size_t size) {
+                    MessageView view;
+                    if (!view.parse({data, size})) {
+                        return connected_;
+                    }
+                    // 下载的文件块直接从读缓冲区写入文件，不复制成 Message
+                    if (view.getType() == Message::Type::FILE_CHUNK) {
+                        receiveFileChunk(view);
+                        return connected_;
+                    }
+                    Message msg;
+                    if (!view.toMessage(msg)) {
+                        return connected_;
                     }
+                    switch (msg.getType()) {
+                    case Message::Type::HEARTBEAT:
+                        handleHeartbeat(msg);
+                        break;
+                    case Message::Type::CAPABILITIES:
+                        handleCapabilities(msg);
+                        break;
+                    case Message::Type::USER_LIST:
+                        handleUserList(msg);
+                        break;
+                    case Message::Type::USER_LIST_DELTA:
+                        handleUserListDelta(msg);
+                        break;
+                    case Message::Type::FILE_BEGIN:
+                    case Message::Type::FILE_CREDIT:
+                    case Message::Type::FILE_END:
+                    case Message::Type::FILE_ABORT:
+                        handleFileMessage(msg);
+                        break;
+                    default:
+                        if (msg.getType() == Message::Type::HISTORY_BEGIN) {
+                            replayingHistory_ = true;
+                        }
+                        if (messageHandler_) {
+                            messageHandler_(msg);
+                        }
+                        if (msg.getType() == Message::Type::HISTORY_END) {
+                            replayingHistory_ = false;
+                        }
+                        break;
+                    }
+                    return connected_;
+                });
+                if (!connected_) {
+                    return;  // 处理消息时已主动断开
                 }
-                doRead();
-            } else {
-                disconnect();
-                if (autoReconnect_) {
-                    startReconnectTimer();
-                } else if (disconnectHandler_) {
-                    disconnectHandler_();
+                if (ok) {
+                    doRead();
+                    return;
                 }
             }
+
+            // 读取出错或收到非法帧
+            disconnect();
+            if (autoReconnect_) {
+                startReconnectTimer();
+            } else if (disconnectHandler_) {
+                disconnectHandler_();
+            }
         });
 }
 
 void ChatClient::doWrite()
 {
-    asio::async_write(socket_,
-        asio::buffer(writeMessages_.front()),
-        [this](const asio::error_code& ec, std::size_t)
+    // 队列中所有待发帧合并为一次 gather 写
+    socket_.async_write_some(writeMessages_.prepareBatch(),
+        [this](const asio::error_code& ec, std::size_t length)
         {
             if (!ec) {
-                writeMessages_.pop_front();
+                writeMessages_.consume(length);
+                // 发送队列腾出空间后接着读盘发送上传块
+                if (!uploads_.empty()) {
+                    pumpUploads();
+                }
                 if (!writeMessages_.empty()) {
                     doWrite();
                 }
             } else {
-                socket_.close();
+                asio::error_code ignored;
+                socket_.close(ignored);
                 connected_ = false;
+                // 未写完的帧已无法续传，丢弃以免重连后阻塞发送
+                writeMessages_.clear();
+                failTransfers("disconnected");
             }
         });
 }
 
+std::string ChatClient::sendFile(const std::string& path, const std::string& recipient)
+{
+    std::string transferId = "up-" + std::to_string(nextTransferId_.fetch_add(1, std::memory_order_relaxed));
+    asio::post(io_context_, [this, transferId, path, recipient]() {
+        std::error_code ec;
+        uint64_t size = std::filesystem::file_size(path, ec);
+        std::FILE* file = ec ? nullptr : std::fopen(path.c_str(), "rb");
+        if (!file || !connected_) {
+            if (file) {
+                std::fclose(file);
+            }
+            reportProgress(transferId, true, 0, 0, true, {}, file ? "disconnected" : "open-failed");
+            return;
+        }
+
+        Upload& upload = uploads_[transferId];
+        upload.file = file;
+        upload.size = size;
+
+        // 服务器以 FILE_CREDIT 回复后才开始发送数据
+        Message begin(Message::Type::FILE_BEGIN);
+        begin.setTarget(recipient);
+        begin.setContent(transferId + "\n" + std::to_string(size) + "\n" +
+                         std::filesystem::path(path).filename().string());
+        writeMessage(begin);
+    });
+    return transferId;
+}
+
+void ChatClient::downloadFile(const std::string& fileId, const std::string& path)
+{
+    asio::post(io_context_, [this, fileId, path]() {
+        std::FILE* file = downloads_.count(fileId) > 0 || !connected_ ? nullptr : std::fopen(path.c_str(), "wb");
+        if (!file) {
+            reportProgress(fileId, false, 0, 0, true, {}, connected_ ? "open-failed" : "disconnected");
+            return;
+        }
+        Download& download = downloads_[fileId];
+        download.file = file;
+        download.path = path;
+
+        Message request(Message::Type::FILE_REQUEST);
+        request.setTarget(fileId);
+        writeMessage(request);
+    });
+}
+
+void ChatClient::setFileProgressHandler(FileProgressHandler handler)
+{
+    fileProgressHandler_ = std::move(handler);
+}
+
+void ChatClient::handleFileMessage(const Message& msg)
+{
+    const std::string& id = msg.getTarget();
+    auto upload = uploads_.find(id);
+    auto download = downloads_.find(id);
+
+    switch (msg.getType()) {
+    case Message::Type::FILE_BEGIN:
+        // 服务器开始发送下载：content 为 "<文件编号>\n<字节数>\n<文件名>"
+        if (download != downloads_.end()) {
+            const std::string& content = msg.getContent();
+            auto first = content.find('\n');
+            auto second = first == std::string::npos ? first : content.find('\n', first + 1);
+            if (second != std::string::npos) {
+                download->second.size = std::strtoull(content.substr(first + 1, second - first - 1).c_str(),
+                                                      nullptr, 10);
+            }
+        }
+        break;
+    case Message::Type::FILE_CREDIT:
+        if (upload != uploads_.end()) {
+            upload->second.granted = std::max<uint64_t>(upload->second.granted,
+                                                        std::strtoull(msg.getContent().c_str(), nullptr, 10));
+            bool idle = writeMessages_.empty();
+            pumpUploads();
+            if (idle && !writeMessages_.empty()) {
+                doWrite();
+            }
+        }
+        break;
+    case Message::Type::FILE_END:
+        if (upload != uploads_.end()) {
+            Upload done = upload->second;
+            uploads_.erase(upload);
+            std::fclose(done.file);
+            reportProgress(id, true, done.sent, done.size, true, msg.getContent());
+        } else if (download != downloads_.end()) {
+            Download done = download->second;
+            downloads_.erase(download);
+            bool flushed = std::fclose(done.file) == 0;
+            bool complete = flushed && done.received == done.size;
+            if (!complete) {
+                std::remove(done.path.c_str());
+            }
+            reportProgress(id, false, done.received, done.size, true, {},
+                           complete ? std::string() : std::string(flushed ? "incomplete" : "write-failed"));
+        }
+        break;
+    case Message::Type::FILE_ABORT:
+        if (upload != uploads_.end()) {
+            Upload failed = upload->second;
+            uploads_.erase(upload);
+            std::fclose(failed.file);
+            reportProgress(id, true, failed.sent, failed.size, true, {}, msg.getContent());
+        } else if (download != downloads_.end()) {
+            Download failed = download->second;
+            downloads_.erase(download);
+            std::fclose(failed.file);
+            std::remove(failed.path.c_str());
+            reportProgress(id, false, failed.received, failed.size, true, {}, msg.getContent());
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void ChatClient::receiveFileChunk(const MessageView& msg)
+{
+    auto it = downloads_.find(std::string(msg.getTarget()));
+    if (it == downloads_.end()) {
+        return;
+    }
+    Download& download = it->second;
+    std::string_view data = msg.getContent();
+    if (msg.isCompressed() || std::fwrite(data.data(), 1, data.size(), download.file) != data.size()) {
+        // 写盘失败时取消下载，服务器收到 FILE_ABORT 后停止发送
+        std::string fileId = it->first;
+        Download failed = download;
+        downloads_.erase(it);
+        std::fclose(failed.file);
+        std::remove(failed.path.c_str());
+        Message abort(Message::Type::FILE_ABORT);
+        abort.setTarget(fileId);
+        writeMessage(abort);
+        reportProgress(fileId, false, failed.received, failed.size, true, {}, "write-failed");
+        return;
+    }
+    download.received += data.size();
+    if (download.received - download.reported >= PROGRESS_STEP) {
+        download.reported = download.received;
+        reportProgress(it->first, false, download.received, download.size, false);
+    }
+}
+
+void ChatClient::pumpUploads()
+{
+    // 发送队列里最多排着两块文件数据：额度再多也不提前读盘，
+    // 之后入队的聊天消息最多等这两块写完
+    std::vector<std::string> failed;
+    for (auto& [transferId, upload] : uploads_) {
+        while (upload.sent < upload.size && upload.sent < upload.granted &&
+               writeMessages_.bytes() < 2 * UPLOAD_CHUNK_SIZE) {
+            std::size_t length = static_cast<std::size_t>(std::min<uint64_t>(
+                {UPLOAD_CHUNK_SIZE, upload.size - upload.sent, upload.granted - upload.sent}));
+            // 文件内容直接读进帧缓冲区的帧头之后；文件块不压缩
+            Message chunk(Message::Type::FILE_CHUNK);
+            chunk.setTarget(transferId);
+            std::vector<uint8_t> frame = chunk.encodeHeader(length, format_.version);
+            std::size_t headerSize = frame.size();
+            frame.resize(headerSize + length);
+            if (std::fread(frame.data() + headerSize, 1, length, upload.file) != length) {
+                failed.push_back(transferId);
+                break;
+            }
+            upload.sent += length;
+            writeMessages_.push(std::make_shared<const std::vector<uint8_t>>(std::move(frame)),
+                                Message::Type::FILE_CHUNK);
+        }
+        if (upload.sent - upload.reported >= PROGRESS_STEP) {
+            upload.reported = upload.sent;
+            reportProgress(transferId, true, upload.sent, upload.size, false);
+        }
+        if (upload.sent == upload.size && !upload.endSent) {
+            upload.endSent = true;
+            Message end(Message::Type::FILE_END);
+            end.setTarget(transferId);
+            writeMessages_.push(end.encodeShared(format_.version), end.getType());
+        }
+    }
+
+    for (const auto& transferId : failed) {
+        Upload upload = uploads_[transferId];
+        uploads_.erase(transferId);
+        std::fclose(upload.file);
+        Message abort(Message::Type::FILE_ABORT);
+        abort.setTarget(transferId);
+        writeMessages_.push(abort.encodeShared(format_.version), abort.getType());
+        reportProgress(transferId, true, upload.sent, upload.size, true, {}, "read-failed");
+    }
+}
+
+void ChatClient::reportProgress(const std::string& id, bool upload, uint64_t transferred, uint64_t total,
+                                bool finished, const std::string& fileId, const std::string& error)
+{
+    if (!fileProgressHandler_) {
+        return;
+    }
+    FileProgress progress;
+    progress.id = id;
+    progress.upload = upload;
+    progress.transferred = transferred;
+    progress.total = total;
+    progress.finished = finished;
+    progress.fileId = fileId;
+    progress.error = error;
+    fileProgressHandler_(progress);
+}
+
+void ChatClient::failTransfers(const std::string& error)
+{
+    // 连接断开后服务器丢弃了未完成的传输，不能在重连后续传
+    auto uploads = std::move(uploads_);
+    auto downloads = std::move(downloads_);
+    uploads_.clear();
+    downloads_.clear();
+    for (auto& [transferId, upload] : uploads) {
+        std::fclose(upload.file);
+        reportProgress(transferId, true, upload.sent, upload.size, true, {}, error);
+    }
+    for (auto& [fileId, download] : downloads) {
+        std::fclose(download.file);
+        std::remove(download.path.c_str());
+        reportProgress(fileId, false, download.received, download.size, true, {}, error);
+    }
+}
+
 void ChatClient::startReconnectTimer()
 {
     if (reconnectAttempts_ >= maxReconnectAttempts_) {
@@ -212,9 +680,17 @@ void ChatClient::tryReconnect()
         {
             if (!ec) {
                 connected_ = true;
+                setNoDelay();
+                decoder_.reset();
+                resetPresence();
                 reconnectAttempts_ = 0;
+                lastHeartbeat_ = std::chrono::steady_clock::now();
+                rtt_.reset();
                 doRead();
                 startHeartbeat();
+                sendCapabilities();
+                // 连接后立即探测一次，不必等第一个心跳周期就能显示延迟
+                sendHeartbeat();
                 
                 // 发送重连成功消息
                 if (messageHandler_) {
@@ -1,26 +1,82 @@
 #pragma once
 #include <asio.hpp>
+#include <atomic>
 #include <string>
-#include <deque>
 #include <functional>
 #include <chrono>
+#include <cstdio>
+#include <map>
 #include <random>
+#include <set>
+#include <vector>
 #include "message.hpp"
+#include "message_view.hpp"
+#include "frame_decoder.hpp"
+#include "link_quality.hpp"
+#include "mpsc_queue.hpp"
+#include "send_queue.hpp"
 
 class ChatClient {
 public:
     using MessageHandler = std::function<void(const Message&)>;
     using ConnectHandler = std::function<void(bool)>;
     using DisconnectHandler = std::function<void()>;
+    using UserListHandler = std::function<void(const std::vector<std::string>&)>;
+    using LinkQualityHandler = std::function<void(const LinkQuality&)>;
+
+    // 文件传输进度
+    struct FileProgress {
+        std::string id;          // 上传为传输编号，下载为文件编号
+        bool upload{true};
+        uint64_t transferred{0};
+        uint64_t total{0};
+        bool finished{false};    // 完成或失败，之后不再回调
+        std::string fileId;      // 上传完成后服务器分配的文件编号
+        std::string error;       // 失败原因，成功时为空
+    };
+    using FileProgressHandler = std::function<void(const FileProgress&)>;
 
     ChatClient(asio::io_context& io_context);
     
     void connect(const std::string& host, uint16_t port, ConnectHandler onConnect);
     void disconnect();
+    // 可在任意线程调用。其他线程（界面线程）发来的消息经无锁队列交给事件循环线程，
+    // 事件循环线程每次唤醒取出队列中的全部消息，合并成一次写
     void sendMessage(const Message& msg);
     void setMessageHandler(MessageHandler handler);
     void setDisconnectHandler(DisconnectHandler handler);
+    // 在线用户列表变化时以完整列表回调（由服务器的快照和增量合成）
+    void setUserListHandler(UserListHandler handler);
+    // 关闭后不再维护在线用户集合：收到快照时以空列表回调，忽略增量
+    void setPresenceTracking(bool enabled) { trackPresence_ = enabled; }
+    // 每测得一次心跳往返时间回调一次（在事件循环线程上）
+    void setLinkQualityHandler(LinkQualityHandler handler);
+    const RttEstimator& getRtt() const { return rtt_; }
     bool isConnected() const { return connected_; }
+    // 文件传输，可在任意线程调用，实际操作在事件循环线程上进行。
+    // 上传时按服务器给的额度读盘发送，发送队列里最多排着两块文件数据，
+    // 聊天消息不会被大文件挡住。返回传输编号，进度和结果经 FileProgressHandler 报告
+    std::string sendFile(const std::string& path, const std::string& recipient);
+    // 把服务器上的文件（FILE_AVAILABLE 中的编号）下载到 path
+    void downloadFile(const std::string& fileId, const std::string& path);
+    // 进度回调在事件循环线程上调用，每传输约 1 MiB 和结束时各一次
+    void setFileProgressHandler(FileProgressHandler handler);
+
+    // 服务器在能力协商中同意后，大消息以压缩帧发送，所有消息使用 v2 帧
+    const FrameFormat& getFrameFormat() const { return format_; }
+    // 处于服务器历史重放（HISTORY_BEGIN 与 HISTORY_END 之间）时为 true
+    bool isReplayingHistory() const { return replayingHistory_; }
+
+    // 批量写配置与统计（每次系统调用写出的帧数）
+    void setWriteBatchLimits(const SendQueue::BatchLimits& limits) { writeMessages_.setBatchLimits(limits); }
+    const SendQueue::Stats& getWriteStats() const { return writeMessages_.getStats(); }
+
+    // 其他线程交来的消息数和事件循环线程为此被唤醒的次数，可在任意线程读取
+    struct HandoffStats {
+        uint64_t messages{0};
+        uint64_t wakeups{0};
+    };
+    HandoffStats getHandoffStats() const;
 
     // 添加重连相关设置
     void setAutoReconnect(bool enable);
@@ -41,23 +97,85 @@ public:
 private:
     void doRead();
     void doWrite();
+    // 在事件循环线程上编码并入队
+    void writeMessage(const Message& msg);
+    void drainOutbox();
+    void setNoDelay();
     void startHeartbeat();
-    void checkHeartbeat();
-    void handleHeartbeat();
+    bool checkHeartbeat();
+    void sendHeartbeat();
+    void handleHeartbeat(const Message& msg);
+    void sendCapabilities();
+    void handleCapabilities(const Message& msg);
+    void handleUserList(const Message& msg);
+    void handleUserListDelta(const Message& msg);
+    void requestUserList();
+    void resetPresence();
     void startReconnectTimer();
     void tryReconnect();
+    void handleFileMessage(const Message& msg);
+    void receiveFileChunk(const MessageView& msg);
+    // 在额度和发送队列允许的范围内读盘并入队下一批上传块，只入队不发起写
+    void pumpUploads();
+    void reportProgress(const std::string& id, bool upload, uint64_t transferred, uint64_t total,
+                        bool finished, const std::string& fileId = {}, const std::string& error = {});
+    void failTransfers(const std::string& error);
+
+    struct Upload {
+        std::FILE* file{nullptr};
+        uint64_t size{0};
+        uint64_t sent{0};
+        uint64_t granted{0};
+        uint64_t reported{0};
+        bool endSent{false};
+    };
+    struct Download {
+        std::FILE* file{nullptr};
+        std::string path;
+        uint64_t received{0};
+        uint64_t size{0};
+        uint64_t reported{0};
+    };
 
     asio::io_context& io_context_;
     asio::ip::tcp::socket socket_;
-    std::vector<uint8_t> readBuffer_;
-    std::deque<std::vector<uint8_t>> writeMessages_;
+    FrameDecoder decoder_;
+    SendQueue writeMessages_;
+
+    // 其他线程发来的消息。drainScheduled_ 为 true 时已有一次取队列的任务在等待执行，
+    // 新消息只入队不再唤醒事件循环
+    MpscQueue<Message> outbox_;
+    std::atomic<bool> drainScheduled_{false};
+    std::atomic<uint64_t> handoffMessages_{0};
+    std::atomic<uint64_t> handoffWakeups_{0};
     MessageHandler messageHandler_;
     DisconnectHandler disconnectHandler_;
+    UserListHandler userListHandler_;
+    LinkQualityHandler linkQualityHandler_;
+    FileProgressHandler fileProgressHandler_;
     bool connected_;
+    bool replayingHistory_{false};
+    FrameFormat format_;
+
+    // 在线用户列表及其版本；收到快照之前忽略增量，版本不连续时重新请求快照
+    std::set<std::string> onlineUsers_;
+    uint64_t presenceVersion_{0};
+    bool hasPresenceSnapshot_{false};
+    bool snapshotRequested_{false};
+    bool trackPresence_{true};
     
+    // 单个定时器既负责定期发送心跳，也负责检查超时
     asio::steady_timer heartbeatTimer_;
-    asio::steady_timer checkTimer_;
     std::chrono::steady_clock::time_point lastHeartbeat_;
+    RttEstimator rtt_;
+
+    // 进行中的文件传输，只在事件循环线程上访问
+    std::map<std::string, Upload> uploads_;
+    std::map<std::string, Download> downloads_;
+    std::atomic<uint64_t> nextTransferId_{1};
+    static constexpr std::size_t UPLOAD_CHUNK_SIZE = 64 * 1024;
+    static constexpr uint64_t PROGRESS_STEP = 1024 * 1024;
+
     static constexpr auto HEARTBEAT_INTERVAL = std::chrono::seconds(5);
     static constexpr auto HEARTBEAT_TIMEOUT = std::chrono::seconds(15);
 
@@ -1,90 +1,878 @@
 #include "chat_server.hpp"
 #include "chat_session.hpp"
+#include "buffer_pool.hpp"
+#include "compression.hpp"
+#include "handler_memory.hpp"
+#include "presence.hpp"
+#include <algorithm>
 #include <iostream>
+#include <mutex>
 
-ChatServer::ChatServer(asio::io_context& io_context, uint16_t port)
-    : io_context_(io_context)
-    , acceptor_(io_context, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port))
+ChatServer::ChatServer(IoContextPool& pool, uint16_t port)
+    : pool_(pool)
+    , acceptor_(pool.getIoContext(0), asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port))
+    , metrics_(pool.size())
+    , statsTimer_(pool.getIoContext(0))
+    , directoryStrand_(asio::make_strand(pool.getIoContext(0)))
+    , presenceTimer_(directoryStrand_)
 {
-    (void)io_context_;
+    for (std::size_t i = 0; i < pool_.size(); ++i) {
+        shards_.push_back(std::make_unique<Shard>(pool_.getIoContext(i), metrics_.local(i)));
+    }
 }
 
 void ChatServer::start()
 {
-    std::cout << "服务器启动在端口: " << acceptor_.local_endpoint().port() << std::endl;
+    std::cout << "服务器启动在端口: " << getPort()
+              << " (事件循环: " << pool_.size() << ")" << std::endl;
+    for (auto& shard : shards_) {
+        shard->heartbeatWheel.start();
+    }
+    if (federation_) {
+        federation_->start();
+    }
     doAccept();
+    startStatsReport();
 }
 
 void ChatServer::doAccept()
 {
-    acceptor_.async_accept(
-        [this](const asio::error_code& error, asio::ip::tcp::socket socket)
+    // 新连接的 socket 直接绑定到选中的事件循环上
+    std::size_t index = pool_.acquire();
+    acceptor_.async_accept(pool_.getIoContext(index),
+        [this, index](const asio::error_code& error, asio::ip::tcp::socket socket)
         {
             if (!error) {
+                asio::error_code ec;
+                auto endpoint = socket.remote_endpoint(ec);
                 std::cout << "新客户端连接: " 
-                          << socket.remote_endpoint().address().to_string() 
+                          << (ec ? std::string("未知") : endpoint.address().to_string())
+                          << " -> 循环 " << index
                           << std::endl;
                 
-                auto session = std::make_shared<ChatSession>(std::move(socket), *this);
-                session->start();
+                auto session = std::make_shared<ChatSession>(std::move(socket), *this, index);
+                asio::post(pool_.getIoContext(index), [session]() {
+                    session->start();
+                });
+            } else {
+                pool_.release(index);
             }
             
             doAccept();
         });
 }
 
-void ChatServer::broadcastMessage(const Message& msg, std::shared_ptr<ChatSession> sender)
+void ChatServer::watchHeartbeat(const std::shared_ptr<ChatSession>& session)
+{
+    shards_[session->getShardIndex()]->heartbeatWheel.add(session);
+}
+
+void ChatServer::setMessageWriter(AsyncMessageWriter* writer)
+{
+    messageWriter_ = writer;
+    // 重启后接着数据库里已有的最大序号分配
+    if (writer) {
+        nextSequence_.store(writer->getLastSequence() + 1, std::memory_order_relaxed);
+    }
+}
+
+void ChatServer::setRateLimits(const RateLimitConfig& limits)
+{
+    rateLimits_ = limits;
+    addressLimiters_ = limits.address.enabled() ? std::make_unique<AddressLimiterTable>(limits.address) : nullptr;
+}
+
+RateLimiter ChatServer::createRateLimiter(const asio::ip::tcp::socket& socket)
+{
+    if (!rateLimits_.enabled()) {
+        return RateLimiter();
+    }
+
+    std::shared_ptr<AddressBuckets> address;
+    asio::error_code ec;
+    auto endpoint = socket.remote_endpoint(ec);
+    if (addressLimiters_ && !ec) {
+        address = addressLimiters_->acquire(endpoint.address().to_string());
+    }
+    return RateLimiter(rateLimits_.session, std::move(address));
+}
+
+uint64_t ChatServer::nextTimestamp()
+{
+    uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    uint64_t last = lastTimestamp_.load(std::memory_order_relaxed);
+    while (now > last && !lastTimestamp_.compare_exchange_weak(last, now, std::memory_order_relaxed)) {
+    }
+    // 系统时钟被往回调时沿用最近一次的时间戳
+    return std::max(now, last);
+}
+
+uint64_t ChatServer::nextSequence(Message::Type type)
+{
+    // 客户端发来的序号一律不可信，只有聊天消息（包括私聊）分配序号
+    bool chat = type == Message::Type::TEXT || type == Message::Type::ROOM_TEXT ||
+                type == Message::Type::PRIVATE;
+    return chat ? nextSequence_.fetch_add(1, std::memory_order_relaxed) : 0;
+}
+
+SharedOutbound ChatServer::publish(Message msg, const MessageView* received)
+{
+    msg.setTimestamp(nextTimestamp());
+    msg.setSequence(nextSequence(msg.getType()));
+
+    // 每种帧格式只编码（和压缩）一次，所有分片和会话共享同一份帧缓冲区
+    auto outbound = received
+        ? makeOutbound(std::move(msg), *received)
+        : makeOutbound(std::move(msg));
+    retain(outbound);
+    return outbound;
+}
+
+SharedOutbound ChatServer::publish(const MessageView& received)
+{
+    // 压缩帧需要解压一次才能校验和持久化，解压后的内容也用于其他格式的帧
+    if (received.isCompressed()) {
+        Message msg;
+        if (!received.toMessage(msg)) {
+            return nullptr;
+        }
+        return publish(std::move(msg), &received);
+    }
+
+    uint64_t timestamp = nextTimestamp();
+    auto outbound = makeOutbound(received, nextSequence(received.getType()), timestamp);
+    retain(outbound);
+    return outbound;
+}
+
+void ChatServer::retain(const SharedOutbound& msg)
+{
+    // 私聊不写入数据库，也不进历史缓存：两者都按房间向所有人重放
+    Message::Type type = msg->getType();
+    if (type != Message::Type::TEXT && type != Message::Type::ROOM_TEXT) {
+        return;
+    }
+    // 只有持久化需要一份独立的 Message，历史缓存直接共享待发送消息
+    if (messageWriter_) {
+        messageWriter_->enqueue(msg->toMessage());
+    }
+    history_.append(type == Message::Type::ROOM_TEXT ? msg->getTarget() : std::string_view(), msg);
+}
+
+void ChatServer::broadcastMessage(Message msg, std::shared_ptr<ChatSession> sender)
+{
+    fanOut(publish(std::move(msg)), sender);
+}
+
+void ChatServer::relayMessage(const MessageView& msg, std::shared_ptr<ChatSession> sender)
+{
+    // 转发时复用收到的帧，不构造 Message
+    auto outbound = publish(msg);
+    if (!outbound) {
+        shards_[sender->getShardIndex()]->metrics.decodeFailures.add();
+        return;
+    }
+
+    if (outbound->getType() == Message::Type::ROOM_TEXT) {
+        fanOutToRoom(outbound, sender);
+    } else {
+        fanOut(outbound, sender);
+    }
+    if (federation_) {
+        federation_->forward(outbound);
+    }
+}
+
+void ChatServer::sendPrivate(const MessageView& msg, std::shared_ptr<ChatSession> sender)
+{
+    // 私聊按身份投递，发送方必须是会话本人；不合法的私聊与冒名的聊天消息一样计入解码失败，
+    // 并告知发送方没有送出
+    if (msg.getTarget().empty() || msg.getSender() != sender->getUsername()) {
+        shards_[sender->getShardIndex()]->metrics.decodeFailures.add();
+        Message status(Message::Type::PRIVATE_STATUS);
+        status.setTarget(std::string(msg.getTarget()));
+        status.setContent("invalid");
+        sender->deliver(status);
+        return;
+    }
+    auto outbound = publish(msg);
+    if (!outbound) {
+        shards_[sender->getShardIndex()]->metrics.decodeFailures.add();
+        return;
+    }
+
+    asio::post(directoryStrand_, [this, outbound, sender = std::move(sender)]()
+    {
+        routePrivate(outbound, sender, false);
+    });
+}
+
+void ChatServer::announceFile(const FileStore::StoredFile& file, std::shared_ptr<ChatSession> sender)
+{
+    // 文件通知和私聊一样按用户目录投递，接收方不在线时存入离线信箱；
+    // 文件只保存在本节点，通知不转发给其他节点
+    Message notice(Message::Type::FILE_AVAILABLE);
+    notice.setSender(file.owner);
+    notice.setTarget(file.recipient);
+    notice.setContent(file.id + "\n" + std::to_string(file.size) + "\n" + file.name);
+    auto outbound = publish(std::move(notice));
+    if (file.recipient.empty()) {
+        fanOut(outbound, sender);
+        return;
+    }
+    asio::post(directoryStrand_, [this, outbound, sender = std::move(sender)]()
+    {
+        routePrivate(outbound, sender, false);
+    });
+}
+
+void ChatServer::routePrivate(const SharedOutbound& msg, const std::shared_ptr<ChatSession>& sender,
+                              bool fromPeer)
 {
-    for (const auto& [username, session] : sessions_) {
-        if (!sender || session != sender) {
+    // 只查接收方和发送方两个目录项，只投递到他们有会话的分片，
+    // 单条私聊的开销与在线总人数无关
+    bool chat = msg->getType() == Message::Type::PRIVATE;
+    if (chat) {
+        metrics_.local(0).privateMessages.add();
+    }
+    std::string_view recipient = msg->getTarget();
+
+    // 发送方的其他会话也收到一份，多个设备上的对话保持一致；其他节点转来的消息发送方不在本节点
+    auto recipientEntry = directory_.find(recipient);
+    auto senderEntry = fromPeer || msg->getSender() == recipient
+        ? directory_.end()
+        : directory_.find(msg->getSender());
+    for (std::size_t i = 0; i < shards_.size(); ++i) {
+        bool toRecipient = recipientEntry != directory_.end() && recipientEntry->second.shardSessions[i] > 0;
+        bool toSender = senderEntry != directory_.end() && senderEntry->second.shardSessions[i] > 0;
+        if (!toRecipient && !toSender) {
+            continue;
+        }
+        asio::post(shards_[i]->io_context, [shard = shards_[i].get(), msg, sender, toRecipient, toSender]()
+        {
+            auto deliverTo = [&](std::string_view username) {
+                auto [begin, end] = shard->sessions.equal_range(username);
+                for (auto it = begin; it != end; ++it) {
+                    if (it->second != sender) {
+                        it->second->deliver(msg);
+                    }
+                }
+            };
+            if (toRecipient) {
+                deliverTo(msg->getTarget());
+            }
+            if (toSender) {
+                deliverTo(msg->getSender());
+            }
+        });
+    }
+    if (recipientEntry != directory_.end()) {
+        return;
+    }
+
+    // 接收方在其他节点上时只转发给那个节点；转来的消息不再转发（水平分割）
+    if (federation_ && !fromPeer && chat) {
+        for (const auto& [node, users] : remoteDirectory_) {
+            if (users.count(recipient) > 0) {
+                federation_->forwardTo(node, msg);
+                return;
+            }
+        }
+    }
+    storeOffline(msg, sender);
+}
+
+void ChatServer::storeOffline(const SharedOutbound& msg, const std::shared_ptr<ChatSession>& sender)
+{
+    auto& metrics = metrics_.local(0);
+    std::string recipient(msg->getTarget());
+    auto mailbox = offlineMessages_.find(recipient);
+    std::size_t queued = mailbox == offlineMessages_.end() ? 0 : mailbox->second.size();
+    bool stored = queued < OFFLINE_MAILBOX_SIZE && offlineCount_ < MAX_OFFLINE_MESSAGES;
+    if (stored) {
+        offlineMessages_[recipient].push_back(msg);
+        ++offlineCount_;
+        metrics.privateOffline.add();
+        metrics.offlineMessages.add(1);
+    } else {
+        metrics.privateRejected.add();
+    }
+
+    if (!sender) {
+        return;
+    }
+    Message status(Message::Type::PRIVATE_STATUS);
+    status.setTarget(recipient);
+    status.setContent(stored ? "offline" : "rejected");
+    asio::post(shards_[sender->getShardIndex()]->io_context, [sender, status = std::move(status)]()
+    {
+        sender->deliver(status);
+    });
+}
+
+void ChatServer::deliverOffline(const std::string& username, const std::shared_ptr<ChatSession>& session)
+{
+    // 离线消息只投递给最先登录的会话
+    auto mailbox = offlineMessages_.find(username);
+    if (mailbox == offlineMessages_.end()) {
+        return;
+    }
+    auto messages = std::move(mailbox->second);
+    offlineMessages_.erase(mailbox);
+    offlineCount_ -= messages.size();
+    metrics_.local(0).offlineMessages.add(-static_cast<int64_t>(messages.size()));
+
+    asio::post(shards_[session->getShardIndex()]->io_context,
+        [session, messages = std::move(messages)]()
+    {
+        for (const auto& msg : messages) {
             session->deliver(msg);
         }
+    });
+}
+
+void ChatServer::enableFederation(const FederationConfig& config)
+{
+    // 联邦状态和在线用户目录在同一个 strand 上，合并目录不需要额外同步；
+    // strand 运行在第 0 个事件循环上，联邦的指标记入分片 0
+    federation_ = std::make_unique<Federation>(*this, directoryStrand_, metrics_.local(0), config);
+}
+
+void ChatServer::deliverFederated(Message msg)
+{
+    auto outbound = publish(std::move(msg));
+    if (outbound->getType() == Message::Type::PRIVATE) {
+        routePrivate(outbound, nullptr, true);
+    } else if (outbound->getType() == Message::Type::ROOM_TEXT) {
+        fanOutToRoom(outbound, nullptr);
+    } else {
+        fanOut(outbound, nullptr);
+    }
+}
+
+void ChatServer::fanOut(const SharedOutbound& msg, const std::shared_ptr<ChatSession>& sender)
+{
+    // 投递到每个分片所属的线程上发送，分片之间互不阻塞
+    for (auto& shard : shards_) {
+        asio::post(shard->io_context, pooled([shard = shard.get(), msg, sender]()
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (const auto& [username, session] : shard->sessions) {
+                if (!sender || session != sender) {
+                    session->deliver(msg);
+                }
+            }
+            shard->metrics.fanOutDuration.record(std::chrono::steady_clock::now() - start);
+        }));
     }
 }
 
 void ChatServer::removeSession(std::shared_ptr<ChatSession> session)
 {
+    // 在会话所属线程上调用
+    pool_.release(session->getShardIndex());
+    shards_[session->getShardIndex()]->metrics.connectionsClosed.add();
+
+    // 退出所有房间并通知房间成员
+    auto rooms = session->getRooms();
+    for (const auto& room : rooms) {
+        leaveRoom(session, room);
+    }
+
     const std::string& username = session->getUsername();
     if (!username.empty()) {
-        sessions_.erase(username);
-        
-        // 广播用户离开消息
-        Message leaveMsg(Message::Type::LEAVE);
-        leaveMsg.setSender(username);
-        leaveMsg.setContent(username + " 离开了聊天室");
-        broadcastMessage(leaveMsg);
+        auto& sessions = shards_[session->getShardIndex()]->sessions;
+        auto [begin, end] = sessions.equal_range(username);
+        auto it = std::find_if(begin, end, [&session](const auto& entry) { return entry.second == session; });
+        if (it != end) {
+            sessions.erase(it);
+        }
         
-        updateUserList();
+        asio::post(directoryStrand_, [this, username, shardIndex = session->getShardIndex()]()
+        {
+            auto entry = directory_.find(username);
+            if (entry == directory_.end()) {
+                return;
+            }
+            --entry->second.shardSessions[shardIndex];
+            if (--entry->second.sessions == 0) {
+                directory_.erase(entry);
+                markPresenceChanged(username);
+                if (federation_) {
+                    federation_->announceLocal(username, false);
+                }
+            }
+        });
     }
 }
 
 void ChatServer::addSession(std::shared_ptr<ChatSession> session)
 {
+    // 在会话所属线程上调用
     const std::string& username = session->getUsername();
     if (!username.empty()) {
-        sessions_[username] = session;
+        shards_[session->getShardIndex()]->sessions.emplace(username, session);
+        replayHistory(session, "", HISTORY_CACHE_SIZE);
         
-        // 广播用户加入消息
-        Message joinMsg(Message::Type::JOIN);
-        joinMsg.setSender(username);
-        joinMsg.setContent(username + " 加入了聊天室");
-        broadcastMessage(joinMsg);
-        
-        updateUserList();
+        asio::post(directoryStrand_, [this, username, session]()
+        {
+            auto& entry = directory_[username];
+            if (entry.shardSessions.empty()) {
+                entry.shardSessions.resize(shards_.size());
+            }
+            ++entry.shardSessions[session->getShardIndex()];
+            if (++entry.sessions == 1) {
+                markPresenceChanged(username);
+                if (federation_) {
+                    federation_->announceLocal(username, true);
+                }
+            }
+            deliverOffline(username, session);
+            // 只有新加入的会话收到全量快照，其他人只收到增量
+            pendingSnapshots_.insert(session);
+            schedulePresenceFlush();
+        });
     }
 }
 
-void ChatServer::updateUserList()
+void ChatServer::sendUserList(std::shared_ptr<ChatSession> session)
+{
+    // 客户端发现版本不连续时请求全量快照；窗口内的重复请求合并为一份
+    asio::post(directoryStrand_, [this, session]()
+    {
+        pendingSnapshots_.insert(session);
+        schedulePresenceFlush();
+    });
+}
+
+void ChatServer::joinRoom(std::shared_ptr<ChatSession> session, const std::string& room)
 {
-    // 构建用户列表消息
-    Message userListMsg(Message::Type::USER_LIST);
-    std::string userList;
-    for (const auto& [username, _] : sessions_) {
-        if (!userList.empty()) userList += ",";
-        userList += username;
+    if (session->getUsername().empty() || !session->addRoom(room)) {
+        return;
     }
-    userListMsg.setContent(userList);
-    
-    // 广播用户列表
-    broadcastMessage(userListMsg);
-} 
\ No newline at end of file
+    shards_[session->getShardIndex()]->rooms[room].push_back(session);
+
+    // 通知房间所有成员（包括加入者本人，作为确认）
+    Message notice(Message::Type::JOIN_ROOM);
+    notice.setSender(session->getUsername());
+    notice.setTarget(room);
+    notice.setContent(session->getUsername() + " 加入了房间 " + room);
+    // 广播投递到各分片队列，历史也投递到加入者所在分片，排在确认之后，
+    // 客户端依次看到：加入确认、历史、实时消息
+    auto frames = history_.recent(room, HISTORY_CACHE_SIZE);
+    broadcastToRoom(room, std::move(notice));
+    asio::post(shards_[session->getShardIndex()]->io_context,
+               [session, room, frames = std::move(frames)]()
+    {
+        deliverHistory(session, room, frames);
+    });
+}
+
+void ChatServer::leaveRoom(std::shared_ptr<ChatSession> session, const std::string& room)
+{
+    if (!session->removeRoom(room)) {
+        return;
+    }
+    unsubscribe(*shards_[session->getShardIndex()], session, room);
+
+    Message notice(Message::Type::LEAVE_ROOM);
+    notice.setSender(session->getUsername());
+    notice.setTarget(room);
+    notice.setContent(session->getUsername() + " 离开了房间 " + room);
+    // 离开者已不在房间索引中，单独给它一份同一条（带序号和时间戳的）通知作为确认
+    auto outbound = publish(std::move(notice));
+    fanOutToRoom(outbound, session);
+    session->deliver(outbound);
+}
+
+void ChatServer::unsubscribe(Shard& shard, const std::shared_ptr<ChatSession>& session,
+                             const std::string& room)
+{
+    auto it = shard.rooms.find(room);
+    if (it == shard.rooms.end()) {
+        return;
+    }
+
+    // 房间成员顺序无关，交换到末尾后删除
+    auto& members = it->second;
+    auto member = std::find(members.begin(), members.end(), session);
+    if (member != members.end()) {
+        std::swap(*member, members.back());
+        members.pop_back();
+    }
+    if (members.empty()) {
+        shard.rooms.erase(it);
+    }
+}
+
+void ChatServer::broadcastToRoom(const std::string& room, Message msg,
+                                 std::shared_ptr<ChatSession> sender)
+{
+    msg.setTarget(room);
+    fanOutToRoom(publish(std::move(msg)), sender);
+}
+
+void ChatServer::fanOutToRoom(const SharedOutbound& msg, const std::shared_ptr<ChatSession>& sender)
+{
+    // 每个分片只按房间索引查找成员，单条消息的开销与房间人数和分片数相关，
+    // 与服务器总在线人数无关
+    for (auto& shard : shards_) {
+        asio::post(shard->io_context, pooled([shard = shard.get(), msg, sender]()
+        {
+            auto it = shard->rooms.find(msg->getTarget());
+            if (it == shard->rooms.end()) {
+                return;
+            }
+            auto start = std::chrono::steady_clock::now();
+            for (const auto& session : it->second) {
+                if (session != sender) {
+                    session->deliver(msg);
+                }
+            }
+            shard->metrics.fanOutDuration.record(std::chrono::steady_clock::now() - start);
+        }));
+    }
+}
+
+void ChatServer::requestHistory(std::shared_ptr<ChatSession> session, const std::string& room,
+                                std::size_t count)
+{
+    // 房间历史只对房间成员开放
+    const auto& rooms = session->getRooms();
+    if (!room.empty() && std::find(rooms.begin(), rooms.end(), room) == rooms.end()) {
+        return;
+    }
+
+    count = std::min(count, MAX_HISTORY_REQUEST);
+    if (count <= history_.capacity() || !messageWriter_) {
+        replayHistory(session, room, count);
+        return;
+    }
+
+    // 更早的历史在写线程上查询，结果编码后投递回会话所属线程
+    asio::io_context& io_context = shards_[session->getShardIndex()]->io_context;
+    messageWriter_->submitQuery([&io_context, session, room, count](MessageStore& store)
+    {
+        auto rows = store.getRoomMessages(room, count);
+
+        auto frames = std::make_shared<std::vector<SharedOutbound>>();
+        frames->reserve(rows.size());
+        for (const auto& row : rows) {
+            Message msg(row.type);
+            msg.setSender(row.sender);
+            msg.setContent(row.content);
+            msg.setTarget(row.room);
+            msg.setSequence(row.sequence);
+            msg.setTimestamp(row.serverTime);
+            frames->push_back(makeOutbound(std::move(msg)));
+        }
+
+        asio::post(io_context, [session, room, frames]()
+        {
+            deliverHistory(session, room, *frames);
+        });
+    });
+}
+
+void ChatServer::replayHistory(const std::shared_ptr<ChatSession>& session, const std::string& room,
+                               std::size_t count)
+{
+    // 缓存里是广播时编码好的帧，直接复用，不访问数据库
+    deliverHistory(session, room, history_.recent(room, count));
+}
+
+void ChatServer::deliverHistory(const std::shared_ptr<ChatSession>& session, const std::string& room,
+                                const std::vector<SharedOutbound>& frames)
+{
+    Message begin(Message::Type::HISTORY_BEGIN);
+    begin.setTarget(room);
+    session->deliver(begin);
+    for (const auto& frame : frames) {
+        session->deliver(frame);
+    }
+    Message end(Message::Type::HISTORY_END);
+    end.setTarget(room);
+    end.setContent(std::to_string(frames.size()));
+    session->deliver(end);
+}
+
+std::vector<std::string> ChatServer::getLocalUsers() const
+{
+    std::vector<std::string> users;
+    users.reserve(directory_.size());
+    for (const auto& [username, _] : directory_) {
+        users.push_back(username);
+    }
+    return users;
+}
+
+void ChatServer::setRemoteUsers(const std::string& node, const std::vector<std::string>& users)
+{
+    // 新旧快照中出现的用户都可能改变状态，交给 flushPresence 按最终状态判断
+    auto& current = remoteDirectory_[node];
+    for (const auto& username : current) {
+        markPresenceChanged(username);
+    }
+    current.clear();
+    for (const auto& username : users) {
+        current.insert(username);
+        markPresenceChanged(username);
+    }
+}
+
+void ChatServer::setRemoteUser(const std::string& node, const std::string& username, bool online)
+{
+    auto& users = remoteDirectory_[node];
+    bool changed = online ? users.insert(username).second : users.erase(username) > 0;
+    if (changed) {
+        markPresenceChanged(username);
+    }
+}
+
+void ChatServer::clearRemoteUsers(const std::string& node)
+{
+    auto it = remoteDirectory_.find(node);
+    if (it == remoteDirectory_.end()) {
+        return;
+    }
+    for (const auto& username : it->second) {
+        markPresenceChanged(username);
+    }
+    remoteDirectory_.erase(it);
+}
+
+bool ChatServer::isOnline(const std::string& username) const
+{
+    if (directory_.count(username) > 0) {
+        return true;
+    }
+    for (const auto& [node, users] : remoteDirectory_) {
+        if (users.count(username) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ChatServer::markPresenceChanged(const std::string& username)
+{
+    // 在 directoryStrand_ 上调用；窗口内同一用户的多次变化合并为一条
+    pendingPresence_.insert(username);
+    schedulePresenceFlush();
+}
+
+void ChatServer::schedulePresenceFlush()
+{
+    if (presenceFlushPending_) {
+        return;
+    }
+    presenceFlushPending_ = true;
+    presenceTimer_.expires_after(PRESENCE_COALESCE_WINDOW);
+    presenceTimer_.async_wait([this](const asio::error_code& ec) {
+        if (!ec) {
+            flushPresence();
+        }
+    });
+}
+
+void ChatServer::flushPresence()
+{
+    // 在 directoryStrand_ 上调用
+    presenceFlushPending_ = false;
+
+    if (!pendingPresence_.empty()) {
+        Presence::Delta delta;
+        delta.baseVersion = presenceVersion_;
+        delta.version = ++presenceVersion_;
+        delta.changes.reserve(pendingPresence_.size());
+        for (const auto& username : pendingPresence_) {
+            delta.changes.emplace_back(username, isOnline(username));
+        }
+        pendingPresence_.clear();
+
+        Message deltaMsg(Message::Type::USER_LIST_DELTA);
+        deltaMsg.setContent(Presence::encodeDelta(delta));
+        broadcastMessage(std::move(deltaMsg));
+    }
+
+    if (!pendingSnapshots_.empty()) {
+        // 同一窗口内加入的会话共享同一份快照；快照在增量之后投递，
+        // 客户端会忽略版本不超过快照的增量
+        std::vector<std::string> users = getLocalUsers();
+        for (const auto& [node, remoteUsers] : remoteDirectory_) {
+            for (const auto& username : remoteUsers) {
+                if (directory_.count(username) == 0) {
+                    users.push_back(username);
+                }
+            }
+        }
+        // 同一用户可能同时在多个其他节点在线
+        std::sort(users.begin(), users.end());
+        users.erase(std::unique(users.begin(), users.end()), users.end());
+
+        Message snapshot(Message::Type::USER_LIST);
+        snapshot.setContent(Presence::encodeSnapshot(presenceVersion_, users));
+        auto outbound = makeOutbound(std::move(snapshot));
+
+        for (const auto& session : pendingSnapshots_) {
+            asio::post(shards_[session->getShardIndex()]->io_context, [session, outbound]() {
+                session->deliver(outbound);
+            });
+        }
+        pendingSnapshots_.clear();
+    }
+}
+
+void ChatServer::recordWrite(std::size_t shardIndex, std::size_t frames, std::size_t bytes)
+{
+    auto& metrics = shards_[shardIndex]->metrics;
+    metrics.writeOps.add();
+    metrics.framesOut.add(frames);
+    metrics.bytesOut.add(bytes);
+}
+
+SendQueue::Stats ChatServer::getWriteStats() const
+{
+    auto totals = metrics_.collect();
+    SendQueue::Stats stats;
+    stats.writeOps = totals.writeOps;
+    stats.frames = totals.framesOut;
+    stats.bytes = totals.bytesOut;
+    return stats;
+}
+
+std::string ChatServer::renderMetrics() const
+{
+    std::string out;
+    metrics_.render(out);
+
+    auto compression = Compression::getStats();
+    ServerMetrics::renderCounter(out, "chat_compressed_frames_total", "Frames sent with compressed content.",
+                                 compression.compressedFrames);
+    ServerMetrics::renderCounter(out, "chat_compression_raw_bytes_total", "Content bytes before compression.",
+                                 compression.rawBytes);
+    ServerMetrics::renderCounter(out, "chat_compression_compressed_bytes_total",
+                                 "Content bytes after compression.", compression.compressedBytes);
+    ServerMetrics::renderCounter(out, "chat_inflated_frames_total", "Received frames decompressed.",
+                                 compression.inflatedFrames);
+
+    auto pool = BufferPool::getGlobalStats();
+    ServerMetrics::renderCounter(out, "chat_buffer_pool_acquires_total", "Frame buffers taken from the pool.",
+                                 pool.acquires);
+    ServerMetrics::renderCounter(out, "chat_buffer_pool_hits_total", "Frame buffers reused from the pool.",
+                                 pool.hits);
+    ServerMetrics::renderGauge(out, "chat_buffer_pool_held_bytes", "Idle buffer bytes held by the pools.",
+                               static_cast<double>(pool.heldBytes));
+
+    if (messageWriter_) {
+        auto persisted = messageWriter_->getStats();
+        ServerMetrics::renderCounter(out, "chat_persist_enqueued_total", "Messages queued for persistence.",
+                                     persisted.enqueued);
+        ServerMetrics::renderCounter(out, "chat_persist_written_total", "Messages written to the database.",
+                                     persisted.written);
+        ServerMetrics::renderCounter(out, "chat_persist_dropped_total",
+                                     "Messages dropped because the persistence queue was full.",
+                                     persisted.dropped);
+        ServerMetrics::renderCounter(out, "chat_persist_failed_batches_total",
+                                     "Persistence transactions that failed.", persisted.failedBatches);
+    }
+    if (federation_) {
+        federation_->render(out);
+    }
+    return out;
+}
+
+void ChatServer::startStatsReport()
+{
+    statsTimer_.expires_after(STATS_REPORT_INTERVAL);
+    statsTimer_.async_wait([this](const asio::error_code& ec) {
+        if (ec) return;
+
+        auto stats = getWriteStats();
+        SendQueue::Stats delta;
+        delta.writeOps = stats.writeOps - lastReportedStats_.writeOps;
+        delta.frames = stats.frames - lastReportedStats_.frames;
+        delta.bytes = stats.bytes - lastReportedStats_.bytes;
+        lastReportedStats_ = stats;
+
+        if (delta.writeOps > 0) {
+            std::cout << "写出统计: " << delta.writeOps << " 次写调用, "
+                      << delta.frames << " 帧, " << delta.bytes << " 字节, "
+                      << "平均每次 " << delta.framesPerWrite() << " 帧" << std::endl;
+        }
+
+        if (messageWriter_) {
+            auto persisted = messageWriter_->getStats();
+            std::cout << "持久化统计: 已入队 " << persisted.enqueued << ", 已写入 " << persisted.written
+                      << ", 丢弃 " << persisted.dropped << ", 事务 " << persisted.batches
+                      << " (失败 " << persisted.failedBatches << ")" << std::endl;
+        }
+
+        auto compression = Compression::getStats();
+        if (compression.compressedFrames > 0 || compression.inflatedFrames > 0) {
+            std::cout << "压缩统计: 压缩 " << compression.compressedFrames << " 帧 ("
+                      << compression.rawBytes << " -> " << compression.compressedBytes << " 字节, 压缩比 "
+                      << compression.ratio() << ", 无收益 " << compression.skippedFrames << " 帧), 耗时 "
+                      << compression.compressNanos / 1000000 << " ms; 解压 " << compression.inflatedFrames
+                      << " 帧, 耗时 " << compression.inflateNanos / 1000000 << " ms" << std::endl;
+        }
+
+        auto pool = BufferPool::getGlobalStats();
+        std::cout << "缓冲池统计: 取用 " << pool.acquires << " 次, 命中率 " << pool.hitRate() * 100
+                  << "%, 池中空闲 " << pool.heldBytes << " 字节, 峰值 " << pool.highWaterBytes
+                  << " 字节" << std::endl;
+
+        // 队列峰值超过上限一半或发生过丢帧的会话视为慢消费者
+        collectQueueStats([limits = sendQueueLimits_](std::vector<SessionQueueInfo> infos) {
+            for (const auto& info : infos) {
+                if (info.stats.droppedFrames > 0 ||
+                    info.stats.highWaterFrames > limits.maxFrames / 2 ||
+                    info.stats.highWaterBytes > limits.maxBytes / 2) {
+                    std::cout << "慢消费者: " << info.username
+                              << " 当前排队 " << info.queuedFrames << " 帧/" << info.queuedBytes << " 字节"
+                              << ", 峰值 " << info.stats.highWaterFrames << " 帧/"
+                              << info.stats.highWaterBytes << " 字节"
+                              << ", 已丢弃 " << info.stats.droppedFrames << " 帧" << std::endl;
+                }
+            }
+        });
+        startStatsReport();
+    });
+}
+
+void ChatServer::collectQueueStats(QueueInfoHandler handler)
+{
+    // 每个分片在自己的线程上读取会话状态，全部完成后汇总
+    struct Collector {
+        std::mutex mutex;
+        std::vector<SessionQueueInfo> infos;
+        std::size_t remaining;
+        QueueInfoHandler handler;
+    };
+    auto collector = std::make_shared<Collector>();
+    collector->remaining = shards_.size();
+    collector->handler = std::move(handler);
+
+    for (auto& shard : shards_) {
+        asio::post(shard->io_context, [shard = shard.get(), collector]()
+        {
+            std::vector<SessionQueueInfo> local;
+            local.reserve(shard->sessions.size());
+            for (const auto& [username, session] : shard->sessions) {
+                local.push_back({username, session->getQueuedFrames(),
+                                 session->getQueuedBytes(), session->getWriteStats()});
+            }
+
+            std::unique_lock<std::mutex> lock(collector->mutex);
+            collector->infos.insert(collector->infos.end(),
+                                    std::make_move_iterator(local.begin()),
+                                    std::make_move_iterator(local.end()));
+            if (--collector->remaining == 0) {
+                auto infos = std::move(collector->infos);
+                lock.unlock();
+                collector->handler(std::move(infos));
+            }
+        });
+    }
+}
@@ -1,26 +1,216 @@
 #pragma once
 #include <asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
 #include <string>
+#include <vector>
 #include "message.hpp"
+#include "message_view.hpp"
+#include "outbound_message.hpp"
+#include "io_context_pool.hpp"
+#include "send_queue.hpp"
+#include "heartbeat_wheel.hpp"
+#include "history_cache.hpp"
+#include "federation.hpp"
+#include "file_store.hpp"
+#include "rate_limiter.hpp"
+#include "server_metrics.hpp"
+#include "string_hash.hpp"
+#include "../database/message_writer.hpp"
 
 class ChatSession;
 
 class ChatServer {
 public:
-    explicit ChatServer(asio::io_context& io_context, uint16_t port);
+    // 单个会话发送队列的状态，用于找出跟不上的慢消费者
+    struct SessionQueueInfo {
+        std::string username;
+        std::size_t queuedFrames;
+        std::size_t queuedBytes;
+        SendQueue::Stats stats;
+    };
+    using QueueInfoHandler = std::function<void(std::vector<SessionQueueInfo>)>;
+
+    static constexpr SendQueue::QueueLimits DEFAULT_SEND_QUEUE_LIMITS{
+        4096, 8 * 1024 * 1024, SendQueue::OverflowPolicy::DropNonCritical};
+
+    explicit ChatServer(IoContextPool& pool, uint16_t port);
 
     void start();
-    void broadcastMessage(const Message& msg, std::shared_ptr<ChatSession> sender = nullptr);
+    // 实际监听的端口；构造时传入 0 则由系统分配
+    uint16_t getPort() const { return acceptor_.local_endpoint().port(); }
+    // 广播前由服务器打上序号和时间戳
+    void broadcastMessage(Message msg, std::shared_ptr<ChatSession> sender = nullptr);
+    // 转发客户端发来的 TEXT/ROOM_TEXT 帧：按 ROOM_TEXT 的 target 或全局广播。
+    // 未压缩的帧只复制原始字节，不构造 Message。在会话所属线程上、帧回调期间调用
+    void relayMessage(const MessageView& msg, std::shared_ptr<ChatSession> sender);
+    // 私聊：按 target 查在线用户目录，只投递给接收方的会话和发送方的其他会话；
+    // 接收方不在线时存入离线信箱，下次登录时投递。在会话所属线程上、帧回调期间调用
+    void sendPrivate(const MessageView& msg, std::shared_ptr<ChatSession> sender);
     void removeSession(std::shared_ptr<ChatSession> session);
     void addSession(std::shared_ptr<ChatSession> session);
+    void sendUserList(std::shared_ptr<ChatSession> session);
+
+    // 房间：每个分片维护本分片会话的房间订阅索引，房间消息只遍历房间成员。
+    // 以下方法在会话所属线程上调用
+    void joinRoom(std::shared_ptr<ChatSession> session, const std::string& room);
+    void leaveRoom(std::shared_ptr<ChatSession> session, const std::string& room);
+    void broadcastToRoom(const std::string& room, Message msg,
+                         std::shared_ptr<ChatSession> sender = nullptr);
+
+    // 历史消息：count 不超过内存缓存容量时直接重放缓存帧，否则从数据库读取。
+    // 在会话所属线程上调用
+    void requestHistory(std::shared_ptr<ChatSession> session, const std::string& room, std::size_t count);
+
+    // 把会话交给所属分片的心跳时间轮监督，在会话所属线程上调用
+    void watchHeartbeat(const std::shared_ptr<ChatSession>& session);
+
+    // 设置后所有广播的 TEXT 消息交给后写式持久化线程保存，需在 start 之前设置
+    void setMessageWriter(AsyncMessageWriter* writer);
+
+    // 上传的文件保存在 store 中，需在 start 之前设置；未设置时拒绝所有文件传输
+    void setFileStore(FileStore* store) { fileStore_ = store; }
+    FileStore* getFileStore() const { return fileStore_; }
+    // 上传完成后通知接收方（未指定接收方时通知所有人）有可下载的文件，在会话所属线程上调用
+    void announceFile(const FileStore::StoredFile& file, std::shared_ptr<ChatSession> sender);
+
+    // 批量写配置需在 start 之前设置
+    void setWriteBatchLimits(const SendQueue::BatchLimits& limits) { writeBatchLimits_ = limits; }
+    const SendQueue::BatchLimits& getWriteBatchLimits() const { return writeBatchLimits_; }
+    void setSendQueueLimits(const SendQueue::QueueLimits& limits) { sendQueueLimits_ = limits; }
+    const SendQueue::QueueLimits& getSendQueueLimits() const { return sendQueueLimits_; }
+
+    // 转发前按连接和按 IP 地址限速，需在 start 之前设置
+    void setRateLimits(const RateLimitConfig& limits);
+    const RateLimitConfig& getRateLimits() const { return rateLimits_; }
+    // 新连接的限速器，可在任意线程调用
+    RateLimiter createRateLimiter(const asio::ip::tcp::socket& socket);
+
+    // 异步收集所有会话的发送队列状态，handler 在最后一个完成收集的分片线程上调用
+    void collectQueueStats(QueueInfoHandler handler);
+
+    // 由会话在所属线程上记录写操作；getWriteStats 可在任意线程调用
+    void recordWrite(std::size_t shardIndex, std::size_t frames, std::size_t bytes);
+    SendQueue::Stats getWriteStats() const;
+
+    // 与其他节点组成联邦，需在 start 之前调用
+    void enableFederation(const FederationConfig& config);
+
+    // 以下由联邦在目录 strand 上调用：
+    // 投递其他节点转发来的聊天消息（重新分配本地序号，只投递给本地会话）
+    void deliverFederated(Message msg);
+    std::vector<std::string> getLocalUsers() const;
+    // 其他节点的本地在线用户，与本节点的用户合并成集群的在线用户列表
+    void setRemoteUsers(const std::string& node, const std::vector<std::string>& users);
+    void setRemoteUser(const std::string& node, const std::string& username, bool online);
+    void clearRemoteUsers(const std::string& node);
+
+    // 分片的指标只能在该分片的线程上写入
+    ServerMetrics::Local& getMetrics(std::size_t shardIndex) { return metrics_.local(shardIndex); }
+    // 全部指标的 Prometheus 文本，可在任意线程调用
+    std::string renderMetrics() const;
 
 private:
+    // 1 秒粒度，32 个槽覆盖 15 秒的心跳超时绰绰有余
+    static constexpr auto HEARTBEAT_WHEEL_TICK = std::chrono::seconds(1);
+    static constexpr std::size_t HEARTBEAT_WHEEL_SLOTS = 32;
+
+    // 每个事件循环一个分片，分片内的会话表只在该循环的线程上访问，无需加锁
+    struct Shard {
+        Shard(asio::io_context& ctx, ServerMetrics::Local& metrics)
+            : io_context(ctx)
+            , heartbeatWheel(ctx, HEARTBEAT_WHEEL_TICK, HEARTBEAT_WHEEL_SLOTS)
+            , metrics(metrics)
+        {
+        }
+
+        asio::io_context& io_context;
+        // 同一用户可以同时有多个会话（多个设备登录）
+        std::unordered_multimap<std::string, std::shared_ptr<ChatSession>, StringHash, std::equal_to<>> sessions;
+        std::unordered_map<std::string, std::vector<std::shared_ptr<ChatSession>>, StringHash, std::equal_to<>> rooms;
+        HeartbeatWheel heartbeatWheel;
+        ServerMetrics::Local& metrics;
+    };
+
     void doAccept();
-    void updateUserList();
+    // 服务器时间戳（Unix 毫秒，不回退）；只有聊天消息（包括私聊）分配序号，其他类型为 0
+    uint64_t nextTimestamp();
+    uint64_t nextSequence(Message::Type type);
+    // 打上序号和时间戳，聊天消息同时交给持久化线程并写入历史缓存
+    SharedOutbound publish(Message msg, const MessageView* received = nullptr);
+    // 转发客户端发来的帧：未压缩的帧只复制原始字节，不构造 Message；解压失败时返回空
+    SharedOutbound publish(const MessageView& received);
+    void retain(const SharedOutbound& msg);
+    void fanOut(const SharedOutbound& msg, const std::shared_ptr<ChatSession>& sender);
+    // 房间为消息的 target
+    void fanOutToRoom(const SharedOutbound& msg, const std::shared_ptr<ChatSession>& sender);
+    void replayHistory(const std::shared_ptr<ChatSession>& session, const std::string& room,
+                       std::size_t count);
+    static void deliverHistory(const std::shared_ptr<ChatSession>& session, const std::string& room,
+                               const std::vector<SharedOutbound>& frames);
+    // 以下在目录 strand 上调用
+    void routePrivate(const SharedOutbound& msg, const std::shared_ptr<ChatSession>& sender, bool fromPeer);
+    void storeOffline(const SharedOutbound& msg, const std::shared_ptr<ChatSession>& sender);
+    void deliverOffline(const std::string& username, const std::shared_ptr<ChatSession>& session);
+    void markPresenceChanged(const std::string& username);
+    void schedulePresenceFlush();
+    void flushPresence();
+    // 用户在本节点或任一其他节点在线
+    bool isOnline(const std::string& username) const;
+    void unsubscribe(Shard& shard, const std::shared_ptr<ChatSession>& session, const std::string& room);
+    void startStatsReport();
 
-    asio::io_context& io_context_;
+    IoContextPool& pool_;
     asio::ip::tcp::acceptor acceptor_;
-    std::unordered_map<std::string, std::shared_ptr<ChatSession>> sessions_;
-}; 
\ No newline at end of file
+    ServerMetrics metrics_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    SendQueue::BatchLimits writeBatchLimits_;
+    AsyncMessageWriter* messageWriter_{nullptr};
+    FileStore* fileStore_{nullptr};
+
+    // 聊天消息的全局序号和服务器时间戳（Unix 毫秒，保证不回退），任意线程上分配
+    std::atomic<uint64_t> nextSequence_{1};
+    std::atomic<uint64_t> lastTimestamp_{0};
+
+    // 各房间最近消息的已编码帧，加入时重放
+    static constexpr std::size_t HISTORY_CACHE_SIZE = 50;
+    static constexpr std::size_t MAX_HISTORY_REQUEST = 1000;
+    HistoryCache history_{HISTORY_CACHE_SIZE};
+    SendQueue::QueueLimits sendQueueLimits_{DEFAULT_SEND_QUEUE_LIMITS};
+    RateLimitConfig rateLimits_;
+    std::unique_ptr<AddressLimiterTable> addressLimiters_;
+
+    // 定期输出写合并效果（每次系统调用平均写出的帧数）和慢消费者
+    asio::steady_timer statsTimer_;
+    SendQueue::Stats lastReportedStats_;
+    static constexpr auto STATS_REPORT_INTERVAL = std::chrono::seconds(60);
+
+    // 全局在线用户目录，只在 directoryStrand_ 上访问。
+    // 上下线变化在合并窗口内累积，到期后以一条带版本号的增量广播
+    struct DirectoryEntry {
+        std::size_t sessions{0};
+        std::vector<uint32_t> shardSessions;  // 每个分片上的会话数，私聊只投递到有会话的分片
+    };
+    asio::strand<asio::io_context::executor_type> directoryStrand_;
+    std::unordered_map<std::string, DirectoryEntry, StringHash, std::equal_to<>> directory_;
+    std::unordered_map<std::string, std::unordered_set<std::string, StringHash, std::equal_to<>>> remoteDirectory_;  // 节点 -> 用户
+    asio::steady_timer presenceTimer_;
+    std::unordered_set<std::string> pendingPresence_;
+    std::unordered_set<std::shared_ptr<ChatSession>> pendingSnapshots_;  // 同一会话在一个窗口内只收到一份
+    uint64_t presenceVersion_{0};
+    bool presenceFlushPending_{false};
+    static constexpr auto PRESENCE_COALESCE_WINDOW = std::chrono::milliseconds(100);
+
+    // 离线信箱只保存在内存中，只在 directoryStrand_ 上访问；每个用户和总数都有上限
+    std::unordered_map<std::string, std::deque<SharedOutbound>> offlineMessages_;
+    std::size_t offlineCount_{0};
+    static constexpr std::size_t OFFLINE_MAILBOX_SIZE = 100;
+    static constexpr std::size_t MAX_OFFLINE_MESSAGES = 100000;
+
+    std::unique_ptr<Federation> federation_;
+};
@@ -1,105 +1,710 @@
 #include "chat_session.hpp"
 #include "chat_server.hpp"
+#include "compression.hpp"
+#include "presence.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
 #include <iostream>
+#ifdef __linux__
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/sendfile.h>
+#endif
 
-ChatSession::ChatSession(asio::ip::tcp::socket socket, ChatServer& server)
+namespace {
+
+// 心跳回复没有可变字段，每个协议版本只编码一次
+const SharedFrame& heartbeatFrame(uint8_t version)
+{
+    static const SharedFrame frames[] = {
+        Message(Message::Type::HEARTBEAT).encodeShared(1),
+        Message(Message::Type::HEARTBEAT).encodeShared(2),
+    };
+    return frames[version >= 2 ? 1 : 0];
+}
+
+} // namespace
+
+ChatSession::ChatSession(asio::ip::tcp::socket socket, ChatServer& server, std::size_t shardIndex)
     : socket_(std::move(socket))
     , server_(server)
+    , shardIndex_(shardIndex)
+    , metrics_(server.getMetrics(shardIndex))
+    , writeSignal_(socket_.get_executor(), std::chrono::steady_clock::time_point::max())
     , isFirstMessage_(true)
-    , heartbeatTimer_(socket_.get_executor())
 {
-    readBuffer_.resize(1024);
     lastHeartbeat_ = std::chrono::steady_clock::now();
-    startHeartbeatCheck();
+    writeMessages_.setBatchLimits(server_.getWriteBatchLimits());
+    writeMessages_.setQueueLimits(server_.getSendQueueLimits());
 }
 
 void ChatSession::start()
 {
-    doRead();
+    metrics_.connectionsOpened.add();
+    rateLimiter_ = server_.createRateLimiter(socket_);
+    dropOverLimit_ = server_.getRateLimits().action == RateLimitConfig::Action::Drop;
+    // 心跳超时由所属事件循环的时间轮统一检查，不再为每个会话创建定时器
+    server_.watchHeartbeat(shared_from_this());
+
+    // 读、写各一个长期运行的协程，各自持有一份会话引用直到结束；
+    // 单个 I/O 操作不再捕获 shared_ptr
+    auto self = shared_from_this();
+    asio::co_spawn(socket_.get_executor(), [self]() { return self->readLoop(); }, asio::detached);
+    asio::co_spawn(socket_.get_executor(), [self]() { return self->writeLoop(); }, asio::detached);
+}
+
+void ChatSession::close()
+{
+    // 读写错误和心跳超时都会走到这里，保证只从服务器移除一次
+    if (closed_) return;
+    closed_ = true;
+
+    asio::error_code ec;
+    socket_.close(ec);
+    writeSignal_.cancel();
+    if (resumeTimer_) {
+        resumeTimer_->cancel();
+    }
+    updateQueueMetrics();
+
+    // close 可能在服务器遍历会话表或房间成员时被调用（例如发送队列超限），
+    // 推迟到下一轮再从服务器移除，避免迭代器失效
+    asio::post(socket_.get_executor(), [this, self = shared_from_this()]() {
+        closeTransfers();
+        server_.removeSession(self);
+    });
 }
 
 void ChatSession::deliver(const Message& msg)
 {
-    auto encoded = msg.encode();
-    bool writeInProgress = !writeMessages_.empty();
-    writeMessages_.push_back(encoded);
-    
-    if (!writeInProgress) {
-        doWrite();
+    deliver(msg.encodeShared(format_.version), msg.getType());
+}
+
+void ChatSession::deliver(SharedFrame frame, Message::Type type)
+{
+    if (closed_) return;
+
+    if (!writeMessages_.push(std::move(frame), type)) {
+        // 发送队列超限且策略要求断开：慢消费者不能拖垮服务器内存
+        std::cout << "发送队列超限，断开慢速客户端: " << username_ << std::endl;
+        metrics_.overflowDisconnects.add();
+        close();
+        return;
     }
+    updateQueueMetrics();
+    wakeWriter();
 }
 
-void ChatSession::doRead()
+void ChatSession::wakeWriter()
 {
-    auto self(shared_from_this());
-    socket_.async_read_some(
-        asio::buffer(readBuffer_),
-        [this, self](const asio::error_code& ec, std::size_t length)
-        {
-            if (!ec) {
-                if (auto msg = Message::decode({readBuffer_.begin(), 
-                                              readBuffer_.begin() + length})) {
-                    handleMessage(*msg);
-                }
-                doRead();
-            } else {
-                server_.removeSession(shared_from_this());
-            }
-        });
+    if (writerWaiting_) {
+        // 唤醒空闲的写协程；它在下一轮把这期间入队的帧合并写出
+        writerWaiting_ = false;
+        writeSignal_.cancel();
+    }
 }
 
-void ChatSession::doWrite()
+void ChatSession::deliver(const SharedOutbound& msg)
 {
-    auto self(shared_from_this());
-    asio::async_write(
-        socket_,
-        asio::buffer(writeMessages_.front()),
-        [this, self](const asio::error_code& ec, std::size_t)
-        {
-            if (!ec) {
-                writeMessages_.pop_front();
-                if (!writeMessages_.empty()) {
-                    doWrite();
-                }
-            } else {
-                server_.removeSession(shared_from_this());
-            }
-        });
+    deliver(msg->frame(format_), msg->getType());
 }
 
-void ChatSession::startHeartbeatCheck()
+asio::awaitable<void> ChatSession::readLoop()
 {
-    heartbeatTimer_.expires_after(HEARTBEAT_TIMEOUT);
-    heartbeatTimer_.async_wait([this, self = shared_from_this()](const asio::error_code& ec) {
-        if (!ec) {
-            auto now = std::chrono::steady_clock::now();
-            if (now - lastHeartbeat_ > HEARTBEAT_TIMEOUT) {
-                // 心跳超时，断开连接
-                socket_.close();
-                server_.removeSession(shared_from_this());
-            } else {
-                startHeartbeatCheck();
+    asio::error_code ec;
+    while (!closed_) {
+        std::size_t length = co_await socket_.async_read_some(decoder_.prepare(),
+            withMemory(readMemory_, asio::redirect_error(asio::use_awaitable, ec)));
+        if (ec) {
+            close();
+            co_return;
+        }
+        metrics_.bytesIn.add(length);
+        processFrames(length);
+
+        // 暂停期间不读 socket，接收窗口填满后发送方被 TCP 流量控制挡住；
+        // 恢复后先处理解码器里剩下的帧，可能再次暂停
+        while (readPaused_ && !closed_) {
+            if (!resumeTimer_) {
+                resumeTimer_ = std::make_unique<asio::steady_timer>(socket_.get_executor());
             }
+            resumeTimer_->expires_at(resumeAt_);
+            co_await resumeTimer_->async_wait(
+                withMemory(readMemory_, asio::redirect_error(asio::use_awaitable, ec)));
+            if (ec) {
+                co_return;
+            }
+            readPaused_ = false;
+            processFrames(0);
+        }
+    }
+}
+
+void ChatSession::processFrames(std::size_t length)
+{
+    // 一次读取可能包含多个帧，也可能只有半个帧；限速暂停时剩下的帧留在解码器里
+    bool ok = decoder_.commit(length, [this](const uint8_t* data, std::size_t size) {
+        metrics_.framesIn.add();
+        MessageView msg;
+        if (msg.parse({data, size})) {
+            handleMessage(msg);
+        } else {
+            metrics_.decodeFailures.add();
         }
+        return !closed_ && !readPaused_;
     });
+    if (!ok) {
+        metrics_.decodeFailures.add();
+        close();
+    }
+}
+
+asio::awaitable<void> ChatSession::writeLoop()
+{
+    // 队列中所有待发帧合并为一次 gather 写；写的过程中新入队的帧在下一批发出。
+    // 队列空时发下一块下载的文件数据，没有下载时等待 deliver 取消 writeSignal_
+    asio::error_code ec;
+    while (!closed_) {
+        if (writeMessages_.empty()) {
+            while (!downloads_.empty() && downloads_.front().cancelled) {
+                downloads_.pop_front();
+                metrics_.fileTransfersAborted.add();
+                metrics_.activeFileTransfers.add(-1);
+            }
+            if (!downloads_.empty()) {
+                co_await sendFileChunk(ec);
+                if (ec) {
+                    close();
+                    co_return;
+                }
+                continue;
+            }
+            writerWaiting_ = true;
+            co_await writeSignal_.async_wait(
+                withMemory(writeMemory_, asio::redirect_error(asio::use_awaitable, ec)));
+            writerWaiting_ = false;
+            continue;
+        }
+
+        std::size_t length = co_await socket_.async_write_some(writeMessages_.prepareBatch(),
+            withMemory(writeMemory_, asio::redirect_error(asio::use_awaitable, ec)));
+        if (ec) {
+            close();
+            co_return;
+        }
+        std::size_t frames = writeMessages_.consume(length);
+        server_.recordWrite(shardIndex_, frames, length);
+        updateQueueMetrics();
+    }
 }
 
-void ChatSession::handleMessage(const Message& msg)
+bool ChatSession::addRoom(const std::string& room)
 {
+    if (room.empty() || room.size() > MAX_ROOM_NAME_LENGTH || rooms_.size() >= MAX_ROOMS_PER_SESSION) {
+        return false;
+    }
+    if (std::find(rooms_.begin(), rooms_.end(), room) != rooms_.end()) {
+        return false;
+    }
+    rooms_.push_back(room);
+    return true;
+}
+
+bool ChatSession::removeRoom(const std::string& room)
+{
+    auto it = std::find(rooms_.begin(), rooms_.end(), room);
+    if (it == rooms_.end()) {
+        return false;
+    }
+    rooms_.erase(it);
+    return true;
+}
+
+void ChatSession::onHeartbeatTimeout()
+{
+    // 心跳超时，断开连接
+    metrics_.heartbeatTimeouts.add();
+    close();
+}
+
+void ChatSession::updateQueueMetrics()
+{
+    // 只上报与上次的差值，各会话差值之和就是当前的排队总量；关闭后队列不再计入
+    std::size_t frames = closed_ ? 0 : writeMessages_.size();
+    std::size_t bytes = closed_ ? 0 : writeMessages_.bytes();
+    uint64_t dropped = writeMessages_.getStats().droppedFrames;
+
+    metrics_.queuedFrames.add(static_cast<int64_t>(frames) - static_cast<int64_t>(reportedFrames_));
+    metrics_.queuedBytes.add(static_cast<int64_t>(bytes) - static_cast<int64_t>(reportedBytes_));
+    metrics_.droppedFrames.add(dropped - reportedDropped_);
+    reportedFrames_ = frames;
+    reportedBytes_ = bytes;
+    reportedDropped_ = dropped;
+}
+
+void ChatSession::handleCapabilities(std::string_view offered)
+{
+    // 回复双方都支持的能力，之后发给本会话的帧（包括这条回复）使用协商的格式；
+    // 没有提出 v2 的旧客户端始终只收到 v1 帧
+    format_.compression = Message::hasCapability(offered, Compression::CAPABILITY);
+    format_.version = Message::hasCapability(offered, Message::V2_CAPABILITY) ? 2 : 1;
+
+    std::string accepted;
+    if (format_.compression) {
+        accepted = Compression::CAPABILITY;
+    }
+    if (format_.version == 2) {
+        accepted += accepted.empty() ? "" : ",";
+        accepted += Message::V2_CAPABILITY;
+    }
+
+    Message reply(Message::Type::CAPABILITIES);
+    reply.setContent(accepted);
+    deliver(reply);
+}
+
+void ChatSession::handleHeartbeat(const MessageView& msg)
+{
+    HeartbeatProbe::Origin origin;
+    uint64_t sentMicros = 0;
+    if (!HeartbeatProbe::parse(msg.getContent(), origin, sentMicros)) {
+        // 旧客户端的空心跳，回复预先编码好的心跳帧
+        deliver(heartbeatFrame(format_.version), Message::Type::HEARTBEAT);
+        return;
+    }
+
+    if (origin == HeartbeatProbe::Origin::Client) {
+        // 原样回显客户端的探测，再附带一个服务器探测；只有支持探测的客户端才会收到服务器探测
+        Message echo(Message::Type::HEARTBEAT);
+        echo.setContent(std::string(msg.getContent()));
+        deliver(echo);
+
+        Message probe(Message::Type::HEARTBEAT);
+        probe.setContent(HeartbeatProbe::encode(HeartbeatProbe::Origin::Server, HeartbeatProbe::nowMicros()));
+        deliver(probe);
+        return;
+    }
+
+    // 客户端回显的服务器探测；时间戳由对端带回，不可信，超出合理范围的丢弃
+    uint64_t nowMicros = HeartbeatProbe::nowMicros();
+    if (sentMicros > nowMicros) {
+        return;
+    }
+    std::chrono::microseconds rtt(nowMicros - sentMicros);
+    if (rtt > MAX_PROBE_AGE) {
+        return;
+    }
+    rtt_.addSample(rtt);
+    metrics_.heartbeatRtt.record(rtt);
+}
+
+bool ChatSession::admit(const MessageView& msg)
+{
+    if (!rateLimiter_.enabled()) {
+        return true;
+    }
+
+    // lastHeartbeat_ 刚在 handleMessage 中取过当前时间，直接复用
+    int64_t nowNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        lastHeartbeat_.time_since_epoch()).count();
+    std::size_t bytes = msg.getFrame().size();
+    int64_t wait = rateLimiter_.admit(bytes, nowNanos, !dropOverLimit_);
+    if (wait == 0) {
+        dropNoticeSent_ = false;
+        return true;
+    }
+
+    if (!dropOverLimit_) {
+        // 这条消息照常转发，之后暂停读取直到欠下的令牌补回；
+        // 暂停是服务器造成的，心跳期限顺延到恢复读取时
+        metrics_.rateLimitDelays.add();
+        readPaused_ = true;
+        resumeAt_ = lastHeartbeat_ + std::chrono::nanoseconds(wait);
+        lastHeartbeat_ = resumeAt_;
+        return true;
+    }
+
+    metrics_.rateLimitDroppedFrames.add();
+    metrics_.rateLimitDroppedBytes.add(bytes);
+    if (!dropNoticeSent_) {
+        dropNoticeSent_ = true;
+        Message notice(Message::Type::TEXT);
+        notice.setSender("系统");
+        notice.setContent("发送过快，部分消息已被丢弃");
+        deliver(notice);
+    }
+    return false;
+}
+
+void ChatSession::handleMessage(const MessageView& msg)
+{
+    // 只查看字段，不构造 Message；需要转发的帧交给服务器复用原始字节
     lastHeartbeat_ = std::chrono::steady_clock::now();
     
+    // 心跳同样计入限速：每个探测都要服务器回显并再发一个探测。超限丢弃时只是不回复，
+    // 收到心跳本身已经刷新了存活时间
     if (msg.getType() == Message::Type::HEARTBEAT) {
-        // 收到心跳消息，回复心跳
-        Message heartbeat(Message::Type::HEARTBEAT);
-        deliver(heartbeat);
+        if (admit(msg)) {
+            handleHeartbeat(msg);
+        }
+        return;
+    }
+    
+    // 能力协商在登录之前进行
+    if (msg.getType() == Message::Type::CAPABILITIES) {
+        handleCapabilities(msg.getContent());
         return;
     }
     
     if (isFirstMessage_) {
+        // 不带用户名的连接不进入在线列表；非法用户名会破坏在线列表的编码，直接断开
+        if (!msg.getSender().empty() && !Presence::isValidUsername(msg.getSender())) {
+            metrics_.decodeFailures.add();
+            close();
+            return;
+        }
         username_ = msg.getSender();
         isFirstMessage_ = false;
         server_.addSession(shared_from_this());
+        return;
+    }
+    
+    // 快照、房间通知和历史查询都由服务器替客户端做工作，与聊天消息计入同一个限速
+    switch (msg.getType()) {
+    case Message::Type::USER_LIST:
+        if (admit(msg)) {
+            server_.sendUserList(shared_from_this());
+        }
+        break;
+    case Message::Type::JOIN_ROOM:
+        if (admit(msg)) {
+            server_.joinRoom(shared_from_this(), std::string(msg.getTarget()));
+        }
+        break;
+    case Message::Type::LEAVE_ROOM:
+        if (admit(msg)) {
+            server_.leaveRoom(shared_from_this(), std::string(msg.getTarget()));
+        }
+        break;
+    case Message::Type::HISTORY_REQUEST: {
+        if (!admit(msg)) {
+            break;
+        }
+        std::string_view content = msg.getContent();
+        std::size_t count = 0;
+        auto result = std::from_chars(content.data(), content.data() + content.size(), count);
+        if (result.ec == std::errc()) {
+            server_.requestHistory(shared_from_this(), std::string(msg.getTarget()), count);
+        }
+        break;
+    }
+    case Message::Type::FILE_BEGIN:
+    case Message::Type::FILE_CHUNK:
+    case Message::Type::FILE_CREDIT:
+    case Message::Type::FILE_END:
+    case Message::Type::FILE_ABORT:
+    case Message::Type::FILE_AVAILABLE:
+    case Message::Type::FILE_REQUEST:
+        // 文件数据不计入聊天消息的限速，上传由额度窗口控制速度
+        handleFileMessage(msg);
+        break;
+    case Message::Type::PRIVATE:
+        if (admit(msg)) {
+            server_.sendPrivate(msg, shared_from_this());
+        }
+        break;
+    case Message::Type::TEXT:
+    case Message::Type::ROOM_TEXT:
+        // 与私聊一样，发送方必须是会话本人；只有房间成员才能向房间发消息
+        if (msg.getSender() != username_) {
+            metrics_.decodeFailures.add();
+        } else if ((msg.getType() == Message::Type::TEXT ||
+                    std::find(rooms_.begin(), rooms_.end(), msg.getTarget()) != rooms_.end()) &&
+                   admit(msg)) {
+            server_.relayMessage(msg, shared_from_this());
+        }
+        break;
+    default:
+        // 其余类型（JOIN/LEAVE、历史标记、在线列表增量、联邦链路消息和未知类型）
+        // 只由服务器发出，客户端发来的一律丢弃，不转发
+        metrics_.decodeFailures.add();
+        break;
+    }
+}
+
+void ChatSession::handleFileMessage(const MessageView& msg)
+{
+    switch (msg.getType()) {
+    case Message::Type::FILE_BEGIN:
+        beginUpload(msg);
+        break;
+    case Message::Type::FILE_CHUNK:
+        receiveChunk(msg);
+        break;
+    case Message::Type::FILE_END:
+        finishUpload(std::string(msg.getTarget()));
+        break;
+    case Message::Type::FILE_REQUEST:
+        beginDownload(std::string(msg.getTarget()));
+        break;
+    case Message::Type::FILE_ABORT: {
+        // 客户端取消上传（传输编号）或下载（文件编号）
+        std::string id(msg.getTarget());
+        auto upload = uploads_.find(id);
+        if (upload != uploads_.end()) {
+            uploads_.erase(upload);
+            metrics_.fileTransfersAborted.add();
+            metrics_.activeFileTransfers.add(-1);
+        }
+        for (auto& download : downloads_) {
+            if (download.source->getFile().id == id) {
+                download.cancelled = true;
+            }
+        }
+        break;
+    }
+    default:
+        // FILE_CREDIT 和 FILE_AVAILABLE 只由服务器发出
+        break;
+    }
+}
+
+void ChatSession::beginUpload(const MessageView& msg)
+{
+    // content 为 "<传输编号>\n<字节数>\n<文件名>"
+    std::string_view content = msg.getContent();
+    auto first = content.find('\n');
+    auto second = first == std::string_view::npos ? first : content.find('\n', first + 1);
+    if (msg.isCompressed() || second == std::string_view::npos) {
+        metrics_.decodeFailures.add();
+        return;
+    }
+    std::string transferId(content.substr(0, first));
+    std::string_view sizeText = content.substr(first + 1, second - first - 1);
+    uint64_t size = 0;
+    auto result = std::from_chars(sizeText.data(), sizeText.data() + sizeText.size(), size);
+    if (transferId.empty() || transferId.size() > MAX_TRANSFER_ID_LENGTH ||
+        result.ec != std::errc() || result.ptr != sizeText.data() + sizeText.size()) {
+        metrics_.decodeFailures.add();
+        return;
+    }
+
+    FileStore* store = server_.getFileStore();
+    std::string reason;
+    std::unique_ptr<FileStore::Upload> file;
+    if (!store) {
+        reason = "disabled";
+    } else if (uploads_.size() >= MAX_UPLOADS_PER_SESSION || uploads_.count(transferId) > 0) {
+        reason = "busy";
     } else {
-        server_.broadcastMessage(msg, shared_from_this());
+        file = store->beginUpload(username_, std::string(msg.getTarget()), content.substr(second + 1), size, reason);
+    }
+    if (!file) {
+        Message abort(Message::Type::FILE_ABORT);
+        abort.setTarget(transferId);
+        abort.setContent(reason);
+        deliver(abort);
+        return;
+    }
+
+    Upload& upload = uploads_[transferId];
+    upload.file = std::move(file);
+    upload.recipient = std::string(msg.getTarget());
+    upload.granted = UPLOAD_WINDOW;
+    metrics_.activeFileTransfers.add(1);
+
+    Message credit(Message::Type::FILE_CREDIT);
+    credit.setTarget(transferId);
+    credit.setContent(std::to_string(upload.granted));
+    deliver(credit);
+}
+
+void ChatSession::receiveChunk(const MessageView& msg)
+{
+    std::string transferId(msg.getTarget());
+    auto it = uploads_.find(transferId);
+    if (it == uploads_.end()) {
+        // 已失败或已取消的上传，客户端收到 FILE_ABORT 之前发出的块直接丢弃
+        return;
+    }
+
+    // 块直接从读缓冲区写入文件，不在内存中累积；超出额度说明客户端没有遵守流量控制
+    Upload& upload = it->second;
+    std::string_view data = msg.getContent();
+    uint64_t received = upload.file->getReceived();
+    if (msg.isCompressed() || data.size() > upload.granted - received) {
+        abortTransfer(transferId, "protocol");
+        return;
     }
-} 
\ No newline at end of file
+    if (!upload.file->write(data.data(), data.size())) {
+        abortTransfer(transferId, data.size() > upload.file->getSize() - received ? "too-long" : "io-error");
+        return;
+    }
+    metrics_.fileBytesIn.add(data.size());
+
+    // 窗口用掉一半时补发额度，客户端不必等待每一块的确认
+    received = upload.file->getReceived();
+    if (upload.granted < upload.file->getSize() && upload.granted - received <= UPLOAD_WINDOW / 2) {
+        upload.granted = received + UPLOAD_WINDOW;
+        Message credit(Message::Type::FILE_CREDIT);
+        credit.setTarget(transferId);
+        credit.setContent(std::to_string(upload.granted));
+        deliver(credit);
+    }
+}
+
+void ChatSession::finishUpload(const std::string& transferId)
+{
+    auto it = uploads_.find(transferId);
+    if (it == uploads_.end()) {
+        return;
+    }
+    bool complete = it->second.file->getReceived() == it->second.file->getSize();
+    auto stored = complete ? it->second.file->finish() : std::nullopt;
+    if (!stored) {
+        abortTransfer(transferId, complete ? "io-error" : "incomplete");
+        return;
+    }
+    uploads_.erase(it);
+    metrics_.activeFileTransfers.add(-1);
+    metrics_.filesStored.add();
+
+    Message done(Message::Type::FILE_END);
+    done.setTarget(transferId);
+    done.setContent(stored->id);
+    deliver(done);
+    server_.announceFile(*stored, shared_from_this());
+}
+
+void ChatSession::beginDownload(const std::string& fileId)
+{
+    FileStore* store = server_.getFileStore();
+    std::string reason;
+    std::unique_ptr<FileStore::Source> source;
+    if (!store) {
+        reason = "disabled";
+    } else if (downloads_.size() >= MAX_DOWNLOADS_PER_SESSION) {
+        reason = "busy";
+    } else {
+        source = store->open(fileId, username_, reason);
+    }
+    if (!source) {
+        Message abort(Message::Type::FILE_ABORT);
+        abort.setTarget(fileId);
+        abort.setContent(reason);
+        deliver(abort);
+        return;
+    }
+
+    // FILE_BEGIN 经发送队列发出，写协程在队列清空后才开始发文件数据，所以它总在第一块之前
+    const auto& file = source->getFile();
+    Message begin(Message::Type::FILE_BEGIN);
+    begin.setTarget(file.id);
+    begin.setContent(file.id + "\n" + std::to_string(file.size) + "\n" + file.name);
+    downloads_.push_back(Download{std::move(source)});
+    metrics_.activeFileTransfers.add(1);
+    deliver(begin);
+}
+
+void ChatSession::abortTransfer(const std::string& id, std::string_view reason)
+{
+    if (uploads_.erase(id) > 0) {
+        metrics_.fileTransfersAborted.add();
+        metrics_.activeFileTransfers.add(-1);
+    }
+    Message abort(Message::Type::FILE_ABORT);
+    abort.setTarget(id);
+    abort.setContent(std::string(reason));
+    deliver(abort);
+}
+
+asio::awaitable<void> ChatSession::sendFileChunk(asio::error_code& ec)
+{
+    Download& download = downloads_.front();
+    FileStore::Source& source = *download.source;
+    const auto& file = source.getFile();
+    std::size_t length = static_cast<std::size_t>(
+        std::min<uint64_t>(DOWNLOAD_CHUNK_SIZE, file.size - download.offset));
+
+    if (length > 0) {
+        Message chunk(Message::Type::FILE_CHUNK);
+        chunk.setTarget(file.id);
+        std::vector<uint8_t> frame = chunk.encodeHeader(length, format_.version);
+        std::size_t headerSize = frame.size();
+#ifdef __linux__
+        // 帧头带 MSG_MORE 发出，与随后 sendfile 的内容合并成满长度的 TCP 段；
+        // sendfile 需要非阻塞 socket，写满时等 socket 可写再继续
+        if (!socket_.native_non_blocking()) {
+            socket_.native_non_blocking(true, ec);
+            if (ec) {
+                co_return;
+            }
+            // 内核里未发出的数据不超过一块，之后入队的聊天帧不必排在几 MB 文件数据之后
+            int lowat = static_cast<int>(DOWNLOAD_CHUNK_SIZE);
+            ::setsockopt(socket_.native_handle(), IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat, sizeof(lowat));
+        }
+        std::size_t headerSent = 0;
+        while (headerSent < headerSize) {
+            headerSent += co_await socket_.async_send(asio::buffer(frame.data() + headerSent, headerSize - headerSent),
+                MSG_MORE, withMemory(writeMemory_, asio::redirect_error(asio::use_awaitable, ec)));
+            if (ec) {
+                co_return;
+            }
+        }
+        off_t offset = static_cast<off_t>(download.offset);
+        std::size_t remaining = length;
+        while (remaining > 0) {
+            ssize_t sent = ::sendfile(socket_.native_handle(), source.getDescriptor(), &offset, remaining);
+            if (sent > 0) {
+                remaining -= static_cast<std::size_t>(sent);
+            } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                co_await socket_.async_wait(asio::ip::tcp::socket::wait_write,
+                    withMemory(writeMemory_, asio::redirect_error(asio::use_awaitable, ec)));
+                if (ec) {
+                    co_return;
+                }
+            } else if (sent < 0 && errno == EINTR) {
+                continue;
+            } else {
+                // 返回 0 说明文件在发送期间被截短
+                ec = sent == 0 ? asio::error::eof : asio::error_code(errno, asio::error::get_system_category());
+                co_return;
+            }
+        }
+#else
+        // 没有 sendfile 的平台：文件内容读到帧头之后，与帧头一起写出
+        frame.resize(headerSize + length);
+        long long read = source.read(download.offset, frame.data() + headerSize, length);
+        if (read != static_cast<long long>(length)) {
+            ec = asio::error::eof;
+            co_return;
+        }
+        co_await asio::async_write(socket_, asio::buffer(frame),
+            withMemory(writeMemory_, asio::redirect_error(asio::use_awaitable, ec)));
+        if (ec) {
+            co_return;
+        }
+#endif
+        download.offset += length;
+        metrics_.fileBytesOut.add(length);
+        server_.recordWrite(shardIndex_, 1, headerSize + length);
+    }
+
+    if (download.offset == file.size && !download.cancelled) {
+        Message end(Message::Type::FILE_END);
+        end.setTarget(file.id);
+        downloads_.pop_front();
+        metrics_.activeFileTransfers.add(-1);
+        deliver(end);
+    }
+}
+
+void ChatSession::closeTransfers()
+{
+    auto active = static_cast<int64_t>(uploads_.size() + downloads_.size());
+    metrics_.fileTransfersAborted.add(static_cast<uint64_t>(active));
+    metrics_.activeFileTransfers.add(-active);
+    uploads_.clear();
+    downloads_.clear();
+}
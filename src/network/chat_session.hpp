@@ -1,32 +1,133 @@
 #pragma once
 #include <asio.hpp>
-#include <memory>
 #include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "file_store.hpp"
 #include "message.hpp"
+#include "message_view.hpp"
+#include "outbound_message.hpp"
+#include "frame_decoder.hpp"
+#include "handler_memory.hpp"
+#include "link_quality.hpp"
+#include "rate_limiter.hpp"
+#include "send_queue.hpp"
+#include "server_metrics.hpp"
 
 class ChatServer;
 
 class ChatSession : public std::enable_shared_from_this<ChatSession> {
 public:
-    explicit ChatSession(asio::ip::tcp::socket socket, ChatServer& server);
+    explicit ChatSession(asio::ip::tcp::socket socket, ChatServer& server, std::size_t shardIndex);
     
+    // 以下方法都必须在会话所属的事件循环线程上调用
     void start();
     void deliver(const Message& msg);
+    void deliver(SharedFrame frame, Message::Type type);
+    // 按本会话协商的帧格式取出（必要时生成）共享帧
+    void deliver(const SharedOutbound& msg);
+    void close();
     const std::string& getUsername() const { return username_; }
+    std::size_t getShardIndex() const { return shardIndex_; }
+    bool isClosed() const { return closed_; }
+
+    // 会话已加入的房间；只在所属线程上由 ChatServer 维护
+    const std::vector<std::string>& getRooms() const { return rooms_; }
+    bool addRoom(const std::string& room);
+    bool removeRoom(const std::string& room);
+
+    // 由所属事件循环的心跳时间轮检查
+    std::chrono::steady_clock::time_point getHeartbeatDeadline() const { return lastHeartbeat_ + HEARTBEAT_TIMEOUT; }
+    void onHeartbeatTimeout();
+    // 服务器发起的心跳探测测得的往返时间，客户端不支持探测时没有样本
+    const RttEstimator& getRtt() const { return rtt_; }
+    const SendQueue::Stats& getWriteStats() const { return writeMessages_.getStats(); }
+    std::size_t getQueuedFrames() const { return writeMessages_.size(); }
+    std::size_t getQueuedBytes() const { return writeMessages_.bytes(); }
 
 private:
-    void doRead();
-    void doWrite();
-    void handleMessage(const Message& msg);
-    void startHeartbeatCheck();
+    // 读循环和写循环都是协程，只在会话所属线程上运行；
+    // 各自的操作状态从 readMemory_/writeMemory_ 分配，稳定运行时不分配内存
+    asio::awaitable<void> readLoop();
+    asio::awaitable<void> writeLoop();
+    // 交给解码器 length 个新读到的字节并处理其中的完整帧，遇到限速暂停或关闭时停下
+    void processFrames(std::size_t length);
+    // 转发或处理客户端请求前检查速率限制；消息被丢弃时返回 false
+    bool admit(const MessageView& msg);
+    void handleMessage(const MessageView& msg);
+    void handleCapabilities(std::string_view offered);
+    void handleHeartbeat(const MessageView& msg);
+    // 把发送队列深度和丢帧数的变化计入分片指标
+    void updateQueueMetrics();
+    void wakeWriter();
+
+    // 文件传输。上传的块收到即写入磁盘，用 FILE_CREDIT 限制客户端领先写入的字节数；
+    // 下载只在发送队列为空时发下一块，聊天消息最多排在一块文件数据之后
+    void handleFileMessage(const MessageView& msg);
+    void beginUpload(const MessageView& msg);
+    void receiveChunk(const MessageView& msg);
+    void finishUpload(const std::string& transferId);
+    void beginDownload(const std::string& fileId);
+    void abortTransfer(const std::string& id, std::string_view reason);
+    // 发出当前下载的下一块：帧头之后的文件内容在 Linux 上由 sendfile 直接从页缓存写入 socket。
+    // 出错返回时不再访问下载状态，会话可能已在关闭时清理了它
+    asio::awaitable<void> sendFileChunk(asio::error_code& ec);
+    // 连接关闭后丢弃未完成的传输，未写完的上传文件随之删除
+    void closeTransfers();
 
     asio::ip::tcp::socket socket_;
     ChatServer& server_;
-    std::vector<uint8_t> readBuffer_;
-    std::deque<std::vector<uint8_t>> writeMessages_;
+    std::size_t shardIndex_;
+    ServerMetrics::Local& metrics_;
+    std::size_t reportedFrames_{0};
+    std::size_t reportedBytes_{0};
+    uint64_t reportedDropped_{0};
+    FrameDecoder decoder_;
+    SendQueue writeMessages_;
+    HandlerMemory readMemory_;
+    HandlerMemory writeMemory_;
+    // 写协程空闲时等待的信号：永不到期，deliver 取消等待即唤醒
+    asio::steady_timer writeSignal_;
+    bool writerWaiting_{false};
     std::string username_;
+    std::vector<std::string> rooms_;
     bool isFirstMessage_;
+    bool closed_{false};
+    FrameFormat format_;
     std::chrono::steady_clock::time_point lastHeartbeat_;
-    asio::steady_timer heartbeatTimer_;
+    RttEstimator rtt_;
+    // 限速：超限时暂停读取到 resumeAt_，或丢弃并在一轮连续丢弃中只通知一次
+    RateLimiter rateLimiter_;
+    bool dropOverLimit_{false};
+    bool readPaused_{false};
+    bool dropNoticeSent_{false};
+    std::chrono::steady_clock::time_point resumeAt_;
+    std::unique_ptr<asio::steady_timer> resumeTimer_;  // 第一次暂停时才创建
+
+    struct Upload {
+        std::unique_ptr<FileStore::Upload> file;
+        std::string recipient;
+        uint64_t granted{0};  // 已允许客户端发送的累计字节数
+    };
+    struct Download {
+        std::unique_ptr<FileStore::Source> source;
+        uint64_t offset{0};
+        bool cancelled{false};  // 客户端取消；可能正在发送，由写协程在两块之间移除
+    };
+    std::unordered_map<std::string, Upload> uploads_;  // 按客户端选择的传输编号
+    std::deque<Download> downloads_;                   // 按请求顺序逐个发送
     static constexpr auto HEARTBEAT_TIMEOUT = std::chrono::seconds(15);
-}; 
\ No newline at end of file
+    // 回显时间超过该值的探测视为无效（对端伪造或时间戳错乱）
+    static constexpr auto MAX_PROBE_AGE = std::chrono::seconds(60);
+    static constexpr std::size_t MAX_ROOMS_PER_SESSION = 64;
+    static constexpr std::size_t MAX_ROOM_NAME_LENGTH = 64;
+    static constexpr std::size_t MAX_UPLOADS_PER_SESSION = 4;
+    static constexpr std::size_t MAX_DOWNLOADS_PER_SESSION = 8;
+    static constexpr std::size_t MAX_TRANSFER_ID_LENGTH = 64;
+    // 上传窗口：客户端最多领先服务器确认的字节数，消耗过半时补发额度
+    static constexpr uint64_t UPLOAD_WINDOW = 4 * 1024 * 1024;
+    static constexpr std::size_t DOWNLOAD_CHUNK_SIZE = 256 * 1024;
+};
@@ -0,0 +1,103 @@
+#include "compression.hpp"
+#include <atomic>
+#include <chrono>
+#include <zlib.h>
+
+namespace {
+
+struct Counters {
+    std::atomic<uint64_t> compressedFrames{0};
+    std::atomic<uint64_t> skippedFrames{0};
+    std::atomic<uint64_t> rawBytes{0};
+    std::atomic<uint64_t> compressedBytes{0};
+    std::atomic<uint64_t> compressNanos{0};
+    std::atomic<uint64_t> inflatedFrames{0};
+    std::atomic<uint64_t> inflateNanos{0};
+};
+
+Counters counters;
+
+uint64_t elapsedNanos(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+bool Compression::compress(std::string_view input, std::string& output)
+{
+    if (input.size() < THRESHOLD || input.size() > MAX_INFLATED_SIZE) {
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    uLongf bound = compressBound(static_cast<uLong>(input.size()));
+    output.resize(4 + bound);
+    uint32_t rawLen = static_cast<uint32_t>(input.size());
+    output[0] = static_cast<char>(rawLen & 0xFF);
+    output[1] = static_cast<char>((rawLen >> 8) & 0xFF);
+    output[2] = static_cast<char>((rawLen >> 16) & 0xFF);
+    output[3] = static_cast<char>((rawLen >> 24) & 0xFF);
+
+    // 聊天内容以文本为主，默认级别在压缩比和 CPU 之间比较均衡
+    int rc = compress2(reinterpret_cast<Bytef*>(output.data() + 4), &bound,
+                       reinterpret_cast<const Bytef*>(input.data()), static_cast<uLong>(input.size()),
+                       Z_DEFAULT_COMPRESSION);
+    bool useful = rc == Z_OK && 4 + bound < input.size();
+
+    counters.compressNanos.fetch_add(elapsedNanos(start), std::memory_order_relaxed);
+    if (!useful) {
+        counters.skippedFrames.fetch_add(1, std::memory_order_relaxed);
+        output.clear();
+        return false;
+    }
+
+    output.resize(4 + bound);
+    counters.compressedFrames.fetch_add(1, std::memory_order_relaxed);
+    counters.rawBytes.fetch_add(input.size(), std::memory_order_relaxed);
+    counters.compressedBytes.fetch_add(output.size(), std::memory_order_relaxed);
+    return true;
+}
+
+bool Compression::decompress(const uint8_t* data, std::size_t size, std::string& output)
+{
+    if (size < 4) {
+        return false;
+    }
+
+    uint32_t rawLen = data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    if (rawLen > MAX_INFLATED_SIZE) {
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    output.resize(rawLen);
+    uLongf destLen = rawLen;
+    int rc = uncompress(reinterpret_cast<Bytef*>(output.data()), &destLen,
+                        data + 4, static_cast<uLong>(size - 4));
+
+    counters.inflateNanos.fetch_add(elapsedNanos(start), std::memory_order_relaxed);
+    if (rc != Z_OK || destLen != rawLen) {
+        output.clear();
+        return false;
+    }
+
+    counters.inflatedFrames.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+Compression::Stats Compression::getStats()
+{
+    Stats stats;
+    stats.compressedFrames = counters.compressedFrames.load(std::memory_order_relaxed);
+    stats.skippedFrames = counters.skippedFrames.load(std::memory_order_relaxed);
+    stats.rawBytes = counters.rawBytes.load(std::memory_order_relaxed);
+    stats.compressedBytes = counters.compressedBytes.load(std::memory_order_relaxed);
+    stats.compressNanos = counters.compressNanos.load(std::memory_order_relaxed);
+    stats.inflatedFrames = counters.inflatedFrames.load(std::memory_order_relaxed);
+    stats.inflateNanos = counters.inflateNanos.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// 帧内容压缩（zlib deflate）。连接建立时通过 CAPABILITIES 消息协商，
+// 协商成功后只压缩内容超过阈值的帧，压缩后没有变小则按原样发送。
+// 压缩帧的内容格式: [原始长度(4字节)][deflate 数据]
+class Compression {
+public:
+    static constexpr std::string_view CAPABILITY = "deflate";
+    static constexpr std::size_t THRESHOLD = 512;
+    // 与帧解码器的最大帧长度一致，防止解压炸弹
+    static constexpr std::size_t MAX_INFLATED_SIZE = 16 * 1024 * 1024;
+
+    struct Stats {
+        uint64_t compressedFrames{0};
+        uint64_t skippedFrames{0};    // 压缩没有收益、按原样发送的帧
+        uint64_t rawBytes{0};         // 压缩前的字节数
+        uint64_t compressedBytes{0};  // 压缩后的字节数
+        uint64_t compressNanos{0};
+        uint64_t inflatedFrames{0};
+        uint64_t inflateNanos{0};
+
+        double ratio() const {
+            return compressedBytes ? static_cast<double>(rawBytes) / compressedBytes : 0.0;
+        }
+    };
+
+    // 内容不足阈值或压缩后没有变小时返回 false
+    static bool compress(std::string_view input, std::string& output);
+    static bool decompress(const uint8_t* data, std::size_t size, std::string& output);
+
+    // 进程内所有压缩解压操作的累计统计，可在任意线程调用
+    static Stats getStats();
+};
@@ -0,0 +1,344 @@
+#include "federation.hpp"
+#include "chat_server.hpp"
+#include "presence.hpp"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+uint64_t unixMicros()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+// Prometheus 标签值中的反斜杠、双引号和换行需要转义
+std::string escapeLabel(const std::string& value)
+{
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+} // namespace
+
+bool Federation::ReplayWindow::accept(uint64_t sequence)
+{
+    if (sequence > highest) {
+        uint64_t shift = sequence - highest;
+        if (shift >= WINDOW) {
+            seen.reset();
+        } else {
+            seen <<= shift;
+        }
+        seen.set(0);
+        highest = sequence;
+        return true;
+    }
+
+    uint64_t offset = highest - sequence;
+    if (offset >= WINDOW || seen.test(offset)) {
+        return false;
+    }
+    seen.set(offset);
+    return true;
+}
+
+Federation::Federation(ChatServer& server, Strand strand, ServerMetrics::Local& metrics, FederationConfig config)
+    : server_(server)
+    , strand_(std::move(strand))
+    , metrics_(metrics)
+    , config_(std::move(config))
+    , nextRelaySequence_(unixMicros())
+{
+    if (config_.port != 0) {
+        acceptor_ = std::make_unique<asio::ip::tcp::acceptor>(strand_,
+            asio::ip::tcp::endpoint(asio::ip::tcp::v4(), config_.port));
+    }
+}
+
+void Federation::start()
+{
+    std::cout << "联邦节点: " << config_.nodeId;
+    if (acceptor_) {
+        std::cout << "，链路端口 " << acceptor_->local_endpoint().port();
+    }
+    std::cout << std::endl;
+
+    if (acceptor_) {
+        asio::co_spawn(strand_, acceptLoop(), asio::detached);
+    }
+    for (const auto& peer : config_.peers) {
+        asio::co_spawn(strand_, dialLoop(peer), asio::detached);
+    }
+}
+
+asio::awaitable<void> Federation::acceptLoop()
+{
+    for (;;) {
+        asio::error_code ec;
+        auto socket = co_await acceptor_->async_accept(asio::redirect_error(asio::use_awaitable, ec));
+        if (ec == asio::error::operation_aborted) {
+            co_return;
+        }
+        if (!ec) {
+            auto link = std::make_shared<PeerLink>(std::move(socket), *this, false);
+            asio::co_spawn(strand_, [link]() { return link->run(); }, asio::detached);
+        }
+    }
+}
+
+asio::awaitable<void> Federation::dialLoop(FederationConfig::Peer peer)
+{
+    // 链路断开后按指数退避重连；对端已经通过另一条链路连上时不再重复连接
+    asio::steady_timer timer(strand_);
+    asio::ip::tcp::resolver resolver(strand_);
+    std::string peerId;
+    auto delay = std::chrono::seconds(MIN_REDIAL_DELAY);
+    bool reported = false;
+
+    for (;;) {
+        if (peerId.empty() || links_.count(peerId) == 0) {
+            asio::error_code ec;
+            auto endpoints = co_await resolver.async_resolve(peer.host, std::to_string(peer.port),
+                asio::redirect_error(asio::use_awaitable, ec));
+            asio::ip::tcp::socket socket(strand_);
+            if (!ec) {
+                co_await asio::async_connect(socket, endpoints, asio::redirect_error(asio::use_awaitable, ec));
+            }
+
+            if (!ec) {
+                auto link = std::make_shared<PeerLink>(std::move(socket), *this, true);
+                co_await link->run();
+                if (!link->getPeerId().empty()) {
+                    peerId = link->getPeerId();
+                    delay = MIN_REDIAL_DELAY;
+                    reported = false;
+                }
+            } else {
+                if (!reported) {
+                    std::cout << "无法连接联邦节点 " << peer.host << ":" << peer.port
+                              << ": " << ec.message() << "，稍后重试" << std::endl;
+                    reported = true;
+                }
+                delay = std::min<std::chrono::seconds>(delay * 2, MAX_REDIAL_DELAY);
+            }
+        }
+
+        timer.expires_after(delay);
+        asio::error_code ec;
+        co_await timer.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+    }
+}
+
+void Federation::onHello(const std::shared_ptr<PeerLink>& link)
+{
+    const std::string& peerId = link->getPeerId();
+    if (peerId == config_.nodeId) {
+        std::cout << "联邦链路连接到了本节点自身，断开" << std::endl;
+        link->close();
+        return;
+    }
+
+    // 两个节点互相连接时各有两条链路，双方都保留由节点名较小一方发起的那条；
+    // 同一方向的新链路替换旧链路（旧链路可能已失效而尚未超时）
+    auto& current = links_[peerId];
+    if (!current) {
+        metrics_.federationLinks.add(1);
+    } else if (current != link) {
+        const std::string& preferredDialer = std::min(config_.nodeId, peerId);
+        auto dialer = [&](const PeerLink& l) -> const std::string& {
+            return l.isOutbound() ? config_.nodeId : peerId;
+        };
+        if (dialer(*link) != preferredDialer && dialer(*current) == preferredDialer) {
+            link->close();
+            return;
+        }
+        current->close();
+    }
+    current = link;
+
+    link->setStats(&statsFor(peerId));
+    std::cout << "联邦链路已建立: " << config_.nodeId << (link->isOutbound() ? " -> " : " <- ")
+              << peerId << std::endl;
+    sendPresenceSnapshot(*link);
+}
+
+void Federation::onLinkClosed(const std::shared_ptr<PeerLink>& link)
+{
+    const std::string& peerId = link->getPeerId();
+    auto it = links_.find(peerId);
+    if (it == links_.end() || it->second != link) {
+        // 握手前断开、被拒绝或已被新链路替换
+        return;
+    }
+    links_.erase(it);
+    metrics_.federationLinks.add(-1);
+    server_.clearRemoteUsers(peerId);
+    std::cout << "联邦链路断开: " << peerId << std::endl;
+}
+
+SharedFrame Federation::wrap(const SharedOutbound& msg)
+{
+    // 原消息按 v2 帧（值得时压缩）整体放进信封，接收方解码后重新分配本地序号
+    const SharedFrame& inner = msg->frame(FrameFormat{2, true});
+    Message envelope(Message::Type::PEER_RELAY);
+    envelope.setSender(config_.nodeId);
+    envelope.setSequence(nextRelaySequence_++);
+    envelope.setTimestamp(unixMicros());
+    envelope.setContent(std::string(inner->begin(), inner->end()));
+    return envelope.encodeShared(2);
+}
+
+void Federation::forward(const SharedOutbound& msg)
+{
+    asio::post(strand_, [this, msg]() {
+        if (links_.empty()) {
+            return;
+        }
+        broadcast(wrap(msg), Message::Type::PEER_RELAY);
+        metrics_.federationRelayedOut.add();
+    });
+}
+
+void Federation::forwardTo(const std::string& peerId, const SharedOutbound& msg)
+{
+    auto it = links_.find(peerId);
+    if (it == links_.end()) {
+        return;
+    }
+    it->second->send(wrap(msg), Message::Type::PEER_RELAY);
+    metrics_.federationRelayedOut.add();
+}
+
+void Federation::onRelay(PeerLink& link, const MessageView& msg)
+{
+    Message envelope;
+    if (!msg.toMessage(envelope) || envelope.getSender() == config_.nodeId) {
+        return;
+    }
+    if (!replayWindows_[envelope.getSender()].accept(envelope.getSequence())) {
+        metrics_.federationDuplicates.add();
+        return;
+    }
+
+    const std::string& inner = envelope.getContent();
+    auto relayed = Message::decode(reinterpret_cast<const uint8_t*>(inner.data()), inner.size());
+    if (!relayed || (relayed->getType() != Message::Type::TEXT && relayed->getType() != Message::Type::ROOM_TEXT &&
+                     relayed->getType() != Message::Type::PRIVATE)) {
+        std::cout << "联邦链路收到无法解码的转发消息: " << link.getPeerId() << std::endl;
+        return;
+    }
+
+    // 跨节点延迟依赖两端系统时钟同步；同一台机器上的多个节点总是准确的
+    uint64_t now = unixMicros();
+    if (now >= envelope.getTimestamp()) {
+        metrics_.federationDelivery.record(std::chrono::microseconds(now - envelope.getTimestamp()));
+    }
+    metrics_.federationRelayedIn.add();
+    server_.deliverFederated(std::move(*relayed));
+}
+
+void Federation::announceLocal(const std::string& username, bool online)
+{
+    Presence::Delta delta;
+    delta.baseVersion = presenceVersion_;
+    delta.version = ++presenceVersion_;
+    delta.changes.emplace_back(username, online);
+
+    if (links_.empty()) {
+        return;
+    }
+    Message msg(Message::Type::PEER_PRESENCE);
+    msg.setSender(config_.nodeId);
+    msg.setTarget("delta");
+    msg.setContent(Presence::encodeDelta(delta));
+    broadcast(msg.encodeShared(2), msg.getType());
+}
+
+void Federation::sendPresenceSnapshot(PeerLink& link)
+{
+    Message msg(Message::Type::PEER_PRESENCE);
+    msg.setSender(config_.nodeId);
+    msg.setTarget("snapshot");
+    msg.setContent(Presence::encodeSnapshot(presenceVersion_, server_.getLocalUsers()));
+    link.send(msg.encodeShared(2), msg.getType());
+}
+
+void Federation::onPresence(PeerLink& link, const MessageView& msg)
+{
+    // 每个节点只通告自己的本地用户
+    Message presence;
+    if (!msg.toMessage(presence) || presence.getSender() != link.getPeerId()) {
+        return;
+    }
+
+    if (presence.getTarget() == "snapshot") {
+        uint64_t version = 0;
+        std::vector<std::string> users;
+        if (Presence::parseSnapshot(presence.getContent(), version, users)) {
+            server_.setRemoteUsers(link.getPeerId(), users);
+        }
+    } else if (presence.getTarget() == "delta") {
+        Presence::Delta delta;
+        if (Presence::parseDelta(presence.getContent(), delta)) {
+            for (const auto& [username, online] : delta.changes) {
+                server_.setRemoteUser(link.getPeerId(), username, online);
+            }
+        }
+    }
+}
+
+void Federation::broadcast(const SharedFrame& frame, Message::Type type)
+{
+    for (const auto& [peerId, link] : links_) {
+        link->send(frame, type);
+    }
+}
+
+PeerLink::Stats& Federation::statsFor(const std::string& peerId)
+{
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    auto& stats = stats_[peerId];
+    if (!stats) {
+        stats = std::make_unique<PeerLink::Stats>();
+    }
+    return *stats;
+}
+
+void Federation::render(std::string& out) const
+{
+    struct Series {
+        const char* name;
+        const char* help;
+        const ServerMetrics::Counter PeerLink::Stats::*counter;
+    };
+    static const Series series[] = {
+        {"chat_federation_frames_sent_total", "Frames written to each peer node.", &PeerLink::Stats::framesSent},
+        {"chat_federation_bytes_sent_total", "Bytes written to each peer node.", &PeerLink::Stats::bytesSent},
+        {"chat_federation_frames_received_total", "Frames received from each peer node.",
+         &PeerLink::Stats::framesReceived},
+        {"chat_federation_bytes_received_total", "Bytes received from each peer node.",
+         &PeerLink::Stats::bytesReceived},
+    };
+
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    for (const auto& s : series) {
+        out.append("# HELP ").append(s.name).append(" ").append(s.help).append("\n");
+        out.append("# TYPE ").append(s.name).append(" counter\n");
+        for (const auto& [peerId, stats] : stats_) {
+            out.append(s.name).append("{peer=\"").append(escapeLabel(peerId)).append("\"} ")
+               .append(std::to_string(((*stats).*(s.counter)).get())).append("\n");
+        }
+    }
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <asio.hpp>
+#include <bitset>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "message_view.hpp"
+#include "outbound_message.hpp"
+#include "peer_link.hpp"
+#include "server_metrics.hpp"
+
+class ChatServer;
+
+struct FederationConfig {
+    struct Peer {
+        std::string host;
+        uint16_t port{0};
+    };
+
+    std::string nodeId;           // 集群内唯一的节点名
+    uint16_t port{0};             // 接受其他节点连接的端口，0 表示只主动连接
+    std::vector<Peer> peers;      // 主动连接的节点
+
+    bool enabled() const { return port != 0 || !peers.empty(); }
+};
+
+// 多个 ChatServer 节点组成的集群。拓扑为全连接：每对节点之间一条链路，
+// 至少由其中一方在 peers 中列出对方；双方都列出时按节点名只保留一条。
+// 本地客户端发来的聊天消息每条链路只发一份；从链路收到的消息只投递给本地会话，
+// 不再转发给其他节点（水平分割），因此不会形成环路；来源为本节点的消息和
+// 按来源节点序号判定的重复消息直接丢弃。
+// 在线用户列表：每个节点只通告自己的本地用户，链路建立时发送快照，之后发送增量，
+// 链路断开时撤销该节点的全部用户。
+// 联邦的所有状态只在 ChatServer 的目录 strand 上访问
+class Federation {
+public:
+    using Strand = asio::strand<asio::io_context::executor_type>;
+
+    // metrics 必须属于 strand 所在事件循环的分片
+    Federation(ChatServer& server, Strand strand, ServerMetrics::Local& metrics, FederationConfig config);
+
+    void start();
+    const std::string& getNodeId() const { return config_.nodeId; }
+
+    // 转发一条本地客户端发来的聊天消息，可在任意线程调用
+    void forward(const SharedOutbound& msg);
+    // 只转发给一个节点（接收方所在节点的私聊），在 strand 上调用
+    void forwardTo(const std::string& peerId, const SharedOutbound& msg);
+    // 本地用户上线或下线（集群内第一个或最后一个本地会话），在 strand 上调用
+    void announceLocal(const std::string& username, bool online);
+
+    // 追加各链路的流量指标，可在任意线程调用
+    void render(std::string& out) const;
+
+    // 以下由 PeerLink 在 strand 上调用
+    void onHello(const std::shared_ptr<PeerLink>& link);
+    void onLinkClosed(const std::shared_ptr<PeerLink>& link);
+    void onRelay(PeerLink& link, const MessageView& msg);
+    void onPresence(PeerLink& link, const MessageView& msg);
+
+private:
+    // 每个来源节点最近 WINDOW 个转发序号的接收记录，用于丢弃重复消息
+    struct ReplayWindow {
+        static constexpr std::size_t WINDOW = 1024;
+
+        // 首次见到返回 true；太旧或已见过返回 false
+        bool accept(uint64_t sequence);
+
+        uint64_t highest{0};
+        std::bitset<WINDOW> seen;
+    };
+
+    asio::awaitable<void> acceptLoop();
+    asio::awaitable<void> dialLoop(FederationConfig::Peer peer);
+    SharedFrame wrap(const SharedOutbound& msg);
+    void sendPresenceSnapshot(PeerLink& link);
+    void broadcast(const SharedFrame& frame, Message::Type type);
+    PeerLink::Stats& statsFor(const std::string& peerId);
+
+    static constexpr auto MIN_REDIAL_DELAY = std::chrono::seconds(1);
+    static constexpr auto MAX_REDIAL_DELAY = std::chrono::seconds(10);
+
+    ChatServer& server_;
+    Strand strand_;
+    ServerMetrics::Local& metrics_;
+    FederationConfig config_;
+    std::unique_ptr<asio::ip::tcp::acceptor> acceptor_;
+
+    // 已完成握手的链路，每个对端节点一条
+    std::unordered_map<std::string, std::shared_ptr<PeerLink>> links_;
+    std::unordered_map<std::string, ReplayWindow> replayWindows_;
+    // 转发序号从启动时刻（Unix 微秒）起递增，节点重启后序号仍大于重启前，
+    // 对端不会把重启后的消息当作重复
+    uint64_t nextRelaySequence_;
+    uint64_t presenceVersion_{0};
+
+    // 按对端节点累计的链路流量；表结构由 statsMutex_ 保护，计数只在 strand 上写入
+    mutable std::mutex statsMutex_;
+    std::map<std::string, std::unique_ptr<PeerLink::Stats>> stats_;
+};
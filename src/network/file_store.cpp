@@ -0,0 +1,205 @@
+#include "file_store.hpp"
+#include <chrono>
+#include <filesystem>
+#include <fcntl.h>
+#include <stdexcept>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+int openForRead(const std::string& path)
+{
+#ifdef _WIN32
+    return ::_open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+    return ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+}
+
+void closeDescriptor(int fd)
+{
+#ifdef _WIN32
+    ::_close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+// 客户端给出的文件名只用于展示和下载时的默认名，去掉目录部分和控制字符
+std::string sanitizeName(std::string_view name)
+{
+    auto slash = name.find_last_of("/\\");
+    if (slash != std::string_view::npos) {
+        name.remove_prefix(slash + 1);
+    }
+    std::string result;
+    for (char c : name.substr(0, 255)) {
+        if (static_cast<unsigned char>(c) >= 0x20) {
+            result += c;
+        }
+    }
+    if (result.empty() || result == "." || result == "..") {
+        result = "file";
+    }
+    return result;
+}
+
+} // namespace
+
+FileStore::Upload::Upload(FileStore& store, StoredFile file, std::FILE* out)
+    : store_(store)
+    , file_(std::move(file))
+    , out_(out)
+{
+}
+
+FileStore::Upload::~Upload()
+{
+    if (out_) {
+        std::fclose(out_);
+    }
+    if (!finished_) {
+        std::error_code ec;
+        std::filesystem::remove(file_.path + ".part", ec);
+        store_.release(file_.size);
+    }
+}
+
+bool FileStore::Upload::write(const void* data, std::size_t size)
+{
+    if (!out_ || size > file_.size - received_) {
+        return false;
+    }
+    if (std::fwrite(data, 1, size, out_) != size) {
+        return false;
+    }
+    received_ += size;
+    return true;
+}
+
+std::optional<FileStore::StoredFile> FileStore::Upload::finish()
+{
+    if (!out_ || finished_ || received_ != file_.size) {
+        return std::nullopt;
+    }
+    bool flushed = std::fclose(out_) == 0;
+    out_ = nullptr;
+    if (!flushed) {
+        return std::nullopt;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(file_.path + ".part", file_.path, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    finished_ = true;
+    store_.registerFile(file_);
+    return file_;
+}
+
+FileStore::Source::~Source()
+{
+    closeDescriptor(fd_);
+}
+
+long long FileStore::Source::read(uint64_t offset, void* data, std::size_t size)
+{
+#ifdef _WIN32
+    if (::_lseeki64(fd_, static_cast<long long>(offset), SEEK_SET) < 0) {
+        return -1;
+    }
+    return ::_read(fd_, data, static_cast<unsigned int>(size));
+#else
+    return ::pread(fd_, data, size, static_cast<off_t>(offset));
+#endif
+}
+
+FileStore::FileStore(std::string directory, Limits limits)
+    : directory_(std::move(directory))
+    , limits_(limits)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    if (ec) {
+        throw std::runtime_error("无法创建文件目录 " + directory_ + ": " + ec.message());
+    }
+
+    // 文件编号带上启动时间，重启后不会覆盖之前的文件
+    auto startup = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    char prefix[32];
+    std::snprintf(prefix, sizeof(prefix), "%llx", static_cast<unsigned long long>(startup));
+    idPrefix_ = prefix;
+}
+
+std::unique_ptr<FileStore::Upload> FileStore::beginUpload(const std::string& owner, const std::string& recipient,
+                                                          std::string_view name, uint64_t size, std::string& reason)
+{
+    if (size > limits_.maxFileSize) {
+        reason = "too-large";
+        return nullptr;
+    }
+    // 先按声明的大小占用配额，上传中断时在 Upload 析构时归还
+    uint64_t reserved = reservedBytes_.fetch_add(size, std::memory_order_relaxed) + size;
+    if (reserved > limits_.maxTotalBytes) {
+        release(size);
+        reason = "storage-full";
+        return nullptr;
+    }
+
+    StoredFile file;
+    file.id = idPrefix_ + "-" + std::to_string(nextId_.fetch_add(1, std::memory_order_relaxed));
+    file.name = sanitizeName(name);
+    file.size = size;
+    file.owner = owner;
+    file.recipient = recipient;
+    file.path = (std::filesystem::path(directory_) / file.id).string();
+
+    std::FILE* out = std::fopen((file.path + ".part").c_str(), "wb");
+    if (!out) {
+        release(size);
+        reason = "io-error";
+        return nullptr;
+    }
+    return std::unique_ptr<Upload>(new Upload(*this, std::move(file), out));
+}
+
+std::unique_ptr<FileStore::Source> FileStore::open(const std::string& id, const std::string& username,
+                                                   std::string& reason)
+{
+    StoredFile file;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = files_.find(id);
+        // 没有权限时和文件不存在一样回复，不暴露其他人私发文件的编号
+        if (it == files_.end() ||
+            (!it->second.recipient.empty() && it->second.recipient != username && it->second.owner != username)) {
+            reason = "not-found";
+            return nullptr;
+        }
+        file = it->second;
+    }
+
+    int fd = openForRead(file.path);
+    if (fd < 0) {
+        reason = "io-error";
+        return nullptr;
+    }
+    return std::unique_ptr<Source>(new Source(std::move(file), fd));
+}
+
+void FileStore::release(uint64_t size)
+{
+    reservedBytes_.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void FileStore::registerFile(const StoredFile& file)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    files_[file.id] = file;
+}
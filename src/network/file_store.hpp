@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// 服务器上的文件暂存区：上传的文件按块直接写入磁盘，完成后登记到内存索引，
+// 下载时从磁盘按块读出（Linux 上用 sendfile 直接从页缓存发到 socket）。
+// 整个文件不会进入用户态内存。索引只在内存中，重启后之前的文件不再可下载。
+// 所有方法可在任意线程调用
+class FileStore {
+public:
+    struct Limits {
+        uint64_t maxFileSize{1024ull * 1024 * 1024};         // 单个文件
+        uint64_t maxTotalBytes{16ull * 1024 * 1024 * 1024};  // 已保存和正在上传的文件总和
+    };
+
+    struct StoredFile {
+        std::string id;
+        std::string name;
+        uint64_t size{0};
+        std::string owner;
+        std::string recipient;  // 为空表示所有人可下载
+        std::string path;
+    };
+
+    // 一次进行中的上传，只在所属会话的线程上使用；未完成就销毁时删除已写入的部分
+    class Upload {
+    public:
+        ~Upload();
+        Upload(const Upload&) = delete;
+        Upload& operator=(const Upload&) = delete;
+
+        bool write(const void* data, std::size_t size);
+        uint64_t getReceived() const { return received_; }
+        uint64_t getSize() const { return file_.size; }
+        // 收齐声明的长度后落盘并登记，返回可供下载的文件
+        std::optional<StoredFile> finish();
+
+    private:
+        friend class FileStore;
+        Upload(FileStore& store, StoredFile file, std::FILE* out);
+
+        FileStore& store_;
+        StoredFile file_;
+        std::FILE* out_;
+        uint64_t received_{0};
+        bool finished_{false};
+    };
+
+    // 为下载打开的文件，只在所属会话的线程上使用
+    class Source {
+    public:
+        ~Source();
+        Source(const Source&) = delete;
+        Source& operator=(const Source&) = delete;
+
+        const StoredFile& getFile() const { return file_; }
+        // 用于 sendfile 的文件描述符
+        int getDescriptor() const { return fd_; }
+        // 不支持 sendfile 的平台从 offset 处读出最多 size 字节，出错时返回 -1
+        long long read(uint64_t offset, void* data, std::size_t size);
+
+    private:
+        friend class FileStore;
+        Source(StoredFile file, int fd) : file_(std::move(file)), fd_(fd) {}
+
+        StoredFile file_;
+        int fd_;
+    };
+
+    FileStore(std::string directory, Limits limits);
+
+    const Limits& getLimits() const { return limits_; }
+
+    // 文件名只保留最后一个路径分量；超出大小限制或无法创建文件时返回空，reason 说明原因
+    std::unique_ptr<Upload> beginUpload(const std::string& owner, const std::string& recipient,
+                                        std::string_view name, uint64_t size, std::string& reason);
+    // 文件存在且 username 有权下载时打开它
+    std::unique_ptr<Source> open(const std::string& id, const std::string& username, std::string& reason);
+
+private:
+    void release(uint64_t size);
+    void registerFile(const StoredFile& file);
+
+    std::string directory_;
+    Limits limits_;
+    std::string idPrefix_;
+    std::atomic<uint64_t> nextId_{1};
+    std::atomic<uint64_t> reservedBytes_{0};
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, StoredFile> files_;
+};
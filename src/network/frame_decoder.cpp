@@ -0,0 +1,87 @@
+#include "frame_decoder.hpp"
+#include "buffer_pool.hpp"
+#include <algorithm>
+#include <cstring>
+
+FrameDecoder::FrameDecoder(std::size_t maxFrameSize)
+    : buffer_(BufferPool::acquireLocal(INITIAL_CAPACITY))
+    , maxFrameSize_(maxFrameSize)
+{
+    // 连接频繁建立断开时，初始读缓冲区在连接之间复用
+    buffer_.resize(INITIAL_CAPACITY);
+}
+
+FrameDecoder::~FrameDecoder()
+{
+    if (auto* pool = BufferPool::local()) {
+        pool->release(std::move(buffer_));
+    }
+}
+
+asio::mutable_buffer FrameDecoder::prepare()
+{
+    // 已知待收帧的总长时一次性扩容到位，避免大帧反复增长
+    std::size_t required = std::max(pendingFrameSize_, buffered() + INITIAL_CAPACITY / 2);
+    if (begin_ + required > buffer_.size()) {
+        if (begin_ > 0) {
+            std::memmove(buffer_.data(), buffer_.data() + begin_, buffered());
+            end_ -= begin_;
+            begin_ = 0;
+        }
+        if (required > buffer_.size()) {
+            buffer_.resize(std::max(required, buffer_.size() * 2));
+        }
+    }
+    return asio::buffer(buffer_.data() + end_, buffer_.size() - end_);
+}
+
+void FrameDecoder::reset()
+{
+    begin_ = 0;
+    end_ = 0;
+    pendingFrameSize_ = 0;
+    failed_ = false;
+    if (buffer_.size() > INITIAL_CAPACITY) {
+        buffer_.resize(INITIAL_CAPACITY);
+        buffer_.shrink_to_fit();
+    }
+}
+
+bool FrameDecoder::extractFrame(const uint8_t*& data, std::size_t& size)
+{
+    if (failed_) return false;
+
+    std::size_t available = buffered();
+    std::size_t total = Message::frameSize(buffer_.data() + begin_, available);
+    if (total == 0) {
+        pendingFrameSize_ = 0;
+        return false;
+    }
+    if (total > maxFrameSize_) {
+        failed_ = true;
+        return false;
+    }
+    if (total > available) {
+        pendingFrameSize_ = total;
+        return false;
+    }
+
+    data = buffer_.data() + begin_;
+    size = total;
+    begin_ += total;
+    pendingFrameSize_ = 0;
+    return true;
+}
+
+void FrameDecoder::compact()
+{
+    if (begin_ == end_) {
+        begin_ = 0;
+        end_ = 0;
+        // 大帧处理完后归还内存，空闲连接只保留初始容量
+        if (buffer_.size() > INITIAL_CAPACITY * 64) {
+            buffer_.resize(INITIAL_CAPACITY);
+            buffer_.shrink_to_fit();
+        }
+    }
+}
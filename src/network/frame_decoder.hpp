@@ -0,0 +1,59 @@
+#pragma once
+#include <asio.hpp>
+#include <cstdint>
+#include <vector>
+#include "message.hpp"
+
+// 增量式帧解码器：socket 直接读入内部可增长缓冲区，
+// 每次读取后取出所有完整帧，不完整的帧保留到下一次读取
+class FrameDecoder {
+public:
+    static constexpr std::size_t INITIAL_CAPACITY = 1024;
+    static constexpr std::size_t MAX_FRAME_SIZE = 16 * 1024 * 1024;
+
+    explicit FrameDecoder(std::size_t maxFrameSize = MAX_FRAME_SIZE);
+    ~FrameDecoder();
+
+    FrameDecoder(const FrameDecoder&) = delete;
+    FrameDecoder& operator=(const FrameDecoder&) = delete;
+
+    // 返回可供 async_read_some 写入的空闲区域
+    asio::mutable_buffer prepare();
+
+    // 提交读到的 length 字节，并对每个完整帧调用 handler(const uint8_t*, std::size_t)；
+    // handler 返回 false 时停止处理。帧数据只在回调期间有效。
+    // 遇到超长帧等协议错误时返回 false
+    template <typename Handler>
+    bool commit(std::size_t length, Handler&& handler);
+
+    void reset();
+    std::size_t buffered() const { return end_ - begin_; }
+
+private:
+    bool extractFrame(const uint8_t*& data, std::size_t& size);
+    void compact();
+
+    std::vector<uint8_t> buffer_;
+    std::size_t begin_{0};     // 未处理数据起点
+    std::size_t end_{0};       // 已读数据终点
+    std::size_t pendingFrameSize_{0};
+    std::size_t maxFrameSize_;
+    bool failed_{false};
+};
+
+template <typename Handler>
+bool FrameDecoder::commit(std::size_t length, Handler&& handler)
+{
+    end_ += length;
+
+    const uint8_t* data = nullptr;
+    std::size_t size = 0;
+    while (extractFrame(data, size)) {
+        if (!handler(data, size)) {
+            break;
+        }
+    }
+
+    compact();
+    return !failed_;
+}
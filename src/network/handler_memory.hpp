@@ -0,0 +1,155 @@
+#pragma once
+#include <asio.hpp>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "buffer_pool.hpp"
+
+// 异步操作状态的回收内存：同一时刻只有一个未完成操作的连续异步循环（会话的读循环、写循环），
+// 每个操作都复用同一块内存，稳定运行时不再调用 operator new。
+// asio 在调用完成处理器之前释放操作状态，所以处理器里发起的下一个操作总能拿到这块内存；
+// 超过容量或内存正被占用时退回到 operator new
+class HandlerMemory {
+public:
+    HandlerMemory() = default;
+    HandlerMemory(const HandlerMemory&) = delete;
+    HandlerMemory& operator=(const HandlerMemory&) = delete;
+
+    void* allocate(std::size_t size)
+    {
+        if (!inUse_ && size <= sizeof(storage_)) {
+            inUse_ = true;
+            return &storage_;
+        }
+        return ::operator new(size);
+    }
+
+    void deallocate(void* pointer)
+    {
+        if (pointer == &storage_) {
+            inUse_ = false;
+        } else {
+            ::operator delete(pointer);
+        }
+    }
+
+private:
+    static constexpr std::size_t CAPACITY = 1024;
+
+    std::aligned_storage_t<CAPACITY, alignof(std::max_align_t)> storage_;
+    bool inUse_{false};
+};
+
+// 从 HandlerMemory 分配的标准分配器，作为完成处理器的关联分配器
+template <typename T>
+class HandlerAllocator {
+public:
+    using value_type = T;
+
+    explicit HandlerAllocator(HandlerMemory& memory) : memory_(&memory) {}
+
+    template <typename U>
+    HandlerAllocator(const HandlerAllocator<U>& other) noexcept : memory_(other.memory_) {}
+
+    T* allocate(std::size_t n) { return static_cast<T*>(memory_->allocate(sizeof(T) * n)); }
+    void deallocate(T* pointer, std::size_t) { memory_->deallocate(pointer); }
+
+    template <typename U>
+    bool operator==(const HandlerAllocator<U>& other) const noexcept { return memory_ == other.memory_; }
+    template <typename U>
+    bool operator!=(const HandlerAllocator<U>& other) const noexcept { return memory_ != other.memory_; }
+
+private:
+    template <typename>
+    friend class HandlerAllocator;
+
+    HandlerMemory* memory_;
+};
+
+// 给任意完成处理器附加 HandlerAllocator，执行器仍取处理器自己的关联执行器
+template <typename Handler>
+class AllocatingHandler {
+public:
+    using allocator_type = HandlerAllocator<void>;
+    using executor_type = asio::associated_executor_t<Handler>;
+
+    AllocatingHandler(Handler handler, HandlerMemory& memory)
+        : handler_(std::move(handler))
+        , memory_(memory)
+    {
+    }
+
+    allocator_type get_allocator() const noexcept { return allocator_type(memory_); }
+    executor_type get_executor() const noexcept { return asio::get_associated_executor(handler_); }
+
+    template <typename... Args>
+    void operator()(Args&&... args)
+    {
+        std::move(handler_)(std::forward<Args>(args)...);
+    }
+
+private:
+    Handler handler_;
+    HandlerMemory& memory_;
+};
+
+// 完成令牌包装：co_await op(..., withMemory(memory, asio::use_awaitable))
+// 使 op 的状态从 memory 分配，对协程和回调令牌都适用
+template <typename Token>
+struct MemoryBoundToken {
+    Token token;
+    HandlerMemory& memory;
+};
+
+template <typename Token>
+MemoryBoundToken<std::decay_t<Token>> withMemory(HandlerMemory& memory, Token&& token)
+{
+    return {std::forward<Token>(token), memory};
+}
+
+template <typename Token, typename Signature>
+class asio::async_result<MemoryBoundToken<Token>, Signature> {
+public:
+    template <typename Initiation, typename RawToken, typename... Args>
+    static auto initiate(Initiation&& initiation, RawToken&& bound, Args&&... args)
+    {
+        HandlerMemory& memory = bound.memory;
+        return asio::async_initiate<Token, Signature>(
+            [&memory](auto&& handler, auto&& initiation, auto&&... args) {
+                using HandlerType = std::decay_t<decltype(handler)>;
+                std::forward<decltype(initiation)>(initiation)(
+                    AllocatingHandler<HandlerType>(std::forward<decltype(handler)>(handler), memory),
+                    std::forward<decltype(args)>(args)...);
+            },
+            bound.token, std::forward<Initiation>(initiation), std::forward<Args>(args)...);
+    }
+};
+
+// 操作状态从块缓存分配的完成处理器，用于投递到其他线程的处理器和定时器这类
+// 不宜把内存放在发起方对象里的操作；在其他线程完成时内存挂回发起方线程，
+// 稳定运行时不调用 operator new。用法：asio::post(io_context, pooled(handler))
+template <typename Handler>
+class PooledHandler {
+public:
+    using allocator_type = PoolAllocator<void>;
+
+    explicit PooledHandler(Handler handler) : handler_(std::move(handler)) {}
+
+    allocator_type get_allocator() const noexcept { return allocator_type(); }
+
+    template <typename... Args>
+    void operator()(Args&&... args)
+    {
+        handler_(std::forward<Args>(args)...);
+    }
+
+private:
+    Handler handler_;
+};
+
+template <typename Handler>
+PooledHandler<std::decay_t<Handler>> pooled(Handler&& handler)
+{
+    return PooledHandler<std::decay_t<Handler>>(std::forward<Handler>(handler));
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <asio.hpp>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "handler_memory.hpp"
+
+class ChatSession;
+
+// 心跳时间轮：每个事件循环一个，用单个定时器按槽批量检查该循环上所有会话的心跳截止时间。
+// 收到消息只更新会话的 lastHeartbeat_（O(1)），到期时才惰性地重新挂到新截止时间所在的槽。
+// Session 需提供 getHeartbeatDeadline()、isClosed() 和 onHeartbeatTimeout()
+template <typename Session>
+class BasicHeartbeatWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    BasicHeartbeatWheel(asio::io_context& io_context, Clock::duration tick, std::size_t slotCount)
+        : timer_(io_context)
+        , tick_(tick)
+        , slots_(std::max<std::size_t>(slotCount, 2))
+        , currentTime_(Clock::now())
+    {
+    }
+
+    // 可在任意线程调用；第一次等待也在所属事件循环上发起，定时器操作的内存一直由该线程回收
+    void start()
+    {
+        asio::post(timer_.get_executor(), [this]() {
+            currentTime_ = Clock::now();
+            scheduleTick();
+        });
+    }
+
+    void stop()
+    {
+        timer_.cancel();
+    }
+
+    // 以下方法必须在所属事件循环线程上调用
+    void add(const std::shared_ptr<Session>& session)
+    {
+        insert(session, session->getHeartbeatDeadline());
+    }
+
+    std::size_t size() const { return size_; }
+
+    // 推进一个槽并检查其中的会话，由定时器调用；基准测试也直接调用以单独计量检查开销
+    void onTick()
+    {
+        current_ = (current_ + 1) % slots_.size();
+        currentTime_ += tick_;
+
+        // 先把整个槽换出来，处理过程中重新挂入的会话不会落回当前槽
+        expiring_.swap(slots_[current_]);
+        size_ -= expiring_.size();
+
+        auto now = Clock::now();
+        for (auto& weak : expiring_) {
+            auto session = weak.lock();
+            if (!session || session->isClosed()) {
+                continue;
+            }
+            auto deadline = session->getHeartbeatDeadline();
+            if (deadline <= now) {
+                session->onHeartbeatTimeout();
+            } else {
+                insert(std::move(weak), deadline);
+            }
+        }
+        expiring_.clear();
+    }
+
+private:
+    void insert(std::weak_ptr<Session> session, Clock::time_point deadline)
+    {
+        // 向上取整到槽；超出轮跨度的截止时间放在最远的槽，到时再重新计算
+        auto delta = deadline - currentTime_;
+        std::size_t ticks = delta <= Clock::duration::zero()
+            ? 1
+            : static_cast<std::size_t>((delta + tick_ - Clock::duration(1)) / tick_);
+        ticks = std::clamp<std::size_t>(ticks, 1, slots_.size() - 1);
+
+        slots_[(current_ + ticks) % slots_.size()].push_back(std::move(session));
+        ++size_;
+    }
+
+    void scheduleTick()
+    {
+        // 按绝对时间推进，避免回调延迟累积成漂移
+        timer_.expires_at(currentTime_ + tick_);
+        // 定时器销毁时未完成的等待操作还留在 io_context 里，操作状态不能放在本对象中
+        timer_.async_wait(pooled([this](const asio::error_code& ec) {
+            if (!ec) {
+                onTick();
+                scheduleTick();
+            }
+        }));
+    }
+
+    asio::steady_timer timer_;
+    Clock::duration tick_;
+    std::vector<std::vector<std::weak_ptr<Session>>> slots_;
+    std::vector<std::weak_ptr<Session>> expiring_;
+    std::size_t current_{0};
+    Clock::time_point currentTime_;   // 当前槽对应的时间
+    std::size_t size_{0};
+};
+
+using HeartbeatWheel = BasicHeartbeatWheel<ChatSession>;
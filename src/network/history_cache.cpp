@@ -0,0 +1,67 @@
+#include "history_cache.hpp"
+#include <algorithm>
+#include <functional>
+
+HistoryCache::HistoryCache(std::size_t capacityPerRoom, std::size_t maxRooms)
+    : capacity_(std::max<std::size_t>(capacityPerRoom, 1))
+    , maxRoomsPerStripe_(std::max<std::size_t>(maxRooms / STRIPE_COUNT, 1))
+{
+}
+
+void HistoryCache::append(std::string_view room, SharedOutbound frame)
+{
+    auto& stripe = stripeFor(room);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+
+    auto it = stripe.rings.find(room);
+    if (it == stripe.rings.end()) {
+        // 房间过多时淘汰任意一个房间的缓存，更早的历史仍可从数据库读取
+        if (stripe.rings.size() >= maxRoomsPerStripe_) {
+            stripe.rings.erase(stripe.rings.begin());
+        }
+        it = stripe.rings.emplace(std::string(room), Ring{}).first;
+        it->second.frames.reserve(capacity_);
+    }
+
+    auto& ring = it->second;
+    if (ring.frames.size() < capacity_) {
+        ring.frames.push_back(std::move(frame));
+    } else {
+        ring.frames[ring.next] = std::move(frame);
+    }
+    ring.next = (ring.next + 1) % capacity_;
+}
+
+std::vector<SharedOutbound> HistoryCache::recent(const std::string& room, std::size_t limit) const
+{
+    std::vector<SharedOutbound> result;
+    const auto& stripe = stripeFor(room);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+
+    auto it = stripe.rings.find(room);
+    if (it == stripe.rings.end()) {
+        return result;
+    }
+
+    const auto& ring = it->second;
+    std::size_t count = std::min(limit, ring.frames.size());
+    result.reserve(count);
+
+    // 未写满时 next 之前就是全部数据；写满后 next 指向最旧的一条
+    std::size_t size = ring.frames.size();
+    std::size_t start = (ring.next + size - count) % size;
+    for (std::size_t i = 0; i < count; ++i) {
+        result.push_back(ring.frames[(start + i) % size]);
+    }
+    return result;
+}
+
+const HistoryCache::Stripe& HistoryCache::stripeFor(std::string_view room) const
+{
+    return stripes_[StringHash{}(room) % STRIPE_COUNT];
+}
+
+HistoryCache::Stripe& HistoryCache::stripeFor(std::string_view room)
+{
+    return stripes_[StringHash{}(room) % STRIPE_COUNT];
+}
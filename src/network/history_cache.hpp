@@ -0,0 +1,44 @@
+#pragma once
+#include <array>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "outbound_message.hpp"
+#include "string_hash.hpp"
+
+// 每个房间最近若干条消息的环形缓存，保存的是共享的待发送消息及其已编码的帧，
+// 新会话加入时直接重放，不访问数据库。按房间名哈希分段加锁，不同房间互不竞争
+class HistoryCache {
+public:
+    explicit HistoryCache(std::size_t capacityPerRoom = 50, std::size_t maxRooms = 100000);
+
+    // 全局聊天的房间名为空字符串
+    void append(std::string_view room, SharedOutbound frame);
+
+    // 按从旧到新的顺序返回最近 limit 条
+    std::vector<SharedOutbound> recent(const std::string& room, std::size_t limit) const;
+
+    std::size_t capacity() const { return capacity_; }
+
+private:
+    struct Ring {
+        std::vector<SharedOutbound> frames;
+        std::size_t next{0};   // 下一个写入位置
+    };
+
+    struct Stripe {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, Ring, StringHash, std::equal_to<>> rings;
+    };
+
+    static constexpr std::size_t STRIPE_COUNT = 64;
+
+    const Stripe& stripeFor(std::string_view room) const;
+    Stripe& stripeFor(std::string_view room);
+
+    std::size_t capacity_;
+    std::size_t maxRoomsPerStripe_;
+    std::array<Stripe, STRIPE_COUNT> stripes_;
+};
@@ -0,0 +1,100 @@
+#include "io_context_pool.hpp"
+#include <stdexcept>
+
+IoContextPool::IoContextPool(std::size_t poolSize, Strategy strategy)
+    : strategy_(strategy)
+{
+    if (poolSize == 0) {
+        throw std::invalid_argument("IoContextPool size must be greater than 0");
+    }
+
+    for (std::size_t i = 0; i < poolSize; ++i) {
+        loops_.push_back(std::make_unique<Loop>());
+    }
+}
+
+IoContextPool::~IoContextPool()
+{
+    stop();
+    for (auto& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void IoContextPool::run()
+{
+    // 第一个循环在调用线程上运行，其余各起一个线程
+    for (std::size_t i = 1; i < loops_.size(); ++i) {
+        threads_.emplace_back([this, i]() {
+            loops_[i]->io_context.run();
+        });
+    }
+
+    loops_[0]->io_context.run();
+
+    for (auto& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    threads_.clear();
+}
+
+void IoContextPool::stop()
+{
+    for (auto& loop : loops_) {
+        loop->work.reset();
+        loop->io_context.stop();
+    }
+}
+
+std::size_t IoContextPool::acquire()
+{
+    std::size_t index = 0;
+
+    if (strategy_ == Strategy::LeastLoad) {
+        // 负载只是近似值，并发接入时允许少量偏差
+        std::size_t minLoad = loops_[0]->load.load(std::memory_order_relaxed);
+        for (std::size_t i = 1; i < loops_.size(); ++i) {
+            std::size_t load = loops_[i]->load.load(std::memory_order_relaxed);
+            if (load < minLoad) {
+                minLoad = load;
+                index = i;
+            }
+        }
+    } else {
+        index = nextLoop_.fetch_add(1, std::memory_order_relaxed) % loops_.size();
+    }
+
+    loops_[index]->load.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+void IoContextPool::release(std::size_t index)
+{
+    loops_[index]->load.fetch_sub(1, std::memory_order_relaxed);
+}
+
+std::size_t IoContextPool::getLoad(std::size_t index) const
+{
+    return loops_[index]->load.load(std::memory_order_relaxed);
+}
+
+const char* IoContextPool::getBackendName()
+{
+#if defined(ASIO_HAS_IO_URING_AS_DEFAULT)
+    return "io_uring";
+#elif defined(ASIO_HAS_IOCP)
+    return "iocp";
+#elif defined(ASIO_HAS_EPOLL)
+    return "epoll";
+#elif defined(ASIO_HAS_KQUEUE)
+    return "kqueue";
+#elif defined(ASIO_HAS_DEV_POLL)
+    return "/dev/poll";
+#else
+    return "select";
+#endif
+}
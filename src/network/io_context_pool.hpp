@@ -0,0 +1,50 @@
+#pragma once
+#include <asio.hpp>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// 事件循环池：每个 io_context 由一个线程独占运行，连接按策略分配到某个循环上
+class IoContextPool {
+public:
+    enum class Strategy {
+        RoundRobin,  // 轮询分配
+        LeastLoad    // 分配给当前连接数最少的循环
+    };
+
+    explicit IoContextPool(std::size_t poolSize, Strategy strategy = Strategy::RoundRobin);
+    ~IoContextPool();
+
+    IoContextPool(const IoContextPool&) = delete;
+    IoContextPool& operator=(const IoContextPool&) = delete;
+
+    // 启动所有线程并阻塞直到全部循环退出
+    void run();
+    void stop();
+
+    std::size_t size() const { return loops_.size(); }
+    asio::io_context& getIoContext(std::size_t index) { return loops_[index]->io_context; }
+
+    // 为新连接选择一个循环并计入负载，连接关闭时需调用 release
+    std::size_t acquire();
+    void release(std::size_t index);
+    std::size_t getLoad(std::size_t index) const;
+
+    // 编译时选定的 asio 反应器后端名称，如 epoll、io_uring、iocp
+    static const char* getBackendName();
+
+private:
+    struct Loop {
+        Loop() : work(asio::make_work_guard(io_context)) {}
+
+        asio::io_context io_context{1};
+        asio::executor_work_guard<asio::io_context::executor_type> work;
+        std::atomic<std::size_t> load{0};
+    };
+
+    std::vector<std::unique_ptr<Loop>> loops_;
+    std::vector<std::thread> threads_;
+    Strategy strategy_;
+    std::atomic<std::size_t> nextLoop_{0};
+};
@@ -0,0 +1,50 @@
+#include "link_quality.hpp"
+#include <charconv>
+
+std::string HeartbeatProbe::encode(Origin origin, uint64_t micros)
+{
+    std::string content(1, static_cast<char>(origin));
+    content.append(std::to_string(micros));
+    return content;
+}
+
+bool HeartbeatProbe::parse(std::string_view content, Origin& origin, uint64_t& micros)
+{
+    if (content.size() < 2) {
+        return false;
+    }
+    if (content[0] != static_cast<char>(Origin::Client) && content[0] != static_cast<char>(Origin::Server)) {
+        return false;
+    }
+
+    const char* end = content.data() + content.size();
+    auto result = std::from_chars(content.data() + 1, end, micros);
+    if (result.ec != std::errc() || result.ptr != end) {
+        return false;
+    }
+    origin = static_cast<Origin>(content[0]);
+    return true;
+}
+
+uint64_t HeartbeatProbe::nowMicros()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void RttEstimator::addSample(std::chrono::microseconds rtt)
+{
+    if (samples_ == 0) {
+        quality_.smoothed = rtt;
+        quality_.jitter = std::chrono::microseconds(0);
+    } else {
+        auto delta = rtt - quality_.latest;
+        if (delta.count() < 0) {
+            delta = -delta;
+        }
+        quality_.jitter += (delta - quality_.jitter) / 16;
+        quality_.smoothed += (rtt - quality_.smoothed) / 8;
+    }
+    quality_.latest = rtt;
+    ++samples_;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// 心跳探测：HEARTBEAT 的内容为 "<发起方><发起方时钟的微秒数>"，发起方 'c' 为客户端、's' 为服务器。
+// 收到对方发起的探测原样回显，收到自己发起的探测的回显即得到一次往返时间。
+// 时间戳只由发起方解读，两端时钟不需要同步；内容为空的旧式心跳只表示连接存活
+class HeartbeatProbe {
+public:
+    enum class Origin : char {
+        Client = 'c',
+        Server = 's'
+    };
+
+    static std::string encode(Origin origin, uint64_t micros);
+    // 内容为空或格式不对时返回 false
+    static bool parse(std::string_view content, Origin& origin, uint64_t& micros);
+
+    // 本机单调时钟的微秒数，用作探测时间戳
+    static uint64_t nowMicros();
+};
+
+// 一个连接的链路质量
+struct LinkQuality {
+    std::chrono::microseconds latest{0};    // 最近一次往返时间
+    std::chrono::microseconds smoothed{0};  // 平滑往返时间（SRTT）
+    std::chrono::microseconds jitter{0};    // 相邻两次往返时间之差的平滑值
+};
+
+// 按 RFC 6298 平滑往返时间（增益 1/8），按 RFC 3550 平滑抖动（增益 1/16）
+class RttEstimator {
+public:
+    void addSample(std::chrono::microseconds rtt);
+    void reset() { *this = RttEstimator{}; }
+
+    bool hasSample() const { return samples_ > 0; }
+    uint64_t getSampleCount() const { return samples_; }
+    const LinkQuality& getQuality() const { return quality_; }
+
+private:
+    LinkQuality quality_;
+    uint64_t samples_{0};
+};
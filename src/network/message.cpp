@@ -1,56 +1,256 @@
 #include "message.hpp"
+#include "buffer_pool.hpp"
+#include "compression.hpp"
+#include "message_view.hpp"
+#include <cstdint>
 #include <cstring>
+#include <stdexcept>
 
 Message::Message() : type_(Type::TEXT) {}
 
 Message::Message(Type type) : type_(type) {}
 
-std::vector<uint8_t> Message::encode() const {
-    // 消息格式: [类型(1字节)][发送者长度(2字节)][发送者][内容长度(4字节)][内容]
+bool Message::hasTarget(Type type) {
+    switch (type) {
+    case Type::JOIN_ROOM:
+    case Type::LEAVE_ROOM:
+    case Type::ROOM_TEXT:
+    case Type::HISTORY_REQUEST:
+    case Type::HISTORY_BEGIN:
+    case Type::HISTORY_END:
+    case Type::PRIVATE:
+    case Type::PRIVATE_STATUS:
+    case Type::FILE_BEGIN:
+    case Type::FILE_CHUNK:
+    case Type::FILE_CREDIT:
+    case Type::FILE_END:
+    case Type::FILE_ABORT:
+    case Type::FILE_AVAILABLE:
+    case Type::FILE_REQUEST:
+        return true;
+    default:
+        return false;
+    }
+}
+
+namespace {
+
+std::size_t varintSize(uint64_t value) {
+    std::size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+void putVarint(std::vector<uint8_t>& data, uint64_t value) {
+    while (value >= 0x80) {
+        data.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    data.push_back(static_cast<uint8_t>(value));
+}
+
+void putString(std::vector<uint8_t>& data, std::string_view str) {
+    putVarint(data, str.size());
+    data.insert(data.end(), str.begin(), str.end());
+}
+
+} // namespace
+
+Message::Header Message::header() const {
+    return {type_, sender_, target_, sequence_, timestamp_};
+}
+
+std::vector<uint8_t> Message::encode(uint8_t version) const {
     std::vector<uint8_t> data;
+    auto fields = header();
+    data.reserve(encodedSize(fields, content_.size(), version));
+    encodeInto(data, fields, content_, false, version);
+    return data;
+}
+
+SharedFrame Message::encodeFrame(const Header& fields, std::string_view content, bool compressed,
+                                 uint8_t version) {
+    // 按精确长度从当前线程的缓冲区池取缓冲区，编码过程中不会再扩容
+    auto data = BufferPool::acquireLocal(encodedSize(fields, content.size(), version));
+    encodeInto(data, fields, content, compressed, version);
+    return BufferPool::share(std::move(data));
+}
+
+void Message::encodeInto(std::vector<uint8_t>& data, const Header& fields, std::string_view content,
+                         bool compressed, uint8_t version) {
+    if (version >= 2) {
+        encodeV2(data, fields, content, content.size(), compressed);
+    } else {
+        encodeV1(data, fields, content, content.size(), compressed);
+    }
+}
+
+std::vector<uint8_t> Message::encodeHeader(std::size_t contentSize, uint8_t version) const {
+    std::vector<uint8_t> data;
+    auto fields = header();
+    data.reserve(encodedSize(fields, contentSize, version) - contentSize);
+    if (version >= 2) {
+        encodeV2(data, fields, {}, contentSize, false);
+    } else {
+        encodeV1(data, fields, {}, contentSize, false);
+    }
+    return data;
+}
+
+std::size_t Message::encodedSize(const Header& fields, std::size_t contentSize, uint8_t version) {
+    if (version >= 2) {
+        std::size_t bodyLen = v2BodySize(fields, contentSize);
+        return 1 + varintSize(bodyLen) + bodyLen;
+    }
+    return 1 + 2 + fields.sender.size() + (hasTarget(fields.type) ? 2 + fields.target.size() : 0) + 4 + contentSize;
+}
+
+std::size_t Message::v2BodySize(const Header& fields, std::size_t contentSize) {
+    return 1
+        + varintSize(fields.sender.size()) + fields.sender.size()
+        + varintSize(fields.target.size()) + fields.target.size()
+        + varintSize(fields.sequence) + varintSize(fields.timestamp)
+        + varintSize(contentSize) + contentSize;
+}
+
+void Message::encodeV1(std::vector<uint8_t>& data, const Header& fields, std::string_view content,
+                       std::size_t contentSize, bool compressed) {
+    // 消息格式: [类型(1字节)][发送者长度(2字节)][发送者][内容长度(4字节)][内容]
+    // 带 target 的类型在内容长度之前插入: [目标长度(2字节)][目标]
     
+    // 长度字段只有两字节，截断后长度与实际字节不符，整条流都会错位
+    if (fields.sender.length() > UINT16_MAX || (hasTarget(fields.type) && fields.target.length() > UINT16_MAX)) {
+        throw std::length_error("v1 消息的 sender 或 target 超过 65535 字节");
+    }
+
     // 添加消息类型
-    data.push_back(static_cast<uint8_t>(type_));
+    uint8_t type = static_cast<uint8_t>(fields.type);
+    data.push_back(compressed ? (type | COMPRESSED_FLAG) : type);
     
     // 添加发送者
-    uint16_t senderLen = static_cast<uint16_t>(sender_.length());
+    uint16_t senderLen = static_cast<uint16_t>(fields.sender.length());
     data.push_back(senderLen & 0xFF);
     data.push_back((senderLen >> 8) & 0xFF);
-    data.insert(data.end(), sender_.begin(), sender_.end());
+    data.insert(data.end(), fields.sender.begin(), fields.sender.end());
+    
+    // 添加目标（房间名等）
+    if (hasTarget(fields.type)) {
+        uint16_t targetLen = static_cast<uint16_t>(fields.target.length());
+        data.push_back(targetLen & 0xFF);
+        data.push_back((targetLen >> 8) & 0xFF);
+        data.insert(data.end(), fields.target.begin(), fields.target.end());
+    }
     
     // 添加内容
-    uint32_t contentLen = static_cast<uint32_t>(content_.length());
+    uint32_t contentLen = static_cast<uint32_t>(contentSize);
     data.push_back(contentLen & 0xFF);
     data.push_back((contentLen >> 8) & 0xFF);
     data.push_back((contentLen >> 16) & 0xFF);
     data.push_back((contentLen >> 24) & 0xFF);
-    data.insert(data.end(), content_.begin(), content_.end());
-    
-    return data;
+    data.insert(data.end(), content.begin(), content.end());
+}
+
+void Message::encodeV2(std::vector<uint8_t>& data, const Header& fields, std::string_view content,
+                       std::size_t contentSize, bool compressed) {
+    // 消息格式: [0xF2][帧体长度(varint)][帧体]
+    // 帧体: [类型(1字节)][发送者长度(varint)][发送者][目标长度(varint)][目标]
+    //       [序号(varint)][时间戳(varint)][内容长度(varint)][内容]
+    // 解码时忽略内容之后多出的字节，以后可以在末尾追加字段
+    data.push_back(V2_MARKER);
+    putVarint(data, v2BodySize(fields, contentSize));
+
+    uint8_t type = static_cast<uint8_t>(fields.type);
+    data.push_back(compressed ? (type | COMPRESSED_FLAG) : type);
+    putString(data, fields.sender);
+    putString(data, fields.target);
+    putVarint(data, fields.sequence);
+    putVarint(data, fields.timestamp);
+    putVarint(data, contentSize);
+    data.insert(data.end(), content.begin(), content.end());
+}
+
+SharedFrame Message::encodeShared(uint8_t version) const {
+    return encodeFrame(header(), content_, false, version);
+}
+
+SharedFrame Message::encodeCompressed(uint8_t version) const {
+    std::string compressed;
+    if (!Compression::compress(content_, compressed)) {
+        return nullptr;
+    }
+    return encodeFrame(header(), compressed, true, version);
 }
 
 std::shared_ptr<Message> Message::decode(const std::vector<uint8_t>& data) {
-    if (data.size() < 7) return nullptr; // 最小消息长度
-    
+    return decode(data.data(), data.size());
+}
+
+std::shared_ptr<Message> Message::decode(const uint8_t* data, std::size_t size) {
+    MessageView view;
+    if (!view.parse({data, size})) return nullptr;
+
     auto msg = std::make_shared<Message>();
-    size_t pos = 0;
+    if (!view.toMessage(*msg)) return nullptr;
+    return msg;
+}
+
+bool Message::assignContent(const uint8_t* data, std::size_t size, bool compressed) {
+    if (compressed) {
+        return Compression::decompress(data, size, content_);
+    }
+    content_.assign(data, data + size);
+    return true;
+}
+
+std::size_t Message::frameSize(const uint8_t* data, std::size_t size) {
+    if (size < 3) return 0;
+
+    if (data[0] == V2_MARKER) {
+        // 帧体长度最多 10 字节 varint
+        uint64_t bodyLen = 0;
+        std::size_t pos = 1;
+        for (int shift = 0; ; shift += 7) {
+            if (shift >= 64) return SIZE_MAX;
+            if (pos >= size) return 0;
+            uint8_t byte = data[pos++];
+            bodyLen |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) break;
+        }
+        if (bodyLen > SIZE_MAX - pos) return SIZE_MAX;
+        return pos + static_cast<std::size_t>(bodyLen);
+    }
     
-    // 读取类型
-    msg->type_ = static_cast<Type>(data[pos++]);
+    std::size_t senderLen = data[1] | (data[2] << 8);
+    std::size_t contentLenPos = 3 + senderLen;
     
-    // 读取发送者
-    uint16_t senderLen = data[pos] | (data[pos + 1] << 8);
-    pos += 2;
-    msg->sender_.assign(data.begin() + pos, data.begin() + pos + senderLen);
-    pos += senderLen;
+    if (hasTarget(static_cast<Type>(data[0] & ~COMPRESSED_FLAG))) {
+        if (size < contentLenPos + 2) return 0;
+        std::size_t targetLen = data[contentLenPos] | (data[contentLenPos + 1] << 8);
+        contentLenPos += 2 + targetLen;
+    }
     
-    // 读取内容
-    uint32_t contentLen = data[pos] | (data[pos + 1] << 8) | 
-                         (data[pos + 2] << 16) | (data[pos + 3] << 24);
-    pos += 4;
-    msg->content_.assign(data.begin() + pos, data.begin() + pos + contentLen);
+    if (size < contentLenPos + 4) return 0;
     
-    return msg;
+    const uint8_t* p = data + contentLenPos;
+    uint32_t contentLen = p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    return contentLenPos + 4 + contentLen;
+}
+
+bool Message::hasCapability(std::string_view capabilities, std::string_view name) {
+    while (!capabilities.empty()) {
+        auto comma = capabilities.find(',');
+        if (capabilities.substr(0, comma) == name) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        capabilities.remove_prefix(comma + 1);
+    }
+    return false;
 }
 
 void Message::setContent(const std::string& content) {
@@ -61,6 +261,10 @@ void Message::setSender(const std::string& sender) {
     sender_ = sender;
 }
 
+void Message::setTarget(const std::string& target) {
+    target_ = target;
+}
+
 Message::Type Message::getType() const {
     return type_;
 }
@@ -71,4 +275,8 @@ const std::string& Message::getContent() const {
 
 const std::string& Message::getSender() const {
     return sender_;
-} 
\ No newline at end of file
+}
+
+const std::string& Message::getTarget() const {
+    return target_;
+}
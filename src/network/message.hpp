@@ -1,36 +1,142 @@
 #pragma once
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 
+// 编码后的不可变帧，广播时所有接收方共享同一份缓冲区
+using SharedFrame = std::shared_ptr<const std::vector<uint8_t>>;
+
+// 发给某个连接时使用的帧格式，由连接建立时的能力协商决定
+struct FrameFormat {
+    uint8_t version{1};
+    bool compression{false};
+};
+
 class Message {
 public:
     enum class Type : uint8_t {
         TEXT,       // 文本消息
         JOIN,       // 加入聊天
         LEAVE,      // 离开聊天
-        USER_LIST,  // 用户列表
-        HEARTBEAT   // 心跳消息
+        USER_LIST,  // 用户列表全量快照；客户端发送空的 USER_LIST 表示请求快照
+        HEARTBEAT,  // 心跳消息
+        JOIN_ROOM,  // 加入房间，target 为房间名
+        LEAVE_ROOM, // 离开房间，target 为房间名
+        ROOM_TEXT,  // 房间内文本消息，target 为房间名
+        USER_LIST_DELTA, // 在线用户增量变化
+        HISTORY_REQUEST, // 请求历史消息，target 为房间名（全局为空），content 为条数
+        HISTORY_BEGIN,   // 历史消息重放开始，target 为房间名
+        HISTORY_END,     // 历史消息重放结束，target 为房间名，content 为条数
+        CAPABILITIES,    // 能力协商，content 为逗号分隔的能力列表；服务器回复双方都支持的部分
+        // 以下只用于服务器之间的联邦链路，客户端连接上收到时忽略
+        PEER_HELLO,      // 链路握手，sender 为节点名
+        PEER_RELAY,      // 转发的聊天消息，sender 为来源节点，sequence 为来源节点的转发序号，
+                         // timestamp 为来源节点发出时刻（Unix 微秒），content 为原消息的 v2 帧
+        PEER_PRESENCE,   // 来源节点本地在线用户，target 为 "snapshot" 或 "delta"，
+                         // content 同 USER_LIST/USER_LIST_DELTA
+        PRIVATE,         // 私聊消息，target 为接收方用户名；只投递给接收方和发送方的其他会话
+        PRIVATE_STATUS,  // 私聊未能立即投递，只发给发送方：target 为接收方，content 为 "offline"
+                         // （已存为离线消息）、"rejected"（离线信箱已满）或 "invalid"（接收方为空或
+                         // sender 不是会话本人，未投递）
+        // 文件传输：文件按块流式传输，不占用聊天消息的内容长度，也不会整个进入内存
+        FILE_BEGIN,      // 开始上传，target 为接收方（空表示所有人），content 为 "<传输编号>\n<字节数>\n<文件名>"；
+                         // 服务器开始发送下载时 target 为文件编号，content 为 "<文件编号>\n<字节数>\n<文件名>"
+        FILE_CHUNK,      // 文件数据块，target 为传输编号（上传）或文件编号（下载），content 为原始字节
+        FILE_CREDIT,     // 服务器允许上传的累计字节数，target 为传输编号
+        FILE_END,        // 传输结束：客户端上传完毕时 target 为传输编号；服务器确认上传时
+                         // target 为传输编号、content 为文件编号；下载结束时 target 为文件编号
+        FILE_ABORT,      // 传输失败或取消，target 为传输编号或文件编号，content 为原因
+        FILE_AVAILABLE,  // 有可下载的文件，sender 为上传者，target 为接收方（空表示所有人），
+                         // content 为 "<文件编号>\n<字节数>\n<文件名>"
+        FILE_REQUEST     // 请求下载，target 为文件编号
     };
 
+    // 类型字节的最高位表示内容经过压缩
+    static constexpr uint8_t COMPRESSED_FLAG = 0x80;
+
+    // v2 帧以该字节开头，它不是任何 v1 类型字节，因此两种格式可以逐帧区分
+    static constexpr uint8_t V2_MARKER = 0xF2;
+    static constexpr std::string_view V2_CAPABILITY = "v2";
+
+    // sender 和 target 的长度上限，远低于 v1 两字节长度字段能表示的 65535；
+    // 解码时超出上限的帧视为非法
+    static constexpr std::size_t MAX_FIELD_SIZE = 1024;
+
     Message();
     explicit Message(Type type);
 
-    // 编码解码方法
-    std::vector<uint8_t> encode() const;
+    // 编码解码方法；解码自动识别 v1 和 v2 帧。
+    // 只需要查看字段或转发原始字节时用 MessageView，不必构造 Message
+    std::vector<uint8_t> encode(uint8_t version = 1) const;
+    SharedFrame encodeShared(uint8_t version = 1) const;
+    // 只编码到内容长度字段为止，内容的 contentSize 字节由调用方紧接着写出，
+    // 用于直接从文件发送内容（sendfile）或把文件读进帧缓冲区
+    std::vector<uint8_t> encodeHeader(std::size_t contentSize, uint8_t version = 1) const;
+    // 内容不足压缩阈值或压缩没有收益时返回空
+    SharedFrame encodeCompressed(uint8_t version = 1) const;
     static std::shared_ptr<Message> decode(const std::vector<uint8_t>& data);
+    static std::shared_ptr<Message> decode(const uint8_t* data, std::size_t size);
+
+    // 根据帧头计算整帧长度；帧头还不完整时返回 0（返回值可能大于 size），
+    // 长度字段非法时返回 SIZE_MAX
+    static std::size_t frameSize(const uint8_t* data, std::size_t size);
+
+    // 该类型的 v1 帧是否带有 target 字段（v2 帧总是带有）
+    static bool hasTarget(Type type);
+
+    // capabilities 为逗号分隔的能力列表
+    static bool hasCapability(std::string_view capabilities, std::string_view name);
 
     // 设置获取消息内容
     void setContent(const std::string& content);
     void setSender(const std::string& sender);
-    
+    void setTarget(const std::string& target);
+    // 服务器分配的序号和时间戳（Unix 毫秒），只在 v2 帧中传输，未分配时为 0
+    void setSequence(uint64_t sequence) { sequence_ = sequence; }
+    void setTimestamp(uint64_t timestamp) { timestamp_ = timestamp; }
+
     Type getType() const;
     const std::string& getContent() const;
     const std::string& getSender() const;
+    const std::string& getTarget() const;
+    uint64_t getSequence() const { return sequence_; }
+    uint64_t getTimestamp() const { return timestamp_; }
 
 private:
+    friend class OutboundMessage;
+    friend class MessageView;
+
+    // 内容以外的字段。编码只读取这些字段，转发收到的帧时由指向原始字节的视图填充，不必构造 Message
+    struct Header {
+        Type type;
+        std::string_view sender;
+        std::string_view target;
+        uint64_t sequence;
+        uint64_t timestamp;
+    };
+    Header header() const;
+
+    // 编码到池化的缓冲区并包装成共享帧
+    static SharedFrame encodeFrame(const Header& fields, std::string_view content, bool compressed,
+                                   uint8_t version);
+    static void encodeInto(std::vector<uint8_t>& data, const Header& fields, std::string_view content,
+                           bool compressed, uint8_t version);
+    // 内容长度为 contentSize 时整帧的精确长度，用于预分配
+    static std::size_t encodedSize(const Header& fields, std::size_t contentSize, uint8_t version);
+    static std::size_t v2BodySize(const Header& fields, std::size_t contentSize);
+    // 内容长度字段写 contentSize，随后只追加 content（encodeHeader 时为空）
+    static void encodeV1(std::vector<uint8_t>& data, const Header& fields, std::string_view content,
+                         std::size_t contentSize, bool compressed);
+    static void encodeV2(std::vector<uint8_t>& data, const Header& fields, std::string_view content,
+                         std::size_t contentSize, bool compressed);
+    bool assignContent(const uint8_t* data, std::size_t size, bool compressed);
+
     Type type_;
     std::string content_;
     std::string sender_;
-}; 
\ No newline at end of file
+    std::string target_;
+    uint64_t sequence_{0};
+    uint64_t timestamp_{0};
+};
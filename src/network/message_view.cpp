@@ -0,0 +1,119 @@
+#include "message_view.hpp"
+#include "compression.hpp"
+
+namespace {
+
+std::string_view asString(const uint8_t* data, std::size_t size)
+{
+    return {reinterpret_cast<const char*>(data), size};
+}
+
+// 数据不足或超过 10 字节时返回 false
+bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 只用于 sender 和 target，长度超过 MAX_FIELD_SIZE 时返回 false
+bool getField(const uint8_t*& p, const uint8_t* end, std::string_view& str)
+{
+    uint64_t len = 0;
+    if (!getVarint(p, end, len) || len > Message::MAX_FIELD_SIZE || len > static_cast<uint64_t>(end - p)) {
+        return false;
+    }
+    str = asString(p, static_cast<std::size_t>(len));
+    p += len;
+    return true;
+}
+
+} // namespace
+
+bool MessageView::parse(std::span<const uint8_t> data)
+{
+    // 长度字段不可信，整帧必须完整落在缓冲区内
+    std::size_t total = Message::frameSize(data.data(), data.size());
+    if (total == 0 || total > data.size()) {
+        return false;
+    }
+
+    frame_ = data.first(total);
+    sequence_ = 0;
+    timestamp_ = 0;
+    target_ = {};
+    return frame_[0] == Message::V2_MARKER ? parseV2() : parseV1();
+}
+
+bool MessageView::parseV1()
+{
+    // frameSize 已保证各长度字段与帧长一致
+    if (frame_.size() < 7) return false; // 最小消息长度
+
+    const uint8_t* data = frame_.data();
+    std::size_t pos = 0;
+
+    version_ = 1;
+    compressed_ = (data[pos] & Message::COMPRESSED_FLAG) != 0;
+    type_ = static_cast<Message::Type>(data[pos++] & ~Message::COMPRESSED_FLAG);
+
+    std::size_t senderLen = data[pos] | (data[pos + 1] << 8);
+    if (senderLen > Message::MAX_FIELD_SIZE) return false;
+    pos += 2;
+    sender_ = asString(data + pos, senderLen);
+    pos += senderLen;
+
+    if (Message::hasTarget(type_)) {
+        std::size_t targetLen = data[pos] | (data[pos + 1] << 8);
+        if (targetLen > Message::MAX_FIELD_SIZE) return false;
+        pos += 2;
+        target_ = asString(data + pos, targetLen);
+        pos += targetLen;
+    }
+
+    pos += 4;
+    content_ = asString(data + pos, frame_.size() - pos);
+    return true;
+}
+
+bool MessageView::parseV2()
+{
+    const uint8_t* p = frame_.data() + 1;
+    const uint8_t* end = frame_.data() + frame_.size();
+
+    // frameSize 已校验过帧体长度，这里跳过即可
+    uint64_t bodyLen = 0;
+    if (!getVarint(p, end, bodyLen) || p == end) return false;
+
+    version_ = 2;
+    compressed_ = (*p & Message::COMPRESSED_FLAG) != 0;
+    type_ = static_cast<Message::Type>(*p++ & ~Message::COMPRESSED_FLAG);
+
+    uint64_t contentLen = 0;
+    if (!getField(p, end, sender_) ||
+        !getField(p, end, target_) ||
+        !getVarint(p, end, sequence_) ||
+        !getVarint(p, end, timestamp_) ||
+        !getVarint(p, end, contentLen) ||
+        contentLen > static_cast<uint64_t>(end - p)) {
+        return false;
+    }
+    content_ = asString(p, static_cast<std::size_t>(contentLen));
+    return true;
+}
+
+bool MessageView::toMessage(Message& msg) const
+{
+    msg.type_ = type_;
+    msg.sender_.assign(sender_);
+    msg.target_.assign(target_);
+    msg.sequence_ = sequence_;
+    msg.timestamp_ = timestamp_;
+    return msg.assignContent(reinterpret_cast<const uint8_t*>(content_.data()), content_.size(), compressed_);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include "message.hpp"
+
+// 指向一个已接收帧的非拥有视图：解析时只校验边界、记录各字段的位置，
+// 不分配内存也不复制数据。视图只在底层缓冲区有效期间可用，
+// 对 FrameDecoder 来说就是帧回调执行期间
+class MessageView {
+public:
+    // 识别 v1 和 v2 帧；帧不完整或字段越界时返回 false
+    bool parse(std::span<const uint8_t> data);
+
+    uint8_t getVersion() const { return version_; }
+    Message::Type getType() const { return type_; }
+    bool isCompressed() const { return compressed_; }
+    std::string_view getSender() const { return sender_; }
+    std::string_view getTarget() const { return target_; }
+    // 压缩帧返回的是压缩后的内容（含原始长度前缀）
+    std::string_view getContent() const { return content_; }
+    uint64_t getSequence() const { return sequence_; }
+    uint64_t getTimestamp() const { return timestamp_; }
+
+    // 整个帧的原始字节
+    std::span<const uint8_t> getFrame() const { return frame_; }
+
+    // 复制出独立的 Message，压缩内容会被解压；解压失败时返回 false
+    bool toMessage(Message& msg) const;
+
+private:
+    bool parseV1();
+    bool parseV2();
+
+    std::span<const uint8_t> frame_;
+    uint8_t version_{1};
+    Message::Type type_{Message::Type::TEXT};
+    bool compressed_{false};
+    std::string_view sender_;
+    std::string_view target_;
+    std::string_view content_;
+    uint64_t sequence_{0};
+    uint64_t timestamp_{0};
+};
@@ -0,0 +1,75 @@
+#include "metrics_endpoint.hpp"
+#include <iostream>
+
+MetricsEndpoint::MetricsEndpoint(asio::io_context& io_context, const asio::ip::tcp::endpoint& endpoint,
+                                 RenderFunction render)
+    : acceptor_(io_context, endpoint)
+    , render_(std::move(render))
+{
+}
+
+void MetricsEndpoint::start()
+{
+    std::cout << "指标端点: http://" << acceptor_.local_endpoint().address().to_string() << ":"
+              << getPort() << "/metrics" << std::endl;
+    doAccept();
+}
+
+void MetricsEndpoint::doAccept()
+{
+    acceptor_.async_accept([this](const asio::error_code& ec, asio::ip::tcp::socket socket) {
+        if (!ec) {
+            serve(std::make_shared<asio::ip::tcp::socket>(std::move(socket)));
+        }
+        doAccept();
+    });
+}
+
+void MetricsEndpoint::serve(std::shared_ptr<asio::ip::tcp::socket> socket)
+{
+    auto request = std::make_shared<asio::streambuf>(MAX_REQUEST_SIZE);
+    auto timer = std::make_shared<asio::steady_timer>(acceptor_.get_executor(), REQUEST_TIMEOUT);
+    timer->async_wait([socket](const asio::error_code& ec) {
+        if (!ec) {
+            asio::error_code ignored;
+            socket->close(ignored);
+        }
+    });
+
+    asio::async_read_until(*socket, *request, "\r\n\r\n",
+        [this, socket, request, timer](const asio::error_code& ec, std::size_t) {
+            timer->cancel();
+            if (ec) {
+                return;
+            }
+
+            std::istream stream(request.get());
+            std::string method;
+            std::string target;
+            stream >> method >> target;
+
+            std::string status = "200 OK";
+            std::string body;
+            if (method != "GET") {
+                status = "405 Method Not Allowed";
+            } else if (target == "/metrics") {
+                body = render_();
+            } else {
+                status = "404 Not Found";
+            }
+
+            auto response = std::make_shared<std::string>();
+            response->append("HTTP/1.1 ").append(status).append("\r\n");
+            response->append("Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n");
+            response->append("Content-Length: ").append(std::to_string(body.size())).append("\r\n");
+            response->append("Connection: close\r\n\r\n");
+            response->append(body);
+
+            asio::async_write(*socket, asio::buffer(*response),
+                [socket, response](const asio::error_code&, std::size_t) {
+                    asio::error_code ignored;
+                    socket->shutdown(asio::ip::tcp::socket::shutdown_both, ignored);
+                    socket->close(ignored);
+                });
+        });
+}
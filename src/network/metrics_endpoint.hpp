@@ -0,0 +1,30 @@
+#pragma once
+#include <asio.hpp>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+
+// 最小的 HTTP 端点：GET /metrics 返回 render 生成的 Prometheus 文本，其他路径返回 404。
+// 每个请求一个连接，响应后关闭；render 在 io_context 的线程上调用
+class MetricsEndpoint {
+public:
+    using RenderFunction = std::function<std::string()>;
+
+    MetricsEndpoint(asio::io_context& io_context, const asio::ip::tcp::endpoint& endpoint,
+                    RenderFunction render);
+
+    void start();
+    uint16_t getPort() const { return acceptor_.local_endpoint().port(); }
+
+private:
+    // 请求头超过该长度或超时未收完的连接直接关闭
+    static constexpr std::size_t MAX_REQUEST_SIZE = 8 * 1024;
+    static constexpr auto REQUEST_TIMEOUT = std::chrono::seconds(5);
+
+    void doAccept();
+    void serve(std::shared_ptr<asio::ip::tcp::socket> socket);
+
+    asio::ip::tcp::acceptor acceptor_;
+    RenderFunction render_;
+};
@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <utility>
+
+// 多生产者单消费者的无锁队列（Vyukov 侵入式链表）：push 可在任意线程并发调用，
+// 只用一次原子交换，不会阻塞也不会因消费者变慢而失败；pop 只能在唯一的消费者线程上调用。
+// 每个元素一个节点，由 push 分配、pop 释放
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue() : head_(&stub_), tail_(&stub_) {}
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    ~MpscQueue()
+    {
+        T value;
+        while (pop(value)) {
+        }
+    }
+
+    void push(T value)
+    {
+        pushNode(new Node(std::move(value)));
+    }
+
+    // 取出最早的元素；队列为空，或最早的元素正在被生产者链入时返回 false
+    bool pop(T& value)
+    {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &stub_) {
+            if (!next) {
+                return false;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (!next) {
+            // tail 是最后一个节点：把 stub 重新接到末尾后才能取出它
+            if (tail != head_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            stub_.next.store(nullptr, std::memory_order_relaxed);
+            pushNode(&stub_);
+            next = tail->next.load(std::memory_order_acquire);
+            if (!next) {
+                return false;
+            }
+        }
+
+        tail_ = next;
+        value = std::move(tail->value);
+        delete tail;
+        return true;
+    }
+
+    // 消费者线程上调用。tail_ 总是指向 stub 或一个尚未取出的元素，
+    // 所以 pop 返回 false 而 empty 也为 false 时，说明有生产者正在链入，稍后即可取出
+    bool empty() const
+    {
+        return tail_ == &stub_ && head_.load(std::memory_order_seq_cst) == &stub_;
+    }
+
+private:
+    struct Node {
+        Node() = default;
+        explicit Node(T v) : value(std::move(v)) {}
+
+        std::atomic<Node*> next{nullptr};
+        T value{};
+    };
+
+    void pushNode(Node* node)
+    {
+        // 交换之后、链接之前，链表暂时断开，消费者会在 pop 中看到并稍后重试
+        Node* prev = head_.exchange(node, std::memory_order_seq_cst);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // 生产者和消费者各自写的指针放在不同缓存行上
+    alignas(64) std::atomic<Node*> head_;
+    alignas(64) Node* tail_;
+    Node stub_;
+};
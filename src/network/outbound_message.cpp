@@ -0,0 +1,90 @@
+#include "outbound_message.hpp"
+#include "buffer_pool.hpp"
+#include "compression.hpp"
+#include <algorithm>
+
+namespace {
+
+SharedFrame copyFrame(const MessageView& received)
+{
+    auto bytes = received.getFrame();
+    auto data = BufferPool::acquireLocal(bytes.size());
+    data.assign(bytes.begin(), bytes.end());
+    return BufferPool::share(std::move(data));
+}
+
+} // namespace
+
+OutboundMessage::OutboundMessage(Message msg)
+    : msg_(std::move(msg))
+    , fields_(msg_.header())
+    , content_(msg_.content_)
+{
+}
+
+OutboundMessage::OutboundMessage(const MessageView& received, uint64_t sequence, uint64_t timestamp)
+    : received_(copyFrame(received))
+{
+    // 在副本上重新解析一次，字段视图指向副本而不是调用方的接收缓冲区
+    MessageView view;
+    view.parse(*received_);
+    fields_ = {view.getType(), view.getSender(), view.getTarget(), sequence, timestamp};
+    content_ = view.getContent();
+
+    if (view.getVersion() == 1) {
+        std::call_once(encodeOnce_[0], [this]() { frames_[0] = received_; });
+    }
+}
+
+OutboundMessage::OutboundMessage(Message msg, const MessageView& received)
+    : msg_(std::move(msg))
+    , fields_(msg_.header())
+    , content_(msg_.content_)
+{
+    bool compressed = received.isCompressed();
+    if (compressed) {
+        std::call_once(compressOnce_, [this, &received]() {
+            compressedContent_.assign(received.getContent());
+            compressible_ = true;
+        });
+    }
+
+    if (received.getVersion() == 1) {
+        std::size_t index = compressed ? 1 : 0;
+        std::call_once(encodeOnce_[index], [this, index, &received]() {
+            frames_[index] = copyFrame(received);
+        });
+    }
+}
+
+Message OutboundMessage::toMessage() const
+{
+    Message msg(fields_.type);
+    msg.sender_.assign(fields_.sender);
+    msg.target_.assign(fields_.target);
+    msg.content_.assign(content_);
+    msg.sequence_ = fields_.sequence;
+    msg.timestamp_ = fields_.timestamp;
+    return msg;
+}
+
+const SharedFrame& OutboundMessage::frame(const FrameFormat& format) const
+{
+    uint8_t version = std::clamp<uint8_t>(format.version, 1, VERSION_COUNT);
+    bool compressed = format.compression && compressContent();
+    std::size_t index = (version - 1) * 2 + (compressed ? 1 : 0);
+
+    std::call_once(encodeOnce_[index], [this, index, version, compressed]() {
+        std::string_view content = compressed ? std::string_view(compressedContent_) : content_;
+        frames_[index] = Message::encodeFrame(fields_, content, compressed, version);
+    });
+    return frames_[index];
+}
+
+bool OutboundMessage::compressContent() const
+{
+    std::call_once(compressOnce_, [this]() {
+        compressible_ = Compression::compress(content_, compressedContent_);
+    });
+    return compressible_;
+}
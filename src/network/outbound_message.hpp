@@ -0,0 +1,65 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include "buffer_pool.hpp"
+#include "message.hpp"
+#include "message_view.hpp"
+
+// 发给多个接收方的消息。接收方按协商结果需要不同的帧格式（v1/v2、是否压缩），
+// 每种格式在第一次用到时编码一次，之后所有接收方共享同一份帧；
+// 压缩结果在 v1 和 v2 之间共用。frame 可在多个事件循环线程上并发调用
+class OutboundMessage {
+public:
+    explicit OutboundMessage(Message msg);
+    // 转发收到的未压缩帧：只把原始字节复制进一个池化缓冲区，各字段指向这份副本，不构造 Message。
+    // 序号和时间戳由服务器重新分配；v1 帧不含这两个字段，副本直接作为 v1 帧发出
+    OutboundMessage(const MessageView& received, uint64_t sequence, uint64_t timestamp);
+    // 转发收到的压缩帧：msg 为解压后的消息，压缩内容在各版本之间复用，不再重新压缩；
+    // 收到的是 v1 帧时原始字节直接作为 v1 压缩帧
+    OutboundMessage(Message msg, const MessageView& received);
+
+    OutboundMessage(const OutboundMessage&) = delete;
+    OutboundMessage& operator=(const OutboundMessage&) = delete;
+
+    Message::Type getType() const { return fields_.type; }
+    std::string_view getSender() const { return fields_.sender; }
+    std::string_view getTarget() const { return fields_.target; }
+
+    // 复制出拥有数据的 Message，只在持久化这类需要保留到消息之外的场合使用
+    Message toMessage() const;
+
+    // 内容不值得压缩时，压缩格式退回对应版本的未压缩帧
+    const SharedFrame& frame(const FrameFormat& format) const;
+
+private:
+    static constexpr std::size_t VERSION_COUNT = 2;
+
+    bool compressContent() const;
+
+    // 两种来源只用其一：自行构造的消息由 msg_ 拥有各字段，转发的帧由 received_ 拥有
+    Message msg_;
+    SharedFrame received_;
+    Message::Header fields_;
+    std::string_view content_;  // 未压缩的内容
+
+    mutable std::once_flag compressOnce_;
+    mutable std::string compressedContent_;
+    mutable bool compressible_{false};
+
+    // 下标为 (version - 1) * 2 + compression
+    mutable std::array<std::once_flag, VERSION_COUNT * 2> encodeOnce_;
+    mutable std::array<SharedFrame, VERSION_COUNT * 2> frames_;
+};
+
+using SharedOutbound = std::shared_ptr<const OutboundMessage>;
+
+// 对象与引用计数在同一块内存中，从当前线程的块缓存分配
+template <typename... Args>
+SharedOutbound makeOutbound(Args&&... args)
+{
+    return std::allocate_shared<OutboundMessage>(PoolAllocator<OutboundMessage>(), std::forward<Args>(args)...);
+}
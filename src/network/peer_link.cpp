@@ -0,0 +1,162 @@
+#include "peer_link.hpp"
+#include "federation.hpp"
+#include <iostream>
+
+PeerLink::PeerLink(asio::ip::tcp::socket socket, Federation& federation, bool outbound)
+    : socket_(std::move(socket))
+    , federation_(federation)
+    , outbound_(outbound)
+    , writeSignal_(socket_.get_executor(), std::chrono::steady_clock::time_point::max())
+    , heartbeatTimer_(socket_.get_executor())
+{
+    lastReceived_ = std::chrono::steady_clock::now();
+    writeMessages_.setQueueLimits(QUEUE_LIMITS);
+
+    asio::error_code ec;
+    socket_.set_option(asio::ip::tcp::no_delay(true), ec);
+}
+
+asio::awaitable<void> PeerLink::run()
+{
+    auto self = shared_from_this();
+    asio::co_spawn(socket_.get_executor(), [self]() { return self->writeLoop(); }, asio::detached);
+    asio::co_spawn(socket_.get_executor(), [self]() { return self->heartbeatLoop(); }, asio::detached);
+
+    Message hello(Message::Type::PEER_HELLO);
+    hello.setSender(federation_.getNodeId());
+    send(hello.encodeShared(2), hello.getType());
+
+    co_await readLoop();
+    close();
+    federation_.onLinkClosed(self);
+}
+
+void PeerLink::send(SharedFrame frame, Message::Type type)
+{
+    if (closed_) return;
+
+    if (!writeMessages_.push(std::move(frame), type)) {
+        std::cout << "联邦链路发送队列超限，断开: " << peerId_ << std::endl;
+        close();
+        return;
+    }
+    if (writerWaiting_) {
+        writerWaiting_ = false;
+        writeSignal_.cancel();
+    }
+}
+
+void PeerLink::close()
+{
+    if (closed_) return;
+    closed_ = true;
+
+    asio::error_code ec;
+    socket_.close(ec);
+    writeSignal_.cancel();
+    heartbeatTimer_.cancel();
+}
+
+asio::awaitable<void> PeerLink::readLoop()
+{
+    asio::error_code ec;
+    while (!closed_) {
+        std::size_t length = co_await socket_.async_read_some(decoder_.prepare(),
+            withMemory(readMemory_, asio::redirect_error(asio::use_awaitable, ec)));
+        if (ec) {
+            co_return;
+        }
+        lastReceived_ = std::chrono::steady_clock::now();
+        if (stats_) {
+            stats_->bytesReceived.add(length);
+        }
+
+        bool ok = decoder_.commit(length, [this](const uint8_t* data, std::size_t size) {
+            MessageView msg;
+            if (msg.parse({data, size})) {
+                handleFrame(msg);
+            }
+            return !closed_;
+        });
+        if (!ok) {
+            std::cout << "联邦链路收到非法帧，断开: " << peerId_ << std::endl;
+            co_return;
+        }
+    }
+}
+
+void PeerLink::handleFrame(const MessageView& msg)
+{
+    if (stats_) {
+        stats_->framesReceived.add();
+    }
+
+    switch (msg.getType()) {
+    case Message::Type::PEER_HELLO:
+        if (peerId_.empty() && !msg.getSender().empty()) {
+            peerId_ = std::string(msg.getSender());
+            federation_.onHello(shared_from_this());
+        }
+        break;
+    case Message::Type::PEER_RELAY:
+        if (!peerId_.empty()) {
+            federation_.onRelay(*this, msg);
+        }
+        break;
+    case Message::Type::PEER_PRESENCE:
+        if (!peerId_.empty()) {
+            federation_.onPresence(*this, msg);
+        }
+        break;
+    default:
+        // 心跳只用于刷新 lastReceived_
+        break;
+    }
+}
+
+asio::awaitable<void> PeerLink::writeLoop()
+{
+    asio::error_code ec;
+    while (!closed_) {
+        if (writeMessages_.empty()) {
+            writerWaiting_ = true;
+            co_await writeSignal_.async_wait(
+                withMemory(writeMemory_, asio::redirect_error(asio::use_awaitable, ec)));
+            writerWaiting_ = false;
+            continue;
+        }
+
+        std::size_t length = co_await socket_.async_write_some(writeMessages_.prepareBatch(),
+            withMemory(writeMemory_, asio::redirect_error(asio::use_awaitable, ec)));
+        if (ec) {
+            close();
+            co_return;
+        }
+        std::size_t frames = writeMessages_.consume(length);
+        if (stats_) {
+            stats_->framesSent.add(frames);
+            stats_->bytesSent.add(length);
+        }
+    }
+}
+
+asio::awaitable<void> PeerLink::heartbeatLoop()
+{
+    // 链路空闲时也定期发送心跳，对端据此判断链路存活
+    static const SharedFrame heartbeat = Message(Message::Type::HEARTBEAT).encodeShared(2);
+
+    asio::error_code ec;
+    while (!closed_) {
+        heartbeatTimer_.expires_after(HEARTBEAT_INTERVAL);
+        co_await heartbeatTimer_.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+        if (ec || closed_) {
+            co_return;
+        }
+        if (std::chrono::steady_clock::now() - lastReceived_ > HEARTBEAT_TIMEOUT) {
+            std::cout << "联邦链路心跳超时，断开: " << peerId_ << std::endl;
+            close();
+            co_return;
+        }
+        send(heartbeat, Message::Type::HEARTBEAT);
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <asio.hpp>
+#include <chrono>
+#include <memory>
+#include <string>
+#include "message.hpp"
+#include "message_view.hpp"
+#include "frame_decoder.hpp"
+#include "handler_memory.hpp"
+#include "send_queue.hpp"
+#include "server_metrics.hpp"
+
+class Federation;
+
+// 与另一个节点之间的一条联邦链路，两端对称：连接建立后各自发送 PEER_HELLO，
+// 之后互相发送 PEER_RELAY、PEER_PRESENCE 和心跳。链路上只使用 v2 帧。
+// 所有方法都在联邦的 strand 上调用
+class PeerLink : public std::enable_shared_from_this<PeerLink> {
+public:
+    // 链路两端的流量，按对端节点累计，跨重连保留；只在联邦的 strand 上写入
+    struct Stats {
+        ServerMetrics::Counter framesSent;
+        ServerMetrics::Counter bytesSent;
+        ServerMetrics::Counter framesReceived;
+        ServerMetrics::Counter bytesReceived;
+    };
+
+    PeerLink(asio::ip::tcp::socket socket, Federation& federation, bool outbound);
+
+    // 运行到链路断开为止
+    asio::awaitable<void> run();
+    void send(SharedFrame frame, Message::Type type);
+    void close();
+
+    // 收到对端握手之前为空
+    const std::string& getPeerId() const { return peerId_; }
+    // 由本节点主动连接的链路
+    bool isOutbound() const { return outbound_; }
+    bool isClosed() const { return closed_; }
+    void setStats(Stats* stats) { stats_ = stats; }
+
+private:
+    asio::awaitable<void> readLoop();
+    asio::awaitable<void> writeLoop();
+    asio::awaitable<void> heartbeatLoop();
+    void handleFrame(const MessageView& msg);
+
+    // 超出队列上限说明对端处理不过来，断开后由重连和快照恢复
+    static constexpr SendQueue::QueueLimits QUEUE_LIMITS{
+        65536, 64 * 1024 * 1024, SendQueue::OverflowPolicy::Disconnect};
+    static constexpr auto HEARTBEAT_INTERVAL = std::chrono::seconds(5);
+    static constexpr auto HEARTBEAT_TIMEOUT = std::chrono::seconds(15);
+
+    asio::ip::tcp::socket socket_;
+    Federation& federation_;
+    bool outbound_;
+    bool closed_{false};
+    std::string peerId_;
+    Stats* stats_{nullptr};
+    FrameDecoder decoder_;
+    SendQueue writeMessages_;
+    HandlerMemory readMemory_;
+    HandlerMemory writeMemory_;
+    asio::steady_timer writeSignal_;
+    bool writerWaiting_{false};
+    asio::steady_timer heartbeatTimer_;
+    std::chrono::steady_clock::time_point lastReceived_;
+};
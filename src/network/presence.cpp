@@ -0,0 +1,97 @@
+#include "presence.hpp"
+#include "message.hpp"
+#include <charconv>
+
+static_assert(Presence::MAX_USERNAME_LENGTH <= Message::MAX_FIELD_SIZE, "用户名必须能通过帧解码的字段长度检查");
+
+bool Presence::isValidUsername(std::string_view username)
+{
+    if (username.empty() || username.size() > MAX_USERNAME_LENGTH) {
+        return false;
+    }
+    for (char c : username) {
+        auto byte = static_cast<unsigned char>(c);
+        if (c == ',' || byte < 0x20 || byte == 0x7F) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string Presence::encodeSnapshot(uint64_t version, const std::vector<std::string>& users)
+{
+    std::string content = std::to_string(version) + ":";
+    for (std::size_t i = 0; i < users.size(); ++i) {
+        if (i > 0) content += ",";
+        content += users[i];
+    }
+    return content;
+}
+
+bool Presence::parseSnapshot(const std::string& content, uint64_t& version,
+                             std::vector<std::string>& users)
+{
+    std::size_t pos = 0;
+    if (!parseVersion(content, pos, version)) {
+        return false;
+    }
+
+    users.clear();
+    while (pos < content.size()) {
+        std::size_t comma = content.find(',', pos);
+        if (comma == std::string::npos) comma = content.size();
+        if (comma > pos) {
+            users.emplace_back(content, pos, comma - pos);
+        }
+        pos = comma + 1;
+    }
+    return true;
+}
+
+std::string Presence::encodeDelta(const Delta& delta)
+{
+    std::string content = std::to_string(delta.baseVersion) + ":" + std::to_string(delta.version) + ":";
+    for (std::size_t i = 0; i < delta.changes.size(); ++i) {
+        if (i > 0) content += ",";
+        content += delta.changes[i].second ? '+' : '-';
+        content += delta.changes[i].first;
+    }
+    return content;
+}
+
+bool Presence::parseDelta(const std::string& content, Delta& delta)
+{
+    std::size_t pos = 0;
+    if (!parseVersion(content, pos, delta.baseVersion) || !parseVersion(content, pos, delta.version)) {
+        return false;
+    }
+
+    delta.changes.clear();
+    while (pos < content.size()) {
+        std::size_t comma = content.find(',', pos);
+        if (comma == std::string::npos) comma = content.size();
+        if (comma > pos + 1) {
+            char op = content[pos];
+            if (op != '+' && op != '-') {
+                return false;
+            }
+            delta.changes.emplace_back(content.substr(pos + 1, comma - pos - 1), op == '+');
+        }
+        pos = comma + 1;
+    }
+    return true;
+}
+
+bool Presence::parseVersion(const std::string& content, std::size_t& pos, uint64_t& version)
+{
+    std::size_t colon = content.find(':', pos);
+    if (colon == std::string::npos) {
+        return false;
+    }
+    auto result = std::from_chars(content.data() + pos, content.data() + colon, version);
+    if (result.ec != std::errc() || result.ptr != content.data() + colon) {
+        return false;
+    }
+    pos = colon + 1;
+    return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// 在线用户列表的编码：
+//   全量快照 USER_LIST       内容为 "<版本>:<用户1>,<用户2>,..."
+//   增量     USER_LIST_DELTA 内容为 "<基准版本>:<新版本>:+<用户>,-<用户>,..."
+// 增量中的 +/- 表示窗口结束时该用户是否在线（最终状态），重复应用是幂等的
+class Presence {
+public:
+    struct Delta {
+        uint64_t baseVersion{0};
+        uint64_t version{0};
+        std::vector<std::pair<std::string, bool>> changes;  // 用户名, 是否在线
+    };
+
+    // 用户名最长字节数（UTF-8）
+    static constexpr std::size_t MAX_USERNAME_LENGTH = 64;
+
+    // 用户名出现在以逗号分隔的快照和增量中，不能含逗号和控制字符，也不能为空或超长
+    static bool isValidUsername(std::string_view username);
+
+    static std::string encodeSnapshot(uint64_t version, const std::vector<std::string>& users);
+    static bool parseSnapshot(const std::string& content, uint64_t& version,
+                              std::vector<std::string>& users);
+
+    static std::string encodeDelta(const Delta& delta);
+    static bool parseDelta(const std::string& content, Delta& delta);
+
+private:
+    static bool parseVersion(const std::string& content, std::size_t& pos, uint64_t& version);
+};
@@ -0,0 +1,155 @@
+#include "rate_limiter.hpp"
+#include <algorithm>
+
+namespace {
+
+double intervalFor(double ratePerSecond)
+{
+    return ratePerSecond > 0 ? 1e9 / ratePerSecond : 0;
+}
+
+int64_t toleranceFor(double ratePerSecond, double burst)
+{
+    if (ratePerSecond <= 0) {
+        return 0;
+    }
+    return static_cast<int64_t>(std::max(burst > 0 ? burst : ratePerSecond, 1.0) * intervalFor(ratePerSecond));
+}
+
+// 从理论到达时间 tat 取 amount 个令牌后的新理论到达时间，以及超出容忍度的纳秒数
+int64_t excessNanos(int64_t tat, int64_t nowNanos, int64_t increment, int64_t tolerance, int64_t& newTat)
+{
+    newTat = std::max(tat, nowNanos) + increment;
+    return newTat - nowNanos - std::max(tolerance, increment);
+}
+
+} // namespace
+
+TokenBucket::TokenBucket(double ratePerSecond, double burst)
+    : intervalNanos_(intervalFor(ratePerSecond))
+    , toleranceNanos_(toleranceFor(ratePerSecond, burst))
+{
+}
+
+int64_t TokenBucket::acquire(uint64_t amount, int64_t nowNanos, bool force)
+{
+    int64_t newTat = 0;
+    int64_t excess = excessNanos(tat_, nowNanos, static_cast<int64_t>(amount * intervalNanos_),
+                                 toleranceNanos_, newTat);
+    if (excess > 0 && !force) {
+        return excess;
+    }
+    tat_ = newTat;
+    return std::max<int64_t>(excess, 0);
+}
+
+void TokenBucket::refund(uint64_t amount)
+{
+    tat_ -= static_cast<int64_t>(amount * intervalNanos_);
+}
+
+SharedTokenBucket::SharedTokenBucket(double ratePerSecond, double burst)
+    : intervalNanos_(intervalFor(ratePerSecond))
+    , toleranceNanos_(toleranceFor(ratePerSecond, burst))
+{
+}
+
+int64_t SharedTokenBucket::acquire(uint64_t amount, int64_t nowNanos, bool force)
+{
+    int64_t increment = static_cast<int64_t>(amount * intervalNanos_);
+    int64_t tat = tat_.load(std::memory_order_relaxed);
+    int64_t newTat = 0;
+    int64_t excess = 0;
+    do {
+        excess = excessNanos(tat, nowNanos, increment, toleranceNanos_, newTat);
+        if (excess > 0 && !force) {
+            return excess;
+        }
+    } while (!tat_.compare_exchange_weak(tat, newTat, std::memory_order_relaxed));
+    return std::max<int64_t>(excess, 0);
+}
+
+void SharedTokenBucket::refund(uint64_t amount)
+{
+    tat_.fetch_sub(static_cast<int64_t>(amount * intervalNanos_), std::memory_order_relaxed);
+}
+
+AddressBuckets::AddressBuckets(const RateLimit& limit)
+    : messages(limit.messagesPerSecond, limit.messageBurst)
+    , bytes(limit.bytesPerSecond, limit.byteBurst)
+{
+}
+
+std::shared_ptr<AddressBuckets> AddressLimiterTable::acquire(const std::string& address)
+{
+    if (!limit_.enabled()) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& entry = buckets_[address];
+    auto buckets = entry.lock();
+    if (!buckets) {
+        buckets = std::make_shared<AddressBuckets>(limit_);
+        entry = buckets;
+    }
+
+    // 表增长一倍时清理一次已无连接的地址，均摊到每次连接的开销是常数
+    if (buckets_.size() >= pruneThreshold_) {
+        for (auto it = buckets_.begin(); it != buckets_.end();) {
+            it = it->second.expired() ? buckets_.erase(it) : std::next(it);
+        }
+        pruneThreshold_ = std::max<std::size_t>(64, buckets_.size() * 2);
+    }
+    return buckets;
+}
+
+RateLimiter::RateLimiter(const RateLimit& session, std::shared_ptr<AddressBuckets> address)
+    : messages_(session.messagesPerSecond, session.messageBurst)
+    , bytes_(session.bytesPerSecond, session.byteBurst)
+    , address_(std::move(address))
+{
+    enabled_ = messages_.enabled() || bytes_.enabled() || address_;
+}
+
+int64_t RateLimiter::admit(uint64_t bytes, int64_t nowNanos, bool force)
+{
+    // 先查本连接的桶，都通过后才碰共享的地址桶；不扣除超限消息时，
+    // 后面的桶拒绝就退还前面已扣的令牌
+    int64_t wait = 0;
+    bool chargedMessages = false;
+    bool chargedBytes = false;
+    bool chargedAddressMessages = false;
+
+    auto reject = [&](int64_t excess) {
+        if (chargedMessages) messages_.refund(1);
+        if (chargedBytes) bytes_.refund(bytes);
+        if (chargedAddressMessages) address_->messages.refund(1);
+        return excess;
+    };
+
+    if (messages_.enabled()) {
+        int64_t excess = messages_.acquire(1, nowNanos, force);
+        if (excess > 0 && !force) return reject(excess);
+        wait = std::max(wait, excess);
+        chargedMessages = true;
+    }
+    if (bytes_.enabled()) {
+        int64_t excess = bytes_.acquire(bytes, nowNanos, force);
+        if (excess > 0 && !force) return reject(excess);
+        wait = std::max(wait, excess);
+        chargedBytes = true;
+    }
+    if (address_ && address_->messages.enabled()) {
+        int64_t excess = address_->messages.acquire(1, nowNanos, force);
+        if (excess > 0 && !force) return reject(excess);
+        wait = std::max(wait, excess);
+        chargedAddressMessages = true;
+    }
+    if (address_ && address_->bytes.enabled()) {
+        int64_t excess = address_->bytes.acquire(bytes, nowNanos, force);
+        if (excess > 0 && !force) return reject(excess);
+        wait = std::max(wait, excess);
+    }
+    return wait;
+}
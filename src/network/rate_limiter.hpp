@@ -0,0 +1,114 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// 一组速率限制：每秒消息数和每秒字节数，为 0 表示不限制。
+// 突发容量为 0 时取一秒的量
+struct RateLimit {
+    double messagesPerSecond{0};
+    double messageBurst{0};
+    double bytesPerSecond{0};
+    double byteBurst{0};
+
+    bool enabled() const { return messagesPerSecond > 0 || bytesPerSecond > 0; }
+};
+
+struct RateLimitConfig {
+    // 超限时的处理方式：Delay 暂停读取 socket，由 TCP 流量控制把压力传回发送方；
+    // Drop 继续读取但丢弃超限消息，并通知发送方
+    enum class Action {
+        Delay,
+        Drop
+    };
+
+    RateLimit session;  // 每个连接
+    RateLimit address;  // 同一 IP 地址的所有连接合计
+    Action action{Action::Delay};
+
+    bool enabled() const { return session.enabled() || address.enabled(); }
+};
+
+// 令牌桶，按 GCRA 的形式实现：只记录“理论到达时间”一个数，
+// 取令牌就是一次比较和加法，不需要定时补充。时间均为 steady_clock 纳秒数
+class TokenBucket {
+public:
+    TokenBucket() = default;
+    TokenBucket(double ratePerSecond, double burst);
+
+    bool enabled() const { return intervalNanos_ > 0; }
+
+    // 取 amount 个令牌，返回还需等待的纳秒数，0 表示未超限。
+    // 超限时 force 为 true 仍然扣除（形成欠账，等待期满后恢复），为 false 则不扣除。
+    // 桶满时总能取出一次，超过突发容量的单条消息不会被永远拒绝
+    int64_t acquire(uint64_t amount, int64_t nowNanos, bool force);
+    // 退还已扣除的令牌
+    void refund(uint64_t amount);
+
+private:
+    double intervalNanos_{0};  // 每个令牌的补充间隔
+    int64_t toleranceNanos_{0};
+    int64_t tat_{0};
+};
+
+// 可被多个线程共享的令牌桶，理论到达时间用原子变量以 CAS 更新
+class SharedTokenBucket {
+public:
+    SharedTokenBucket() = default;
+    SharedTokenBucket(double ratePerSecond, double burst);
+
+    bool enabled() const { return intervalNanos_ > 0; }
+    int64_t acquire(uint64_t amount, int64_t nowNanos, bool force);
+    void refund(uint64_t amount);
+
+private:
+    double intervalNanos_{0};
+    int64_t toleranceNanos_{0};
+    std::atomic<int64_t> tat_{0};
+};
+
+// 同一 IP 地址所有连接共享的一对令牌桶
+struct AddressBuckets {
+    explicit AddressBuckets(const RateLimit& limit);
+
+    SharedTokenBucket messages;
+    SharedTokenBucket bytes;
+};
+
+// IP 地址到共享令牌桶的表，只在建立连接时加锁查找；
+// 地址的最后一个连接关闭后令牌桶随之释放
+class AddressLimiterTable {
+public:
+    explicit AddressLimiterTable(const RateLimit& limit) : limit_(limit) {}
+
+    std::shared_ptr<AddressBuckets> acquire(const std::string& address);
+
+private:
+    RateLimit limit_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::weak_ptr<AddressBuckets>> buckets_;
+    std::size_t pruneThreshold_{64};
+};
+
+// 一个连接的限速器，只在连接所属线程上使用
+class RateLimiter {
+public:
+    RateLimiter() = default;
+    RateLimiter(const RateLimit& session, std::shared_ptr<AddressBuckets> address);
+
+    bool enabled() const { return enabled_; }
+
+    // 一条 bytes 字节的消息能否立即放行，返回需等待的纳秒数，0 表示放行。
+    // force 的含义同 TokenBucket::acquire：为 false 时超限消息不占用任何令牌
+    int64_t admit(uint64_t bytes, int64_t nowNanos, bool force);
+
+private:
+    TokenBucket messages_;
+    TokenBucket bytes_;
+    std::shared_ptr<AddressBuckets> address_;
+    bool enabled_{false};
+};
@@ -0,0 +1,121 @@
+#include "send_queue.hpp"
+#include <algorithm>
+
+bool SendQueue::push(SharedFrame frame, Message::Type type)
+{
+    queuedBytes_ += frame->size();
+    frames_.push_back({std::move(frame), type});
+
+    if (overLimit()) {
+        switch (queueLimits_.policy) {
+        case OverflowPolicy::DropOldest:
+            // 丢光可丢弃的旧帧后仍超限时保留新帧，不因单个大帧断开
+            evict([](Message::Type) { return true; });
+            break;
+        case OverflowPolicy::DropNonCritical:
+            if (!evict([](Message::Type t) {
+                    return t == Message::Type::TEXT || t == Message::Type::ROOM_TEXT;
+                })) {
+                return false;
+            }
+            break;
+        case OverflowPolicy::Disconnect:
+            return false;
+        }
+    }
+
+    stats_.highWaterFrames = std::max(stats_.highWaterFrames, frames_.size());
+    stats_.highWaterBytes = std::max(stats_.highWaterBytes, queuedBytes_);
+    return true;
+}
+
+void SendQueue::clear()
+{
+    frames_.clear();
+    queuedBytes_ = 0;
+    frontOffset_ = 0;
+    inFlight_ = 0;
+}
+
+bool SendQueue::overLimit() const
+{
+    return frames_.size() > queueLimits_.maxFrames || queuedBytes_ > queueLimits_.maxBytes;
+}
+
+bool SendQueue::evict(bool (*candidate)(Message::Type))
+{
+    // 正在写的帧和部分写出的队首帧不能丢弃，刚入队的帧最后考虑
+    std::size_t first = std::max<std::size_t>(inFlight_, frontOffset_ > 0 ? 1 : 0);
+    auto it = frames_.begin() + first;
+    while (overLimit() && it != frames_.end() && std::next(it) != frames_.end()) {
+        if (candidate(it->type)) {
+            auto next = std::next(it) - frames_.begin();
+            drop(it);
+            it = frames_.begin() + (next - 1);
+        } else {
+            ++it;
+        }
+    }
+    return !overLimit();
+}
+
+void SendQueue::drop(Frames::iterator it)
+{
+    ++stats_.droppedFrames;
+    stats_.droppedBytes += it->frame->size();
+    queuedBytes_ -= it->frame->size();
+    frames_.erase(it);
+}
+
+void SendQueue::setBatchLimits(const BatchLimits& limits)
+{
+    limits_.maxFrames = std::clamp<std::size_t>(limits.maxFrames, 1, MAX_BATCH_FRAMES);
+    limits_.maxBytes = std::max<std::size_t>(limits.maxBytes, 1);
+}
+
+std::span<const asio::const_buffer> SendQueue::prepareBatch()
+{
+    std::size_t count = 0;
+    std::size_t bytes = 0;
+    std::size_t offset = frontOffset_;
+
+    for (const auto& entry : frames_) {
+        const auto& frame = entry.frame;
+        std::size_t remaining = frame->size() - offset;
+        // 至少放入一帧，超大帧单独发送
+        if (count == limits_.maxFrames || (count > 0 && bytes + remaining > limits_.maxBytes)) {
+            break;
+        }
+        buffers_[count++] = asio::buffer(frame->data() + offset, remaining);
+        bytes += remaining;
+        offset = 0;
+    }
+
+    inFlight_ = count;
+    ++stats_.writeOps;
+    return {buffers_.data(), count};
+}
+
+std::size_t SendQueue::consume(std::size_t bytesWritten)
+{
+    stats_.bytes += bytesWritten;
+
+    std::size_t completed = 0;
+    while (!frames_.empty()) {
+        std::size_t size = frames_.front().frame->size();
+        std::size_t remaining = size - frontOffset_;
+        if (bytesWritten < remaining) {
+            frontOffset_ += bytesWritten;
+            break;
+        }
+        bytesWritten -= remaining;
+        frontOffset_ = 0;
+        queuedBytes_ -= size;
+        frames_.pop_front();
+        ++completed;
+    }
+    inFlight_ = 0;
+
+    stats_.frames += completed;
+    return completed;
+}
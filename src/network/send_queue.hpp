@@ -0,0 +1,87 @@
+#pragma once
+#include <asio.hpp>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <span>
+#include "buffer_pool.hpp"
+#include "message.hpp"
+
+// 待发送帧队列：把排队的多个帧合并成一次 gather 写，减少系统调用和完成回调；
+// 可限制排队的帧数和字节数，防止慢消费者无限占用内存
+class SendQueue {
+public:
+    enum class OverflowPolicy {
+        DropOldest,       // 丢弃最早排队的帧
+        DropNonCritical,  // 只丢 TEXT 和 ROOM_TEXT，仍超限则断开
+        Disconnect        // 直接断开连接
+    };
+
+    struct QueueLimits {
+        std::size_t maxFrames{std::numeric_limits<std::size_t>::max()};
+        std::size_t maxBytes{std::numeric_limits<std::size_t>::max()};
+        OverflowPolicy policy{OverflowPolicy::DropOldest};
+    };
+
+    // asio 在 POSIX 上单次 writev 最多使用 64 个 iovec
+    static constexpr std::size_t MAX_BATCH_FRAMES = 64;
+
+    struct BatchLimits {
+        std::size_t maxFrames{MAX_BATCH_FRAMES};  // 单次写最多合并的帧数（iovec 数）
+        std::size_t maxBytes{256 * 1024};         // 单次写最多合并的字节数
+    };
+
+    struct Stats {
+        uint64_t writeOps{0};   // 发起的写操作（系统调用）次数
+        uint64_t frames{0};     // 完整写出的帧数
+        uint64_t bytes{0};      // 写出的字节数
+        uint64_t droppedFrames{0};
+        uint64_t droppedBytes{0};
+        std::size_t highWaterFrames{0};  // 排队帧数的历史峰值
+        std::size_t highWaterBytes{0};   // 排队字节数的历史峰值
+
+        double framesPerWrite() const {
+            return writeOps ? static_cast<double>(frames) / writeOps : 0.0;
+        }
+    };
+
+    bool empty() const { return frames_.empty(); }
+    std::size_t size() const { return frames_.size(); }
+    std::size_t bytes() const { return queuedBytes_; }
+
+    // 入队，超出限制时按策略处理；返回 false 表示应断开连接
+    bool push(SharedFrame frame, Message::Type type);
+    void clear();
+
+    void setBatchLimits(const BatchLimits& limits);
+    void setQueueLimits(const QueueLimits& limits) { queueLimits_ = limits; }
+    const Stats& getStats() const { return stats_; }
+
+    // 取出下一批待写缓冲区，在对应的写操作完成之前保持有效
+    std::span<const asio::const_buffer> prepareBatch();
+
+    // 写操作完成后调用，移除已完整写出的帧，返回移除的帧数
+    std::size_t consume(std::size_t bytesWritten);
+
+private:
+    struct Entry {
+        SharedFrame frame;
+        Message::Type type;
+    };
+    // 队列在 0 和几帧之间反复涨落，deque 的分段随之释放和重新申请，改由块缓存提供
+    using Frames = std::deque<Entry, PoolAllocator<Entry>>;
+
+    bool overLimit() const;
+    bool evict(bool (*candidate)(Message::Type));
+    void drop(Frames::iterator it);
+
+    Frames frames_;
+    std::size_t queuedBytes_{0};
+    std::size_t frontOffset_{0};   // 队首帧已部分写出的字节数
+    std::size_t inFlight_{0};      // 正在写的帧数，这些帧不可丢弃
+    std::array<asio::const_buffer, MAX_BATCH_FRAMES> buffers_;
+    BatchLimits limits_;
+    QueueLimits queueLimits_;
+    Stats stats_;
+};
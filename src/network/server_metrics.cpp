@@ -0,0 +1,178 @@
+#include "server_metrics.hpp"
+#include <algorithm>
+#include <cstdio>
+
+void ServerMetrics::Histogram::record(std::chrono::nanoseconds duration)
+{
+    uint64_t nanos = static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0));
+    auto bucket = std::lower_bound(BOUNDS_NANOS.begin(), BOUNDS_NANOS.end(), nanos) - BOUNDS_NANOS.begin();
+    buckets_[bucket].add();
+    sumNanos_.add(nanos);
+}
+
+void ServerMetrics::HistogramTotals::merge(const Histogram& histogram)
+{
+    for (std::size_t i = 0; i < buckets.size(); ++i) {
+        buckets[i] += histogram.buckets_[i].get();
+    }
+    sumNanos += histogram.sumNanos_.get();
+}
+
+ServerMetrics::ServerMetrics(std::size_t threads)
+{
+    for (std::size_t i = 0; i < threads; ++i) {
+        locals_.push_back(std::make_unique<Local>());
+    }
+}
+
+ServerMetrics::Totals ServerMetrics::collect() const
+{
+    Totals totals;
+    for (const auto& local : locals_) {
+        totals.connectionsOpened += local->connectionsOpened.get();
+        totals.connectionsClosed += local->connectionsClosed.get();
+        totals.framesIn += local->framesIn.get();
+        totals.bytesIn += local->bytesIn.get();
+        totals.framesOut += local->framesOut.get();
+        totals.bytesOut += local->bytesOut.get();
+        totals.writeOps += local->writeOps.get();
+        totals.decodeFailures += local->decodeFailures.get();
+        totals.heartbeatTimeouts += local->heartbeatTimeouts.get();
+        totals.overflowDisconnects += local->overflowDisconnects.get();
+        totals.droppedFrames += local->droppedFrames.get();
+        totals.rateLimitDelays += local->rateLimitDelays.get();
+        totals.rateLimitDroppedFrames += local->rateLimitDroppedFrames.get();
+        totals.rateLimitDroppedBytes += local->rateLimitDroppedBytes.get();
+        totals.queuedFrames += local->queuedFrames.get();
+        totals.queuedBytes += local->queuedBytes.get();
+        totals.fanOutDuration.merge(local->fanOutDuration);
+        totals.heartbeatRtt.merge(local->heartbeatRtt);
+        totals.federationLinks += local->federationLinks.get();
+        totals.federationRelayedOut += local->federationRelayedOut.get();
+        totals.federationRelayedIn += local->federationRelayedIn.get();
+        totals.federationDuplicates += local->federationDuplicates.get();
+        totals.federationDelivery.merge(local->federationDelivery);
+        totals.privateMessages += local->privateMessages.get();
+        totals.privateOffline += local->privateOffline.get();
+        totals.privateRejected += local->privateRejected.get();
+        totals.offlineMessages += local->offlineMessages.get();
+        totals.filesStored += local->filesStored.get();
+        totals.fileBytesIn += local->fileBytesIn.get();
+        totals.fileBytesOut += local->fileBytesOut.get();
+        totals.fileTransfersAborted += local->fileTransfersAborted.get();
+        totals.activeFileTransfers += local->activeFileTransfers.get();
+    }
+    return totals;
+}
+
+void ServerMetrics::renderCounter(std::string& out, std::string_view name, std::string_view help,
+                                  uint64_t value)
+{
+    out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    out.append("# TYPE ").append(name).append(" counter\n");
+    out.append(name).append(" ").append(std::to_string(value)).append("\n");
+}
+
+void ServerMetrics::renderGauge(std::string& out, std::string_view name, std::string_view help,
+                                double value)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+    out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    out.append("# TYPE ").append(name).append(" gauge\n");
+    out.append(name).append(" ").append(buffer).append("\n");
+}
+
+void ServerMetrics::renderHistogram(std::string& out, std::string_view name, std::string_view help,
+                                    const HistogramTotals& value)
+{
+    // 各线程的桶分别读取，累计数以桶为准，保证 _count 与 +Inf 桶一致
+    out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    out.append("# TYPE ").append(name).append(" histogram\n");
+    uint64_t cumulative = 0;
+    char buffer[64];
+    for (std::size_t i = 0; i < value.buckets.size(); ++i) {
+        cumulative += value.buckets[i];
+        if (i < Histogram::BOUNDS_NANOS.size()) {
+            std::snprintf(buffer, sizeof(buffer), "%g", Histogram::BOUNDS_NANOS[i] / 1e9);
+        } else {
+            std::snprintf(buffer, sizeof(buffer), "+Inf");
+        }
+        out.append(name).append("_bucket{le=\"").append(buffer).append("\"} ")
+           .append(std::to_string(cumulative)).append("\n");
+    }
+    std::snprintf(buffer, sizeof(buffer), "%.9f", value.sumNanos / 1e9);
+    out.append(name).append("_sum ").append(buffer).append("\n");
+    out.append(name).append("_count ").append(std::to_string(cumulative)).append("\n");
+}
+
+void ServerMetrics::render(std::string& out) const
+{
+    Totals t = collect();
+
+    renderCounter(out, "chat_connections_opened_total", "Client connections accepted.", t.connectionsOpened);
+    renderCounter(out, "chat_connections_closed_total", "Client connections closed.", t.connectionsClosed);
+    renderGauge(out, "chat_connections", "Currently open client connections.",
+                static_cast<double>(t.connectionsOpened - t.connectionsClosed));
+    renderCounter(out, "chat_frames_received_total", "Frames received from clients.", t.framesIn);
+    renderCounter(out, "chat_bytes_received_total", "Bytes received from clients.", t.bytesIn);
+    renderCounter(out, "chat_frames_sent_total", "Frames fully written to clients.", t.framesOut);
+    renderCounter(out, "chat_bytes_sent_total", "Bytes written to clients.", t.bytesOut);
+    renderCounter(out, "chat_write_ops_total", "Gather write operations issued.", t.writeOps);
+    renderCounter(out, "chat_decode_failures_total",
+                  "Malformed, oversized or undecompressable frames, and frames a client may not send.",
+                  t.decodeFailures);
+    renderCounter(out, "chat_heartbeat_timeouts_total", "Sessions closed after missing heartbeats.",
+                  t.heartbeatTimeouts);
+    renderCounter(out, "chat_send_queue_overflow_disconnects_total",
+                  "Slow consumers disconnected because their send queue overflowed.", t.overflowDisconnects);
+    renderCounter(out, "chat_send_queue_dropped_frames_total",
+                  "Frames dropped from send queues over their limits.", t.droppedFrames);
+    renderCounter(out, "chat_rate_limit_delays_total",
+                  "Times a session stopped reading because it exceeded its rate limit.", t.rateLimitDelays);
+    renderCounter(out, "chat_rate_limit_dropped_frames_total",
+                  "Messages dropped because the sender exceeded its rate limit.", t.rateLimitDroppedFrames);
+    renderCounter(out, "chat_rate_limit_dropped_bytes_total",
+                  "Bytes of messages dropped because the sender exceeded its rate limit.",
+                  t.rateLimitDroppedBytes);
+    renderGauge(out, "chat_send_queue_frames", "Frames waiting in all session send queues.",
+                static_cast<double>(t.queuedFrames));
+    renderGauge(out, "chat_send_queue_bytes", "Bytes waiting in all session send queues.",
+                static_cast<double>(t.queuedBytes));
+
+    renderHistogram(out, "chat_fanout_duration_seconds",
+                    "Time one event loop spends delivering a broadcast to its sessions.", t.fanOutDuration);
+    renderHistogram(out, "chat_heartbeat_rtt_seconds",
+                    "Round-trip time of server-initiated heartbeat probes, one sample per session per probe.",
+                    t.heartbeatRtt);
+    renderGauge(out, "chat_federation_links", "Established links to peer nodes.",
+                static_cast<double>(t.federationLinks));
+    renderCounter(out, "chat_federation_relayed_out_total", "Local messages forwarded to peer nodes.",
+                  t.federationRelayedOut);
+    renderCounter(out, "chat_federation_relayed_in_total", "Messages received from peer nodes and delivered locally.",
+                  t.federationRelayedIn);
+    renderCounter(out, "chat_federation_duplicates_total", "Relayed messages dropped as duplicates.",
+                  t.federationDuplicates);
+    renderHistogram(out, "chat_federation_delivery_seconds",
+                    "Time from the origin node forwarding a message to this node receiving it "
+                    "(requires synchronized clocks across hosts).",
+                    t.federationDelivery);
+    renderCounter(out, "chat_private_messages_total", "Direct messages routed to their recipient.",
+                  t.privateMessages);
+    renderCounter(out, "chat_private_offline_total", "Direct messages stored for an offline recipient.",
+                  t.privateOffline);
+    renderCounter(out, "chat_private_rejected_total",
+                  "Direct messages dropped because the recipient's offline mailbox was full.", t.privateRejected);
+    renderGauge(out, "chat_offline_messages", "Direct messages waiting in offline mailboxes.",
+                static_cast<double>(t.offlineMessages));
+    renderCounter(out, "chat_files_stored_total", "Uploaded files stored and available for download.",
+                  t.filesStored);
+    renderCounter(out, "chat_file_bytes_received_total", "File bytes received from uploads.", t.fileBytesIn);
+    renderCounter(out, "chat_file_bytes_sent_total", "File bytes sent to downloads, excluding frame headers.",
+                  t.fileBytesOut);
+    renderCounter(out, "chat_file_transfers_aborted_total",
+                  "Uploads and downloads that failed, were cancelled or lost their connection.",
+                  t.fileTransfersAborted);
+    renderGauge(out, "chat_file_transfers_active", "Uploads and downloads in progress.",
+                static_cast<double>(t.activeFileTransfers));
+}
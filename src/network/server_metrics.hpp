@@ -0,0 +1,158 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 服务器运行指标。每个事件循环一份 Local，只由该循环的线程写入：
+// 单写者不需要原子读改写，记录就是一次普通的加法和存储，不加锁也没有 lock 前缀指令；
+// 读取方在任意线程上把所有 Local 相加，结果输出为 Prometheus 文本格式
+class ServerMetrics {
+public:
+    // 单写者计数器
+    class Counter {
+    public:
+        void add(uint64_t n = 1) {
+            value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+        uint64_t get() const { return value_.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> value_{0};
+    };
+
+    // 单写者的可增减量，各线程的值可以为负，相加后才有意义
+    class Gauge {
+    public:
+        void add(int64_t n) {
+            value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+        int64_t get() const { return value_.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<int64_t> value_{0};
+    };
+
+    // 单写者的固定桶耗时直方图，桶上界从 1 微秒到 1 秒
+    class Histogram {
+    public:
+        static constexpr std::array<uint64_t, 19> BOUNDS_NANOS{
+            1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+            1000000, 2500000, 5000000, 10000000, 25000000, 50000000, 100000000,
+            250000000, 500000000, 1000000000};
+
+        void record(std::chrono::nanoseconds duration);
+
+    private:
+        friend class ServerMetrics;
+
+        std::array<Counter, BOUNDS_NANOS.size() + 1> buckets_;  // 最后一个桶是 +Inf
+        Counter sumNanos_;
+    };
+
+    // 直方图合并后的快照
+    struct HistogramTotals {
+        std::array<uint64_t, Histogram::BOUNDS_NANOS.size() + 1> buckets{};
+        uint64_t sumNanos{0};
+
+        void merge(const Histogram& histogram);
+    };
+
+    // 对齐到缓存行，避免不同线程的计数落在同一行上互相干扰
+    struct alignas(64) Local {
+        Counter connectionsOpened;
+        Counter connectionsClosed;
+        Counter framesIn;
+        Counter bytesIn;
+        Counter framesOut;
+        Counter bytesOut;
+        Counter writeOps;
+        Counter decodeFailures;      // 非法帧、超长帧、解压失败，以及客户端不应发送的类型和冒充他人的消息
+        Counter heartbeatTimeouts;
+        Counter overflowDisconnects; // 发送队列超限被断开的慢消费者
+        Counter droppedFrames;       // 发送队列超限时丢弃的帧
+        Counter rateLimitDelays;     // 超过速率限制而暂停读取的次数
+        Counter rateLimitDroppedFrames; // 超过速率限制而丢弃的消息
+        Counter rateLimitDroppedBytes;
+        Gauge queuedFrames;          // 所有会话发送队列中的帧数
+        Gauge queuedBytes;
+        Histogram fanOutDuration;    // 一个事件循环把一条广播投递给本循环所有接收方的耗时
+        Histogram heartbeatRtt;      // 服务器发起的心跳探测的往返时间
+        // 联邦，只由目录 strand 所在的分片写入
+        Gauge federationLinks;
+        Counter federationRelayedOut;    // 转发给其他节点的消息（每条消息计一次）
+        Counter federationRelayedIn;
+        Counter federationDuplicates;    // 按来源序号丢弃的重复消息
+        Histogram federationDelivery;    // 来源节点发出到本节点收到的时间
+        // 私聊路由，只由目录 strand 所在的分片写入
+        Counter privateMessages;         // 路由的私聊消息（含其他节点转来的）
+        Counter privateOffline;          // 接收方不在线而存入离线信箱的消息
+        Counter privateRejected;         // 离线信箱已满而丢弃的消息
+        Gauge offlineMessages;           // 离线信箱中等待投递的消息
+        // 文件传输
+        Counter filesStored;             // 上传完成并可供下载的文件
+        Counter fileBytesIn;             // 上传写入磁盘的字节
+        Counter fileBytesOut;            // 下载发出的文件内容字节（不含帧头）
+        Counter fileTransfersAborted;    // 中途失败、被取消或连接断开的上传和下载
+        Gauge activeFileTransfers;       // 进行中的上传和下载
+    };
+
+    // 合并后的快照
+    struct Totals {
+        uint64_t connectionsOpened{0};
+        uint64_t connectionsClosed{0};
+        uint64_t framesIn{0};
+        uint64_t bytesIn{0};
+        uint64_t framesOut{0};
+        uint64_t bytesOut{0};
+        uint64_t writeOps{0};
+        uint64_t decodeFailures{0};
+        uint64_t heartbeatTimeouts{0};
+        uint64_t overflowDisconnects{0};
+        uint64_t droppedFrames{0};
+        uint64_t rateLimitDelays{0};
+        uint64_t rateLimitDroppedFrames{0};
+        uint64_t rateLimitDroppedBytes{0};
+        int64_t queuedFrames{0};
+        int64_t queuedBytes{0};
+        HistogramTotals fanOutDuration;
+        HistogramTotals heartbeatRtt;
+        int64_t federationLinks{0};
+        uint64_t federationRelayedOut{0};
+        uint64_t federationRelayedIn{0};
+        uint64_t federationDuplicates{0};
+        HistogramTotals federationDelivery;
+        uint64_t privateMessages{0};
+        uint64_t privateOffline{0};
+        uint64_t privateRejected{0};
+        int64_t offlineMessages{0};
+        uint64_t filesStored{0};
+        uint64_t fileBytesIn{0};
+        uint64_t fileBytesOut{0};
+        uint64_t fileTransfersAborted{0};
+        int64_t activeFileTransfers{0};
+    };
+
+    explicit ServerMetrics(std::size_t threads);
+
+    Local& local(std::size_t index) { return *locals_[index]; }
+
+    // 可在任意线程调用
+    Totals collect() const;
+
+    // 追加 Prometheus 文本格式（0.0.4）的指标
+    void render(std::string& out) const;
+    static void renderCounter(std::string& out, std::string_view name, std::string_view help,
+                              uint64_t value);
+    static void renderGauge(std::string& out, std::string_view name, std::string_view help,
+                            double value);
+    static void renderHistogram(std::string& out, std::string_view name, std::string_view help,
+                                const HistogramTotals& value);
+
+private:
+    std::vector<std::unique_ptr<Local>> locals_;
+};
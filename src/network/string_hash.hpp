@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// 以 std::string 为键的无序容器用它和 std::equal_to<> 支持按 string_view 查找，
+// 查找转发帧里的房间名时不必先构造 std::string
+struct StringHash {
+    using is_transparent = void;
+
+    std::size_t operator()(std::string_view value) const
+    {
+        return std::hash<std::string_view>{}(value);
+    }
+};
@@ -1,43 +1,238 @@
 #include <iostream>
 #include <asio.hpp>
 #include "network/chat_server.hpp"
-#include <locale>
-#include <codecvt>
+#include "network/file_store.hpp"
+#include "network/io_context_pool.hpp"
+#include "network/metrics_endpoint.hpp"
+#include "database/message_writer.hpp"
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <thread>
+#ifdef _WIN32
 #include <windows.h>
+#endif
+
+static void printUsage()
+{
+    std::cout << "用法: ChatServer <端口号> [--threads <线程数>] [--balance <round-robin|least-load>]\n";
+    std::cout << "                  [--queue-frames <帧数>] [--queue-bytes <字节数>]\n";
+    std::cout << "                  [--overflow <drop-oldest|drop-noncritical|disconnect>]\n";
+    std::cout << "                  [--db <数据库路径>] [--no-persist] [--metrics-port <端口号>]\n";
+    std::cout << "                  [--rate-msgs <条/秒>] [--rate-bytes <字节/秒>]\n";
+    std::cout << "                  [--ip-rate-msgs <条/秒>] [--ip-rate-bytes <字节/秒>] [--rate-action <delay|drop>]\n";
+    std::cout << "                  [--node-id <节点名>] [--federation-port <端口号>] [--peer <主机:端口>]...\n";
+    std::cout << "                  [--file-dir <目录>] [--max-file-size <字节数>] [--no-files]\n";
+    std::cout << "示例: ChatServer 8080 --threads 4 --balance least-load\n";
+    std::cout << "      ChatServer 8081 --node-id b --federation-port 9081 --peer 127.0.0.1:9080\n";
+}
+
+static bool isNumber(const std::string& str)
+{
+    return !str.empty() && std::all_of(str.begin(), str.end(), ::isdigit);
+}
+
+static bool parsePort(const std::string& str, uint16_t& port)
+{
+    if (!isNumber(str) || str.size() > 5) {
+        return false;
+    }
+    int value = std::atoi(str.c_str());
+    if (value <= 0 || value > 65535) {
+        return false;
+    }
+    port = static_cast<uint16_t>(value);
+    return true;
+}
+
+// 节点名出现在日志和指标标签中，只允许字母、数字和 ._-
+static bool isValidNodeId(const std::string& str)
+{
+    return !str.empty() && str.size() <= 64 && std::all_of(str.begin(), str.end(), [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '.' || c == '_' || c == '-';
+    });
+}
 
 int main(int argc, char* argv[])
 {
+#ifdef _WIN32
     // 设置控制台输出编码为 UTF-8
     SetConsoleOutputCP(CP_UTF8);
-    
+#endif
+
     try {
-        if (argc != 2) {
-            std::cout << "用法: ChatServer <端口号>\n";
-            std::cout << "示例: ChatServer 8080\n";
+        if (argc < 2) {
+            printUsage();
             return 1;
         }
 
         // 检查端口参数是否为数字
         std::string port_str = argv[1];
-        if (!std::all_of(port_str.begin(), port_str.end(), ::isdigit)) {
+        if (!isNumber(port_str)) {
             std::cout << "错误: 端口必须是数字\n";
             return 1;
         }
 
-        uint16_t port = static_cast<uint16_t>(std::atoi(argv[1]));
+        int port = std::atoi(argv[1]);
         if (port <= 0 || port > 65535) {
             std::cout << "错误: 端口必须在 1-65535 之间\n";
             return 1;
         }
 
-        asio::io_context io_context;
-        ChatServer server(io_context, port);
+        // 默认每个 CPU 核心一个事件循环
+        std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        auto strategy = IoContextPool::Strategy::RoundRobin;
+        SendQueue::QueueLimits queueLimits = ChatServer::DEFAULT_SEND_QUEUE_LIMITS;
+        std::string dbPath = "server_history.db";
+        bool persist = true;
+        int metricsPort = 0;
+        RateLimitConfig rateLimits;
+        FederationConfig federation;
+        federation.nodeId = "node-" + port_str;
+        std::string fileDir = "server_files";
+        FileStore::Limits fileLimits;
+        bool files = true;
+
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--threads" && i + 1 < argc && isNumber(argv[i + 1])) {
+                threads = static_cast<std::size_t>(std::atoi(argv[++i]));
+                if (threads == 0) {
+                    std::cout << "错误: 线程数必须大于 0\n";
+                    return 1;
+                }
+            } else if (arg == "--balance" && i + 1 < argc) {
+                std::string mode = argv[++i];
+                if (mode == "round-robin") {
+                    strategy = IoContextPool::Strategy::RoundRobin;
+                } else if (mode == "least-load") {
+                    strategy = IoContextPool::Strategy::LeastLoad;
+                } else {
+                    printUsage();
+                    return 1;
+                }
+            } else if (arg == "--queue-frames" && i + 1 < argc && isNumber(argv[i + 1])) {
+                queueLimits.maxFrames = std::stoull(argv[++i]);
+            } else if (arg == "--queue-bytes" && i + 1 < argc && isNumber(argv[i + 1])) {
+                queueLimits.maxBytes = std::stoull(argv[++i]);
+            } else if (arg == "--overflow" && i + 1 < argc) {
+                std::string policy = argv[++i];
+                if (policy == "drop-oldest") {
+                    queueLimits.policy = SendQueue::OverflowPolicy::DropOldest;
+                } else if (policy == "drop-noncritical") {
+                    queueLimits.policy = SendQueue::OverflowPolicy::DropNonCritical;
+                } else if (policy == "disconnect") {
+                    queueLimits.policy = SendQueue::OverflowPolicy::Disconnect;
+                } else {
+                    printUsage();
+                    return 1;
+                }
+            } else if (arg == "--db" && i + 1 < argc) {
+                dbPath = argv[++i];
+            } else if (arg == "--no-persist") {
+                persist = false;
+            } else if (arg == "--metrics-port" && i + 1 < argc && isNumber(argv[i + 1])) {
+                metricsPort = std::atoi(argv[++i]);
+                if (metricsPort <= 0 || metricsPort > 65535) {
+                    std::cout << "错误: 端口必须在 1-65535 之间\n";
+                    return 1;
+                }
+            } else if (arg == "--rate-msgs" && i + 1 < argc && isNumber(argv[i + 1])) {
+                rateLimits.session.messagesPerSecond = std::stod(argv[++i]);
+            } else if (arg == "--rate-bytes" && i + 1 < argc && isNumber(argv[i + 1])) {
+                rateLimits.session.bytesPerSecond = std::stod(argv[++i]);
+            } else if (arg == "--ip-rate-msgs" && i + 1 < argc && isNumber(argv[i + 1])) {
+                rateLimits.address.messagesPerSecond = std::stod(argv[++i]);
+            } else if (arg == "--ip-rate-bytes" && i + 1 < argc && isNumber(argv[i + 1])) {
+                rateLimits.address.bytesPerSecond = std::stod(argv[++i]);
+            } else if (arg == "--rate-action" && i + 1 < argc) {
+                std::string action = argv[++i];
+                if (action == "delay") {
+                    rateLimits.action = RateLimitConfig::Action::Delay;
+                } else if (action == "drop") {
+                    rateLimits.action = RateLimitConfig::Action::Drop;
+                } else {
+                    printUsage();
+                    return 1;
+                }
+            } else if (arg == "--node-id" && i + 1 < argc) {
+                federation.nodeId = argv[++i];
+                if (!isValidNodeId(federation.nodeId)) {
+                    std::cout << "错误: 节点名只能包含字母、数字和 ._-\n";
+                    return 1;
+                }
+            } else if (arg == "--federation-port" && i + 1 < argc) {
+                if (!parsePort(argv[++i], federation.port)) {
+                    std::cout << "错误: 端口必须在 1-65535 之间\n";
+                    return 1;
+                }
+            } else if (arg == "--peer" && i + 1 < argc) {
+                std::string peer = argv[++i];
+                auto colon = peer.rfind(':');
+                FederationConfig::Peer entry;
+                if (colon == std::string::npos || colon == 0 || !parsePort(peer.substr(colon + 1), entry.port)) {
+                    std::cout << "错误: 节点地址格式应为 <主机:端口>\n";
+                    return 1;
+                }
+                entry.host = peer.substr(0, colon);
+                federation.peers.push_back(std::move(entry));
+            } else if (arg == "--file-dir" && i + 1 < argc) {
+                fileDir = argv[++i];
+            } else if (arg == "--max-file-size" && i + 1 < argc && isNumber(argv[i + 1])) {
+                fileLimits.maxFileSize = std::stoull(argv[++i]);
+            } else if (arg == "--no-files") {
+                files = false;
+            } else {
+                printUsage();
+                return 1;
+            }
+        }
+
+        // 写线程在服务器之前创建、之后销毁，退出时会写完剩余消息
+        std::unique_ptr<AsyncMessageWriter> writer;
+        if (persist) {
+            writer = std::make_unique<AsyncMessageWriter>(dbPath);
+        }
+
+        std::unique_ptr<FileStore> fileStore;
+        if (files) {
+            fileStore = std::make_unique<FileStore>(fileDir, fileLimits);
+        }
+
+        IoContextPool pool(threads, strategy);
+        std::cout << "I/O 后端: " << IoContextPool::getBackendName() << "\n";
+        ChatServer server(pool, static_cast<uint16_t>(port));
+        server.setSendQueueLimits(queueLimits);
+        server.setRateLimits(rateLimits);
+        server.setMessageWriter(writer.get());
+        server.setFileStore(fileStore.get());
+        if (federation.enabled()) {
+            server.enableFederation(federation);
+        }
         server.start();
-        io_context.run();
+
+        // 指标只在本机回环地址上提供，由本机的 Prometheus 或代理抓取
+        std::unique_ptr<MetricsEndpoint> metrics;
+        if (metricsPort > 0) {
+            metrics = std::make_unique<MetricsEndpoint>(pool.getIoContext(0),
+                asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), static_cast<uint16_t>(metricsPort)),
+                [&server]() { return server.renderMetrics(); });
+            metrics->start();
+        }
+
+        // Ctrl+C 或 SIGTERM 时停止所有事件循环，随后写线程写完剩余消息
+        asio::signal_set signals(pool.getIoContext(0), SIGINT, SIGTERM);
+        signals.async_wait([&pool](const asio::error_code& ec, int) {
+            if (!ec) {
+                pool.stop();
+            }
+        });
+
+        pool.run();
     }
     catch (std::exception& e) {
         std::cerr << "异常: " << e.what() << "\n";
     }
 
     return 0;
-} 
\ No newline at end of file
+}
@@ -5,6 +5,7 @@
 #include <QPushButton>
 #include <QLabel>
 #include <QMessageBox>
+#include "../network/presence.hpp"
 
 LoginDialog::LoginDialog(QWidget *parent)
     : QDialog(parent)
@@ -54,7 +55,15 @@ void LoginDialog::setupUi()
 
 void LoginDialog::connectSignals()
 {
-    connect(loginButton, &QPushButton::clicked, this, &QDialog::accept);
+    connect(loginButton, &QPushButton::clicked, this, [this]() {
+        // 与服务器相同的检查，非法用户名登录时会被服务器断开
+        if (!Presence::isValidUsername(usernameEdit->text().toStdString())) {
+            QMessageBox::warning(this, tr("登录"),
+                tr("用户名不能为空、不能含逗号，且不超过 %1 字节").arg(Presence::MAX_USERNAME_LENGTH));
+            return;
+        }
+        accept();
+    });
     connect(cancelButton, &QPushButton::clicked, this, &QDialog::reject);
 }
 
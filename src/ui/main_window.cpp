@@ -11,6 +11,8 @@
 #include <QDateTime>
 #include <QLabel>
 #include <QStatusBar>
+#include <QFileDialog>
+#include <QFileInfo>
 #include <memory>
 #include <asio.hpp>
 #include <asio/executor_work_guard.hpp>
@@ -56,9 +58,85 @@ MainWindow::MainWindow(const QString &username, QWidget *parent)
                                     Qt::QueuedConnection,
                                     Q_ARG(QString, text));
             
-            // 存储收到的消息
-            storeMessage(msg);
+            // 存储收到的消息；服务器重放的历史消息已存过，不再重复存储
+            if (!client_->isReplayingHistory()) {
+                storeMessage(msg);
+            }
+        } else if (msg.getType() == Message::Type::PRIVATE) {
+            // 自己在其他设备上发出的私聊也会收到一份
+            QString text = msg.getSender() == username.toStdString()
+                ? tr("[私聊] 我 -> %1: %2").arg(QString::fromStdString(msg.getTarget()),
+                                               QString::fromStdString(msg.getContent()))
+                : tr("[私聊] %1: %2").arg(QString::fromStdString(msg.getSender()),
+                                          QString::fromStdString(msg.getContent()));
+            QMetaObject::invokeMethod(this, "handleReceivedMessage",
+                                    Qt::QueuedConnection,
+                                    Q_ARG(QString, text));
+        } else if (msg.getType() == Message::Type::PRIVATE_STATUS) {
+            QString target = QString::fromStdString(msg.getTarget());
+            QString text;
+            if (msg.getContent() == "offline") {
+                text = tr("%1 不在线，消息将在其上线后送达").arg(target);
+            } else if (msg.getContent() == "invalid") {
+                text = tr("发给 %1 的私聊无效，消息未送达").arg(target);
+            } else {
+                text = tr("%1 的离线消息已满，消息未送达").arg(target);
+            }
+            QMetaObject::invokeMethod(this, "handleReceivedMessage",
+                                    Qt::QueuedConnection,
+                                    Q_ARG(QString, text));
+        } else if (msg.getType() == Message::Type::FILE_AVAILABLE) {
+            // content 为 "<文件编号>\n<字节数>\n<文件名>"
+            QStringList fields = QString::fromStdString(msg.getContent()).split('\n');
+            if (fields.size() >= 3) {
+                QMetaObject::invokeMethod(this, "showFileAvailable",
+                                        Qt::QueuedConnection,
+                                        Q_ARG(QString, fields[0]),
+                                        Q_ARG(QString, QString::fromStdString(msg.getSender())),
+                                        Q_ARG(QString, fields.mid(2).join('\n')),
+                                        Q_ARG(qulonglong, fields[1].toULongLong()));
+            }
+        } else if (msg.getTarget().empty()) {
+            // 服务器提供了最近消息时，用它替换本地加载的历史
+            if (msg.getType() == Message::Type::HISTORY_BEGIN) {
+                QMetaObject::invokeMethod(this, "beginServerHistory", Qt::QueuedConnection);
+            } else if (msg.getType() == Message::Type::HISTORY_END) {
+                QMetaObject::invokeMethod(this, "handleReceivedMessage",
+                                        Qt::QueuedConnection,
+                                        Q_ARG(QString, tr("--------以上是历史消息--------")));
+            }
+        }
+    });
+
+    // 设置在线用户列表处理器
+    client_->setUserListHandler([this](const std::vector<std::string>& users) {
+        QStringList list;
+        for (const auto& user : users) {
+            list << QString::fromStdString(user);
         }
+        QMetaObject::invokeMethod(this, "updateUserList",
+                                Qt::QueuedConnection,
+                                Q_ARG(QStringList, list));
+    });
+
+    // 设置链路质量处理器
+    client_->setLinkQualityHandler([this](const LinkQuality& quality) {
+        QMetaObject::invokeMethod(this, "updateLinkQuality",
+                                Qt::QueuedConnection,
+                                Q_ARG(double, quality.smoothed.count() / 1000.0),
+                                Q_ARG(double, quality.jitter.count() / 1000.0));
+    });
+
+    // 设置文件传输进度处理器
+    client_->setFileProgressHandler([this](const ChatClient::FileProgress& progress) {
+        QMetaObject::invokeMethod(this, "updateFileProgress",
+                                Qt::QueuedConnection,
+                                Q_ARG(QString, QString::fromStdString(progress.id)),
+                                Q_ARG(bool, progress.upload),
+                                Q_ARG(qulonglong, progress.transferred),
+                                Q_ARG(qulonglong, progress.total),
+                                Q_ARG(bool, progress.finished),
+                                Q_ARG(QString, QString::fromStdString(progress.error)));
     });
 
     // 设置断开连接处理器
@@ -128,6 +206,7 @@ void MainWindow::setupUi()
 void MainWindow::createMenus()
 {
     auto fileMenu = menuBar()->addMenu(tr("文件"));
+    fileMenu->addAction(tr("发送文件..."), this, &MainWindow::sendFile);
     fileMenu->addAction(tr("设置"), this, []{});
     fileMenu->addSeparator();
     fileMenu->addAction(tr("退出"), this, &QMainWindow::close);
@@ -140,6 +219,16 @@ void MainWindow::connectSignals()
 {
     connect(sendButton, &QPushButton::clicked, this, &MainWindow::sendMessage);
     connect(messageInput, &QLineEdit::returnPressed, this, &MainWindow::sendMessage);
+    connect(userList, &QListWidget::itemDoubleClicked, this, &MainWindow::startPrivateMessage);
+}
+
+void MainWindow::startPrivateMessage(QListWidgetItem* item)
+{
+    // 第一行是标题
+    if (!item || userList->row(item) == 0 || item->text() == username) return;
+
+    messageInput->setText(QString("/msg %1 ").arg(item->text()));
+    messageInput->setFocus();
 }
 
 void MainWindow::sendMessage()
@@ -147,6 +236,41 @@ void MainWindow::sendMessage()
     QString text = messageInput->text().trimmed();
     if (text.isEmpty()) return;
     
+    // "/msg <用户> <内容>" 发送私聊
+    if (text.startsWith("/msg ")) {
+        QString rest = text.mid(5).trimmed();
+        int space = rest.indexOf(' ');
+        QString target = space > 0 ? rest.left(space) : QString();
+        QString content = space > 0 ? rest.mid(space + 1).trimmed() : QString();
+        if (target.isEmpty() || content.isEmpty()) {
+            chatDisplay->append(tr("用法: /msg <用户名> <内容>"));
+            return;
+        }
+
+        Message msg(Message::Type::PRIVATE);
+        msg.setSender(username.toStdString());
+        msg.setTarget(target.toStdString());
+        msg.setContent(content.toStdString());
+        if (client_) {
+            client_->sendMessage(msg);
+        }
+        chatDisplay->append(tr("[私聊] 我 -> %1: %2").arg(target, content));
+        messageInput->clear();
+        return;
+    }
+    
+    // "/get <文件编号>" 下载服务器上的文件
+    if (text.startsWith("/get ")) {
+        QString id = text.mid(5).trimmed();
+        if (id.isEmpty()) {
+            chatDisplay->append(tr("用法: /get <文件编号>"));
+            return;
+        }
+        messageInput->clear();
+        downloadFile(id);
+        return;
+    }
+    
     // 创建消息
     Message msg(Message::Type::TEXT);
     msg.setSender(username.toStdString());
@@ -171,6 +295,62 @@ void MainWindow::sendMessage()
     storeMessage(msg);
 }
 
+void MainWindow::sendFile()
+{
+    QString path = QFileDialog::getOpenFileName(this, tr("选择要发送的文件"));
+    if (path.isEmpty() || !client_) return;
+
+    // 用户列表中选中了其他用户时只发给该用户，否则发给所有人
+    QString recipient;
+    auto item = userList->currentItem();
+    if (item && userList->row(item) != 0 && item->text() != username) {
+        recipient = item->text();
+    }
+
+    client_->sendFile(path.toStdString(), recipient.toStdString());
+    QString name = QFileInfo(path).fileName();
+    chatDisplay->append(recipient.isEmpty()
+        ? tr("[文件] 正在发送 %1 给所有人").arg(name)
+        : tr("[文件] 正在发送 %1 给 %2").arg(name, recipient));
+}
+
+void MainWindow::downloadFile(const QString& id)
+{
+    QString path = QFileDialog::getSaveFileName(this, tr("保存文件"), availableFiles_.value(id));
+    if (path.isEmpty() || !client_) return;
+
+    client_->downloadFile(id.toStdString(), path.toStdString());
+    chatDisplay->append(tr("[文件] 正在下载到 %1").arg(path));
+}
+
+void MainWindow::showFileAvailable(const QString& id, const QString& sender, const QString& name, qulonglong size)
+{
+    availableFiles_.insert(id, name);
+    QString text = sender == username
+        ? tr("[文件] 已发送 %1 (%2)").arg(name, locale().formattedDataSize(size))
+        : tr("[文件] %1 分享了 %2 (%3)，输入 /get %4 下载")
+              .arg(sender, name, locale().formattedDataSize(size), id);
+    chatDisplay->append(text);
+}
+
+void MainWindow::updateFileProgress(const QString& id, bool upload, qulonglong transferred, qulonglong total,
+                                    bool finished, const QString& error)
+{
+    QString action = upload ? tr("上传") : tr("下载");
+    if (!finished) {
+        int percent = total > 0 ? static_cast<int>(transferred * 100 / total) : 0;
+        fileProgressLabel_->setText(tr("%1 %2%").arg(action).arg(percent));
+        return;
+    }
+
+    fileProgressLabel_->clear();
+    if (!error.isEmpty()) {
+        chatDisplay->append(tr("[文件] %1失败 (%2): %3").arg(action, id, error));
+    } else {
+        chatDisplay->append(tr("[文件] %1完成 (%2)").arg(action, id));
+    }
+}
+
 void MainWindow::connectToServer(const QString& address, uint16_t port)
 {
     if (client_) {
@@ -200,15 +380,41 @@ void MainWindow::handleReceivedMessage(const QString &message)
     chatDisplay->append(message);
 }
 
+void MainWindow::updateUserList(const QStringList& users)
+{
+    userList->clear();
+    userList->addItem(tr("在线用户"));
+    userList->addItems(users);
+}
+
+void MainWindow::beginServerHistory()
+{
+    chatDisplay->clear();
+    chatDisplay->append(tr("--------服务器最近消息--------"));
+}
+
 void MainWindow::setupStatusBar()
 {
     connectionStatusLabel_ = new QLabel(tr("未连接"), this);
     statusBar()->addPermanentWidget(connectionStatusLabel_);
+    linkQualityLabel_ = new QLabel(this);
+    statusBar()->addPermanentWidget(linkQualityLabel_);
+    fileProgressLabel_ = new QLabel(this);
+    statusBar()->addPermanentWidget(fileProgressLabel_);
 }
 
 void MainWindow::updateConnectionStatus(const QString& status)
 {
     connectionStatusLabel_->setText(status);
+    // 连接状态变化后旧的延迟不再有效，等下一次心跳重新测量
+    linkQualityLabel_->clear();
+}
+
+void MainWindow::updateLinkQuality(double rttMs, double jitterMs)
+{
+    linkQualityLabel_->setText(tr("延迟 %1 ms (抖动 %2 ms)")
+                                   .arg(rttMs, 0, 'f', 1)
+                                   .arg(jitterMs, 0, 'f', 1));
 }
 
 void MainWindow::loadChatHistory()
@@ -1,5 +1,6 @@
 #pragma once
 #include <QMainWindow>
+#include <QHash>
 #include <memory>
 #include <asio.hpp>
 #include "../network/chat_client.hpp"
@@ -10,6 +11,7 @@ class QTextEdit;
 class QLineEdit;
 class QPushButton;
 class QListWidget;
+class QListWidgetItem;
 class QLabel;
 QT_END_NAMESPACE
 
@@ -23,6 +25,14 @@ private slots:
     void sendMessage();
     void handleReceivedMessage(const QString &message);
     void connectToServer(const QString& address, uint16_t port);
+    void updateUserList(const QStringList& users);
+    void beginServerHistory();
+    void updateLinkQuality(double rttMs, double jitterMs);
+    void startPrivateMessage(QListWidgetItem* item);
+    void sendFile();
+    void showFileAvailable(const QString& id, const QString& sender, const QString& name, qulonglong size);
+    void updateFileProgress(const QString& id, bool upload, qulonglong transferred, qulonglong total,
+                            bool finished, const QString& error);
 
 private:
     void setupUi();
@@ -32,6 +42,7 @@ private:
     void setupStatusBar();
     void loadChatHistory();
     void storeMessage(const Message& msg);
+    void downloadFile(const QString& id);
 
     QString username;
     QTextEdit *chatDisplay;    // 聊天显示区域
@@ -44,6 +55,9 @@ private:
     std::unique_ptr<std::thread> network_thread_;
 
     QLabel* connectionStatusLabel_;
+    QLabel* linkQualityLabel_;      // 心跳测得的平滑往返时间和抖动
+    QLabel* fileProgressLabel_;     // 最近一次文件传输的进度
+    QHash<QString, QString> availableFiles_;  // 收到通知的可下载文件：编号 -> 文件名
     int reconnectAttempts_{0};
     std::unique_ptr<MessageStore> messageStore_;
 }; 
\ No newline at end of file